@@ -8,10 +8,10 @@
 // supporting structures.
 
 #include "prelude.hpp"
+#include "token.hpp"
 
 #include <lingo/integer.hpp>
 #include <lingo/real.hpp>
-#include <lingo/token.hpp>
 
 #include <vector>
 #include <utility>
@@ -228,18 +228,18 @@ using Decl_iter = Decl_list::iterator;
 using Cons_iter = Cons_list::iterator;
 
 
-// Unparsed terms.
+// Unparsed terms. The tokens of an unparsed term are a range of the
+// buffer from which it was parsed.
 template<typename T>
 struct Unparsed_term : T
 {
-  Unparsed_term(Token_seq&& toks)
-    : toks(std::move(toks))
+  Unparsed_term(Token_range const& toks)
+    : toks(toks)
   { }
 
-  Token_seq const& tokens() const { return toks; }
-  Token_seq&       tokens()       { return toks; }
+  Token_range const& tokens() const { return toks; }
 
-  Token_seq toks;
+  Token_range toks;
 };
 
 
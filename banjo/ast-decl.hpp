@@ -114,6 +114,13 @@ struct Decl::Mutator
 struct Object_decl : Decl
 {
   using Decl::Decl;
+
+  // Returns the index of the object in the evaluation frame of its
+  // enclosing function. This is -1 for objects that are not local
+  // to a function.
+  int slot() const { return slot_; }
+
+  int slot_ = -1;
 };
 
 
@@ -147,7 +154,7 @@ struct Function_decl : Decl
 {
   // FIXME: Consume arguments.
   Function_decl(Name& n, Type& t, Decl_list const& p, Def& d)
-    : Decl(n, t), parms_(p), def_(&d)
+    : Decl(n, t), parms_(p), def_(&d), frame_(0)
   { }
 
   void accept(Visitor& v) const { v.visit(*this); }
@@ -177,9 +184,15 @@ struct Function_decl : Decl
   Def const& definition() const { return *def_; }
   Def&       definition()       { return *def_; }
 
+  // Returns the number of slots needed to evaluate a call to the
+  // function. This is the number of parameters and local variables
+  // that may be live at the same time.
+  int frame_size() const { return frame_; }
+
   Decl_list parms_;
   Expr*     constr_;
   Def*      def_;
+  int       frame_;
 };
 
 
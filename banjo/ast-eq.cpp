@@ -195,11 +195,11 @@ is_equivalent(Unary_type const& t1, Unary_type const& t2)
 }
 
 
-// TODO: The extent of the arrays must be equivalent.
 bool
 is_equivalent(Array_type const& t1, Array_type const& t2)
 {
-  return is_equivalent(t1.type(), t2.type());
+  return is_equivalent(t1.type(), t2.type())
+      && is_equivalent(t1.extent(), t2.extent());
 }
 
 
@@ -613,6 +613,26 @@ struct Assign_expr : Binary_expr
 };
 
 
+// A subscript expression of the form `a[i]`. The object is an array,
+// dynamic array, or slice, and the result refers to one of its
+// elements.
+struct Index_expr : Binary_expr
+{
+  using Binary_expr::Binary_expr;
+
+  void accept(Visitor& v) const { v.visit(*this); }
+  void accept(Mutator& v)       { v.visit(*this); }
+
+  // Returns the indexed object.
+  Expr const& object() const { return left(); }
+  Expr&       object()       { return left(); }
+
+  // Returns the index.
+  Expr const& index() const { return right(); }
+  Expr&       index()       { return right(); }
+};
+
+
 // An expression denoting a requirement for a valid syntax.
 // Note that the body can (and generally is) a compound
 // statement.
@@ -671,17 +691,16 @@ struct Synthetic_expr : Expr
 // Represents an unparsed expression.
 struct Unparsed_expr : Expr
 {
-  Unparsed_expr(Token_seq&& toks)
-    : Expr(untyped), toks(std::move(toks))
+  Unparsed_expr(Token_range const& toks)
+    : Expr(untyped), toks(toks)
   { }
 
   void accept(Visitor& v) const { v.visit(*this); }
   void accept(Mutator& v)       { v.visit(*this); }
 
-  Token_seq const& tokens() const { return toks; }
-  Token_seq&       tokens()       { return toks; }
+  Token_range const& tokens() const { return toks; }
 
-  Token_seq toks;
+  Token_range toks;
 };
 
 
@@ -789,6 +808,17 @@ struct Numeric_conv : Standard_conv
 };
 
 
+// A conversion from an array or dynamic array object to a slice
+// that refers to its elements.
+struct Slice_conv : Standard_conv
+{
+  using Standard_conv::Standard_conv;
+
+  void accept(Visitor& v) const { v.visit(*this); }
+  void accept(Mutator& v)       { v.visit(*this); }
+};
+
+
 // A conversion from a type-dependent expression to some
 // other type. When instantiated, an implicit conversion must
 // be applied.
@@ -174,6 +174,55 @@ hash_function_type(Function_type const& t)
 }
 
 
+inline std::size_t
+hash_qualified_type(Qualified_type const& t)
+{
+  std::size_t h = hash_type(t);
+  boost::hash_combine(h, int(t.qualifier()));
+  boost::hash_combine(h, t.type());
+  return h;
+}
+
+
+// Pointers, references, and slices.
+inline std::size_t
+hash_unary_type(Unary_type const& t)
+{
+  std::size_t h = hash_type(t);
+  boost::hash_combine(h, t.type());
+  return h;
+}
+
+
+inline std::size_t
+hash_array_type(Array_type const& t)
+{
+  std::size_t h = hash_type(t);
+  boost::hash_combine(h, t.type());
+  boost::hash_combine(h, t.extent());
+  return h;
+}
+
+
+inline std::size_t
+hash_tuple_type(Tuple_type const& t)
+{
+  std::size_t h = hash_type(t);
+  boost::hash_combine(h, t.type_list());
+  return h;
+}
+
+
+// The extent of a dynamic array is not part of its type.
+inline std::size_t
+hash_dynarray_type(Dynarray_type const& t)
+{
+  std::size_t h = hash_type(t);
+  boost::hash_combine(h, t.type());
+  return h;
+}
+
+
 // The hash value of a user-defined type is that of its declaration.
 inline std::size_t
 hash_declared_type(Declared_type const& t)
@@ -197,7 +246,12 @@ hash_value(Type const& t)
     std::size_t operator()(Integer_type const& t) const   { return hash_integer(t); }
     std::size_t operator()(Float_type const& t) const     { return hash_float(t); }
     std::size_t operator()(Function_type const& t) const  { return hash_function_type(t); }
-    std::size_t operator()(Class_type const& t) const     { return hash_declared_type(t); }
+    std::size_t operator()(Qualified_type const& t) const { return hash_qualified_type(t); }
+    std::size_t operator()(Unary_type const& t) const     { return hash_unary_type(t); }
+    std::size_t operator()(Array_type const& t) const     { return hash_array_type(t); }
+    std::size_t operator()(Tuple_type const& t) const     { return hash_tuple_type(t); }
+    std::size_t operator()(Dynarray_type const& t) const  { return hash_dynarray_type(t); }
+    std::size_t operator()(Declared_type const& t) const  { return hash_declared_type(t); }
   };
   return apply(t, fn{});
 }
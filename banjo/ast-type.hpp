@@ -421,17 +421,16 @@ struct Type_type : Type
 // Represents an unparsed type.
 struct Unparsed_type : Type
 {
-  Unparsed_type(Token_seq&& toks)
-    : toks(std::move(toks))
+  Unparsed_type(Token_range const& toks)
+    : toks(toks)
   { }
 
   void accept(Visitor& v) const { v.visit(*this); }
   void accept(Mutator& v)       { v.visit(*this); }
 
-  Token_seq const& tokens() const { return toks; }
-  Token_seq&       tokens()       { return toks; }
+  Token_range const& tokens() const { return toks; }
 
-  Token_seq toks;
+  Token_range toks;
 };
 
 
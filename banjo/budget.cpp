@@ -0,0 +1,126 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "budget.hpp"
+#include "ast.hpp"
+#include "printer.hpp"
+#include "value.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <iostream>
+
+
+namespace banjo
+{
+
+// Set the limits of evaluation. The byte limit is applied to the
+// evaluation arena.
+void
+Evaluation_budget::configure(Evaluation_limits const& l)
+{
+  limits = l;
+  max_steps = limits.steps ? limits.steps + 1 : 0;
+  evaluation_arena().limit = limits.bytes;
+}
+
+
+// Reset the budget at the start of an outermost evaluation.
+void
+Evaluation_budget::reset()
+{
+  steps = 0;
+  unwind(0);
+}
+
+
+// Record entry into a call to `f`.
+void
+Evaluation_budget::enter(Decl const& f)
+{
+  if (limits.depth && active.size() == limits.depth)
+    exceeded_depth();
+  active.push_back({&f, steps, 0});
+  if (profiling) {
+    Function_profile& p = profile[&f];
+    ++p.calls;
+    ++p.active;
+  }
+}
+
+
+// Record the return from the most recent call.
+void
+Evaluation_budget::leave()
+{
+  Activation a = active.back();
+  active.pop_back();
+  std::size_t total = steps - a.start;
+  if (!active.empty())
+    active.back().inner += total;
+  if (profiling) {
+    Function_profile& p = profile[a.fn];
+    p.self += total - a.inner;
+    if (--p.active == 0)
+      p.total += total;
+  }
+}
+
+
+void
+Evaluation_budget::exceeded_steps() const
+{
+  throw Limitation_error("constant evaluation exceeded the limit of {} steps", limits.steps);
+}
+
+
+void
+Evaluation_budget::exceeded_depth() const
+{
+  throw Limitation_error("constant evaluation exceeded the limit of {} nested calls", limits.depth);
+}
+
+
+// Leave all calls above the given depth. This is used when evaluation
+// of a call is abandoned.
+void
+Evaluation_budget::unwind(std::size_t n)
+{
+  while (active.size() > n)
+    leave();
+}
+
+
+Evaluation_budget&
+evaluation_budget()
+{
+  static Evaluation_budget budget;
+  return budget;
+}
+
+
+// Print the evaluation profile, ordered by decreasing total steps.
+void
+print_evaluation_profile(std::ostream& os)
+{
+  using Entry = std::pair<Decl const*, Function_profile>;
+  Profile_map const& map = evaluation_budget().profile;
+  std::vector<Entry> entries(map.begin(), map.end());
+  std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+    return a.second.total > b.second.total;
+  });
+
+  os << std::setw(12) << "calls"
+     << std::setw(14) << "self"
+     << std::setw(14) << "total"
+     << "  function\n";
+  for (Entry const& e : entries) {
+    os << std::setw(12) << e.second.calls
+       << std::setw(14) << e.second.self
+       << std::setw(14) << e.second.total
+       << "  " << e.first->name() << '\n';
+  }
+}
+
+
+} // namespace banjo
@@ -0,0 +1,125 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_BUDGET_HPP
+#define BANJO_BUDGET_HPP
+
+// This module limits the resources used by constant evaluation and
+// optionally profiles the functions that are evaluated.
+//
+// Both the tree walker and the register machine count the steps they
+// execute and report calls to the budget. Exceeding a limit is a
+// Limitation_error. Steps are counted per outermost evaluation.
+
+#include "prelude.hpp"
+
+#include <iosfwd>
+#include <unordered_map>
+
+
+namespace banjo
+{
+
+struct Decl;
+
+
+// Limits on the resources used by a single constant evaluation. A
+// limit of 0 is no limit. The byte limit applies to the evaluation
+// arena.
+struct Evaluation_limits
+{
+  std::size_t steps = 100000000;
+  std::size_t depth = 512;
+  std::size_t bytes = std::size_t(1) << 30;
+};
+
+
+// The cost of evaluating calls to a function or resumptions of a
+// coroutine. Self steps are those
+// executed in the function's own body. Total steps include the steps
+// of its callees; a recursive call is counted only once.
+struct Function_profile
+{
+  std::size_t calls  = 0;
+  std::size_t self   = 0;
+  std::size_t total  = 0;
+  std::size_t active = 0;
+};
+
+
+using Profile_map = std::unordered_map<Decl const*, Function_profile>;
+
+
+// Tracks the resources used by the current evaluation.
+struct Evaluation_budget
+{
+  // An active call.
+  struct Activation
+  {
+    Decl const*          fn;
+    std::size_t          start; // steps on entry
+    std::size_t          inner; // steps in callees
+  };
+
+  Evaluation_budget()
+    : steps(0), max_steps(0), profiling(false)
+  { }
+
+  void configure(Evaluation_limits const&);
+  void reset();
+
+  void step();
+  void enter(Decl const&);
+  void leave();
+  void unwind(std::size_t);
+
+  std::size_t depth() const { return active.size(); }
+
+  [[noreturn]] void exceeded_steps() const;
+  [[noreturn]] void exceeded_depth() const;
+
+  Evaluation_limits       limits;
+  std::size_t             steps;
+  std::size_t             max_steps; // the step that exceeds the limit
+  bool                    profiling;
+  std::vector<Activation> active;
+  Profile_map             profile;
+};
+
+
+// Count one step of evaluation.
+inline void
+Evaluation_budget::step()
+{
+  if (++steps == max_steps)
+    exceeded_steps();
+}
+
+
+// Marks the evaluation of a call to a function.
+struct Enter_call
+{
+  Enter_call(Evaluation_budget& b, Decl const& f)
+    : budget(b)
+  {
+    budget.enter(f);
+  }
+
+  ~Enter_call()
+  {
+    budget.leave();
+  }
+
+  Evaluation_budget& budget;
+};
+
+
+Evaluation_budget& evaluation_budget();
+
+void print_evaluation_profile(std::ostream&);
+
+
+} // namespace banjo
+
+
+#endif
@@ -681,6 +681,13 @@ Builder::make_call(Type& t, Function_decl& f, Expr_list const& a)
   return make_call(t, make_reference(f), a);
 }
 
+
+Index_expr&
+Builder::make_index(Type& t, Expr& e1, Expr& e2)
+{
+  return make<Index_expr>(t, e1, e2);
+}
+
 Tuple_expr&
 Builder::make_tuple_expr(Type& t, Expr_list const& l)
 {
@@ -0,0 +1,333 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "cache.hpp"
+#include "token.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <vector>
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <utime.h>
+
+
+namespace banjo
+{
+
+// -------------------------------------------------------------------------- //
+// Content hashing
+
+// Each byte is multiplied by the 128-bit FNV prime, 2^88 + 0x13b. The
+// product is computed modulo 2^128 from the 32-bit halves of `lo`.
+void
+Content_hash::put(void const* p, std::size_t n)
+{
+  unsigned char const* s = static_cast<unsigned char const*>(p);
+  for (std::size_t i = 0; i < n; ++i) {
+    lo ^= s[i];
+    std::uint64_t a = (lo & 0xffffffff) * 0x13b;
+    std::uint64_t b = (lo >> 32) * 0x13b;
+    std::uint64_t carry = (b >> 32) + (((b & 0xffffffff) + (a >> 32)) >> 32);
+    hi = hi * 0x13b + carry + (lo << 24);
+    lo = a + (b << 32);
+  }
+}
+
+
+void
+Content_hash::put(String const& s)
+{
+  put(std::uint64_t(s.size()));
+  put(s.data(), s.size());
+}
+
+
+// Values are hashed in little-endian order, so that a key does not
+// depend on the byte order of the host.
+void
+Content_hash::put(std::uint64_t n)
+{
+  unsigned char bytes[8];
+  for (int i = 0; i < 8; ++i)
+    bytes[i] = (n >> (8 * i)) & 0xff;
+  put(bytes, 8);
+}
+
+
+String
+Content_hash::str() const
+{
+  static char const digits[] = "0123456789abcdef";
+  String s(32, '0');
+  for (int i = 0; i < 16; ++i) {
+    s[31 - i] = digits[(lo >> (4 * i)) & 0xf];
+    s[15 - i] = digits[(hi >> (4 * i)) & 0xf];
+  }
+  return s;
+}
+
+
+// Hash the identity of the running compiler: the size and modification
+// time of its executable. Rebuilding the compiler invalidates the cache.
+// The build date is not hashed, so that identical builds can share a
+// cache.
+void
+hash_compiler(Content_hash& h)
+{
+  h.put(String("banjo"));
+  struct stat st;
+  if (::stat("/proc/self/exe", &st) == 0) {
+    h.put(std::uint64_t(st.st_size));
+    h.put(std::uint64_t(st.st_mtime));
+  }
+}
+
+
+// Hash the kinds and spellings of the tokens in `toks`. Locations are
+// not hashed, so changes to whitespace and comments do not change the
+// hash. Each distinct spelling is hashed once, and each token by the
+// index of its spelling.
+void
+hash_tokens(Content_hash& h, Token_buffer const& toks)
+{
+  h.put(std::uint64_t(toks.symtab.size()));
+  for (Symbol const* sym : toks.symtab)
+    h.put(String(sym->spelling()));
+  h.put(std::uint64_t(toks.size()));
+  for (std::size_t i = 0; i < toks.size(); ++i) {
+    h.put(std::uint64_t(toks.kinds[i]));
+    h.put(std::uint64_t(toks.syms[i]));
+  }
+}
+
+
+// Hash the kinds and spellings of the tokens in the range [first, last)
+// of `toks`. The hash does not depend on the other tokens in the
+// buffer.
+void
+hash_tokens(Content_hash& h, Token_buffer const& toks, std::size_t first, std::size_t last)
+{
+  h.put(std::uint64_t(last - first));
+  for (std::size_t i = first; i < last; ++i) {
+    h.put(std::uint64_t(toks.kinds[i]));
+    h.put(String(toks.symbol(i)->spelling()));
+  }
+}
+
+
+// -------------------------------------------------------------------------- //
+// Compile cache
+
+namespace
+{
+
+[[noreturn]] void
+cache_error(char const* what, String const& path)
+{
+  throw Translation_error("cannot {} '{}': {}", what, path, std::strerror(errno));
+}
+
+
+// Create the directory `path` and its parents, if they do not exist.
+void
+make_directories(String const& path)
+{
+  for (std::size_t i = 1; i <= path.size(); ++i) {
+    if (i != path.size() && path[i] != '/')
+      continue;
+    String dir = path.substr(0, i);
+    if (::mkdir(dir.c_str(), 0777) != 0 && errno != EEXIST)
+      cache_error("create directory", dir);
+  }
+}
+
+
+// Copy the file at `from` to `to`.
+void
+copy_file(String const& from, String const& to)
+{
+  std::ifstream in(from, std::ios::binary);
+  if (!in)
+    cache_error("open", from);
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  if (!out)
+    cache_error("create", to);
+  out << in.rdbuf();
+  if (!out)
+    cache_error("write", to);
+}
+
+
+// Returns true if `name` is the name of a cache entry: the 32
+// hexadecimal digits of a key.
+bool
+is_entry_name(char const* name)
+{
+  std::size_t n = 0;
+  for (; name[n]; ++n)
+    if (!std::isxdigit((unsigned char)name[n]))
+      return false;
+  return n == 32;
+}
+
+
+// The name of the file that accumulates statistics.
+char const stats_file[] = "stats";
+
+
+// Read statistics from the file `path`. A missing or malformed file
+// is treated as though no statistics were recorded.
+Cache_stats
+read_stats(String const& path)
+{
+  Cache_stats st;
+  std::ifstream in(path);
+  if (!(in >> st.hits >> st.misses >> st.inserts >> st.evictions))
+    return Cache_stats();
+  return st;
+}
+
+
+// A cache entry considered for eviction.
+struct Entry
+{
+  String         name;
+  std::time_t    time;
+  std::uintmax_t size;
+};
+
+} // namespace
+
+
+// Open the cache in the directory `dir`, creating it if needed. The
+// total size of entries is limited to `limit` bytes.
+Compile_cache::Compile_cache(String const& dir, std::uintmax_t limit)
+  : dir(dir), limit(limit)
+{
+  make_directories(dir);
+  saved_ = read_stats(dir + '/' + stats_file);
+}
+
+
+// Accumulate the statistics of this process in the cache directory.
+// The file is replaced, not modified, so that it is never read when
+// partially written. Failures are ignored; the statistics are only
+// informative.
+Compile_cache::~Compile_cache()
+{
+  Cache_stats st = totals();
+  String path = dir + '/' + stats_file;
+  String tmp = path + '.' + std::to_string(::getpid());
+  {
+    std::ofstream out(tmp);
+    out << st.hits << ' ' << st.misses << ' '
+        << st.inserts << ' ' << st.evictions << '\n';
+    if (!out)
+      return;
+  }
+  if (std::rename(tmp.c_str(), path.c_str()) != 0)
+    std::remove(tmp.c_str());
+}
+
+
+Cache_stats
+Compile_cache::totals() const
+{
+  Cache_stats st = saved_;
+  st.hits += stats_.hits;
+  st.misses += stats_.misses;
+  st.inserts += stats_.inserts;
+  st.evictions += stats_.evictions;
+  return st;
+}
+
+
+// Returns the path of the entry for `key`.
+String
+Compile_cache::entry(String const& key) const
+{
+  return dir + '/' + key;
+}
+
+
+// If there is an entry for `key`, copy it to `output`, mark it as
+// recently used, and return true. Otherwise, return false.
+bool
+Compile_cache::find(String const& key, String const& output)
+{
+  String path = entry(key);
+  if (::access(path.c_str(), R_OK) != 0) {
+    ++stats_.misses;
+    return false;
+  }
+  copy_file(path, output);
+  ::utime(path.c_str(), nullptr);
+  ++stats_.hits;
+  return true;
+}
+
+
+// Store a copy of the file `output` as the entry for `key`, and then
+// evict entries until the cache is within its size limit.
+void
+Compile_cache::insert(String const& key, String const& output)
+{
+  String path = entry(key);
+  String tmp = path + '.' + std::to_string(::getpid());
+  copy_file(output, tmp);
+  if (std::rename(tmp.c_str(), path.c_str()) != 0) {
+    std::remove(tmp.c_str());
+    cache_error("store", path);
+  }
+  ++stats_.inserts;
+  evict();
+}
+
+
+// Remove the least recently used entries until their total size is
+// within the limit.
+void
+Compile_cache::evict()
+{
+  DIR* d = ::opendir(dir.c_str());
+  if (!d)
+    cache_error("read directory", dir);
+  std::vector<Entry> entries;
+  std::uintmax_t total = 0;
+  while (dirent* e = ::readdir(d)) {
+    if (!is_entry_name(e->d_name))
+      continue;
+    String path = dir + '/' + e->d_name;
+    struct stat st;
+    if (::stat(path.c_str(), &st) != 0)
+      continue;
+    entries.push_back({e->d_name, st.st_mtime, std::uintmax_t(st.st_size)});
+    total += st.st_size;
+  }
+  ::closedir(d);
+
+  if (total <= limit)
+    return;
+  std::sort(entries.begin(), entries.end(), [](Entry const& a, Entry const& b) {
+    return a.time < b.time;
+  });
+  for (Entry const& e : entries) {
+    if (total <= limit)
+      break;
+    if (std::remove(entry(e.name).c_str()) == 0) {
+      total -= e.size;
+      ++stats_.evictions;
+    }
+  }
+}
+
+
+} // namespace banjo
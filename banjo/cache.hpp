@@ -0,0 +1,119 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_CACHE_HPP
+#define BANJO_CACHE_HPP
+
+// This module provides a persistent cache of compiler output.
+//
+// The output of a compilation is stored in a directory, keyed by a
+// hash of everything that determines it: the lexed tokens of the
+// program, the options that affect code generation, the contents of
+// imported modules, and the identity of the compiler. When the same
+// translation unit is compiled again, possibly on another branch or
+// in another build tree, the cached output is copied to the output
+// path, and parsing, elaboration, and code generation are skipped.
+//
+// The cache has a bounded size. When an insertion makes it too large,
+// the least recently used entries are removed. An entry is used when
+// it is inserted or found, and its modification time records that.
+//
+// Entries are written to a temporary file and then renamed, so that
+// concurrent compilations sharing a cache never see a partial entry.
+
+#include "prelude.hpp"
+
+#include <cstdint>
+
+
+namespace banjo
+{
+
+struct Token_buffer;
+
+
+// Computes a 128-bit FNV-1a hash of a sequence of values. Strings are
+// hashed with their length, so that adjacent strings are not confused
+// with their concatenation. The hash is kept as two 64-bit halves.
+struct Content_hash
+{
+  Content_hash()
+    : hi(0x6c62272e07bb0142ull), lo(0x62b821756295c58dull)
+  { }
+
+  void put(void const*, std::size_t);
+  void put(String const&);
+  void put(std::uint64_t);
+
+  // Returns the hash as a string of 32 hexadecimal digits.
+  String str() const;
+
+  std::uint64_t hi;
+  std::uint64_t lo;
+};
+
+
+inline bool
+operator==(Content_hash const& a, Content_hash const& b)
+{
+  return a.hi == b.hi && a.lo == b.lo;
+}
+
+
+inline bool
+operator!=(Content_hash const& a, Content_hash const& b)
+{
+  return !(a == b);
+}
+
+
+void hash_compiler(Content_hash&);
+void hash_tokens(Content_hash&, Token_buffer const&);
+void hash_tokens(Content_hash&, Token_buffer const&, std::size_t, std::size_t);
+
+
+// Statistics about the use of the compile cache.
+struct Cache_stats
+{
+  std::size_t hits      = 0;
+  std::size_t misses    = 0;
+  std::size_t inserts   = 0;
+  std::size_t evictions = 0;
+};
+
+
+// An on-disk cache of compiler output. Each entry is a file in the
+// cache directory, named by its key.
+//
+// Statistics are kept for this process, and are accumulated in a
+// file in the cache directory when the cache is closed. Concurrent
+// compilations may lose some updates to the accumulated statistics.
+struct Compile_cache
+{
+  Compile_cache(String const&, std::uintmax_t);
+  ~Compile_cache();
+
+  bool find(String const&, String const&);
+  void insert(String const&, String const&);
+
+  // Returns the statistics for this process.
+  Cache_stats const& stats() const { return stats_; }
+
+  // Returns the statistics accumulated by all processes using the
+  // cache directory, including this one.
+  Cache_stats totals() const;
+
+  String entry(String const&) const;
+  void   evict();
+
+  String         dir;
+  std::uintmax_t limit; // The maximum size of all entries, in bytes
+  Cache_stats    stats_;
+  Cache_stats    saved_; // Statistics of earlier processes
+};
+
+
+} // namespace banjo
+
+
+#endif
@@ -0,0 +1,159 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+// The compile client forwards a compilation to a compile server.
+//
+//    banjo-client <socket> [arguments]...
+//
+// The arguments are those of banjo-compile. The server compiles in the
+// client's working directory, writing directly to the client's standard
+// output and error, and the client exits with the compiler's status.
+// See server.hpp for the protocol.
+
+#include "server.hpp"
+
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+
+
+using namespace banjo;
+
+
+namespace
+{
+
+int
+fail(char const* what, char const* path)
+{
+  std::cerr << "banjo-client: cannot " << what << " '" << path << "': "
+            << std::strerror(errno) << '\n';
+  return 1;
+}
+
+
+bool
+send_all(int fd, char const* p, std::size_t n)
+{
+  while (n) {
+    ssize_t k = ::send(fd, p, n, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+
+bool
+receive_all(int fd, char* p, std::size_t n)
+{
+  while (n) {
+    ssize_t k = ::recv(fd, p, n, 0);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    p += k;
+    n -= k;
+  }
+  return true;
+}
+
+
+// Send the length of the request with the standard streams of this
+// process.
+bool
+send_header(int fd, std::uint32_t len)
+{
+  iovec iov {&len, sizeof(len)};
+  union {
+    cmsghdr hdr;
+    char    buf[CMSG_SPACE(sizeof(int) * request_fds)];
+  } ctl;
+  std::memset(&ctl, 0, sizeof(ctl));
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctl.buf;
+  msg.msg_controllen = sizeof(ctl.buf);
+
+  cmsghdr* c = CMSG_FIRSTHDR(&msg);
+  c->cmsg_level = SOL_SOCKET;
+  c->cmsg_type = SCM_RIGHTS;
+  c->cmsg_len = CMSG_LEN(sizeof(int) * request_fds);
+  int fds[request_fds] = {0, 1, 2};
+  std::memcpy(CMSG_DATA(c), fds, sizeof(fds));
+
+  ssize_t n;
+  do
+    n = ::sendmsg(fd, &msg, MSG_NOSIGNAL);
+  while (n < 0 && errno == EINTR);
+  if (n < 0)
+    return false;
+  char const* rest = reinterpret_cast<char const*>(&len) + n;
+  return send_all(fd, rest, sizeof(len) - n);
+}
+
+} // namespace
+
+
+int
+main(int argc, char* argv[])
+{
+  if (argc < 2) {
+    std::cerr << "usage: banjo-client <socket> [arguments]...\n";
+    return 1;
+  }
+  char const* path = argv[1];
+
+  // The payload is the working directory and the arguments.
+  char* cwd = ::getcwd(nullptr, 0);
+  if (!cwd) {
+    std::cerr << "banjo-client: cannot get the working directory: "
+              << std::strerror(errno) << '\n';
+    return 1;
+  }
+  std::string payload(cwd, std::strlen(cwd) + 1);
+  std::free(cwd);
+  for (int i = 2; i < argc; ++i)
+    payload.append(argv[i], std::strlen(argv[i]) + 1);
+  if (payload.size() > max_request_size) {
+    std::cerr << "banjo-client: too many arguments\n";
+    return 1;
+  }
+
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (std::strlen(path) >= sizeof(addr.sun_path)) {
+    std::cerr << "banjo-client: socket path '" << path << "' is too long\n";
+    return 1;
+  }
+  std::strcpy(addr.sun_path, path);
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0)
+    return fail("create socket", path);
+  if (::connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) != 0)
+    return fail("connect to", path);
+
+  if (!send_header(fd, payload.size()) ||
+      !send_all(fd, payload.data(), payload.size()))
+    return fail("send request to", path);
+
+  std::int32_t status;
+  if (!receive_all(fd, reinterpret_cast<char*>(&status), sizeof(status))) {
+    std::cerr << "banjo-client: lost connection to '" << path << "'\n";
+    return 1;
+  }
+  ::close(fd);
+  return status;
+}
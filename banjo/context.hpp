@@ -8,6 +8,9 @@
 #include "builder.hpp"
 #include "scope.hpp"
 
+#include <mutex>
+#include <vector>
+
 
 namespace banjo
 {
@@ -19,6 +22,11 @@ struct Scope;
 using Scope_map = std::unordered_map<Decl*, Scope*>;
 
 
+// The modules imported into a translation unit.
+struct Module;
+using Module_list = std::vector<Module*>;
+
+
 // A repository of information to support translation.
 //
 // TODO: Add an allocator/object pool and management support.
@@ -36,6 +44,10 @@ struct Context : Builder
   Symbol_table const& symbols() const { return syms; }
   Symbol_table&       symbols()       { return syms; }
 
+  // Returns the lock that guards the symbol table when multiple lexers
+  // run concurrently. No other phase takes this lock.
+  std::mutex& symbols_lock() { return symlock; }
+
   // Unique ids
   int get_unique_id();
 
@@ -58,6 +70,7 @@ struct Context : Builder
   bool diagnose_errors() const { return diags; }
 
   Symbol_table syms;   // The symbol table
+  std::mutex   symlock; // Guards concurrent access to syms
   Location     input;  // The input location
  
   // Scope information
@@ -65,6 +78,9 @@ struct Context : Builder
   Scope*       scope;  // The current scope
   Scope_map    saved;  // Saved scopes.
 
+  // Imported modules, searched when lookup fails.
+  Module_list  imports;
+
   // Store information for generating unique names.
   int             id;     // The current id counter
 
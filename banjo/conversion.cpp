@@ -39,13 +39,42 @@ convert_object_to_value(Expr& e, Type& t)
 }
 
 
-// Perform at most one categorical conversion. There is currently
-// just one that could performed: object-to-value.
+// An object of array type T[N] or dynamic array type T[n] can be
+// converted to a value of slice type T[] that refers to its elements.
+// The elements of a const array cannot be viewed by a slice.
+//
+// In C++, this is similar to the array-to-pointer conversion.
+Expr&
+convert_array_to_slice(Expr& e, Slice_type& t)
+{
+  Reference_type* r = as<Reference_type>(&e.type());
+  if (!r)
+    return e;
+  if (Array_type* a = as<Array_type>(&r->type())) {
+    if (is_equivalent(a->type(), t.type()))
+      return *new Slice_conv(t, e);
+  }
+  if (Dynarray_type* a = as<Dynarray_type>(&r->type())) {
+    if (is_equivalent(a->type(), t.type()))
+      return *new Slice_conv(t, e);
+  }
+  return e;
+}
+
+
+// Perform at most one categorical conversion: array-to-slice or
+// object-to-value.
 Expr&
 convert_category(Expr& e, Type& t)
 {
-  if (!is<Reference_type>(&t))
+  if (!is<Reference_type>(&t)) {
+    if (Slice_type* s = as<Slice_type>(&t.unqualified_type())) {
+      Expr& c = convert_array_to_slice(e, *s);
+      if (&c != &e)
+        return c;
+    }
     return convert_object_to_value(e, t);
+  }
   return e;
 }
 
@@ -139,7 +168,7 @@ convert_to_float(Expr& e, Float_type& t)
 //    - numeric conversions (int to float)
 //    - boolean conversions
 //
-// TODO: Support conversion of T[N] to T[].
+// Conversions of T[N] to T[] are categorical; see convert_category.
 //
 // TODO: Support pointer conversions.
 //
@@ -569,6 +598,7 @@ get_conversion_sequence(Expr& e)
     Expr* operator()(Integer_conv& e)       { seq.conversion(e); return &e.source(); }
     Expr* operator()(Float_conv& e)         { seq.conversion(e); return &e.source(); }
     Expr* operator()(Numeric_conv& e)       { seq.conversion(e); return &e.source(); }
+    Expr* operator()(Slice_conv& e)         { seq.transformation(e); return &e.source(); }
 
     // This is handled elsewhere.
     Expr* operator()(Ellipsis_conv& e)      { lingo_unreachable(); }
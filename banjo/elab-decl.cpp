@@ -173,8 +173,7 @@ Parser::elaborate_type(Type& t)
 {
   if (Unparsed_type* soup = as<Unparsed_type>(&t)) {
     Save_input_location loc(cxt);
-    Token_stream ts(soup->tokens());
-    Parser parse(cxt, ts);
+    Parser parse(cxt, soup->tokens());
     return parse.type();
   }
   return t;
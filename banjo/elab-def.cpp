@@ -4,6 +4,7 @@
 #include "parser.hpp"
 #include "printer.hpp"
 #include "declaration.hpp"
+#include "evaluation.hpp"
 #include "ast.hpp"
 
 #include <iostream>
@@ -128,6 +129,7 @@ Parser::elaborate_function_definition(Function_decl& decl, Expression_def& def)
   Stmt& ret = cxt.make_return_statement(expr);
   Stmt& body = cxt.make_compound_statement({&ret});
   decl.def_ = &cxt.make_function_definition(body);
+  allocate_frame(decl);
 }
 
 
@@ -148,6 +150,9 @@ Parser::elaborate_function_definition(Function_decl& decl, Function_def& def)
   // Update the definition with the new statement. We don't need
   // to update the declaration.
   def.stmt_ = &stmt;
+
+  // Assign evaluation slots to parameters and locals.
+  allocate_frame(decl);
 }
 
 
@@ -188,8 +193,7 @@ Parser::elaborate_expression(Expr& e)
 {
   if (Unparsed_expr* soup = as<Unparsed_expr>(&e)) {
     Save_input_location loc(cxt);
-    Token_stream ts(soup->tokens());
-    Parser parse(cxt, ts);
+    Parser parse(cxt, soup->tokens());
     return parse.expression();
   }
   return e;
@@ -201,8 +205,7 @@ Parser::elaborate_compound_statement(Stmt& s)
 {
   if (Unparsed_stmt* soup = as<Unparsed_stmt>(&s)) {
     Save_input_location loc(cxt);
-    Token_stream ts(soup->tokens());
-    Parser parse(cxt, ts);
+    Parser parse(cxt, soup->tokens());
     return parse.compound_statement();
   }
   return s;
@@ -214,8 +217,7 @@ Parser::elaborate_member_statement(Stmt& s)
 {
   if (Unparsed_stmt* soup = as<Unparsed_stmt>(&s)) {
     Save_input_location loc(cxt);
-    Token_stream ts(soup->tokens());
-    Parser parse(cxt, ts);
+    Parser parse(cxt, soup->tokens());
     return parse.member_statement();
   }
   return s;
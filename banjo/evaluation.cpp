@@ -3,27 +3,146 @@
 
 #include "evaluation.hpp"
 #include "ast.hpp"
+#include "budget.hpp"
 #include "builder.hpp"
 #include "printer.hpp"
+#include "report.hpp"
 
+#include <algorithm>
 #include <iostream>
 
 
 namespace banjo
 {
 
+// -------------------------------------------------------------------------- //
+// Frames
+
+// Returns a pointer to a new frame of `n` values. The values are
+// initialized to the error value.
+Value*
+Frame_stack::push(std::size_t n)
+{
+  if (chunk == chunks.size() || top + n > chunks[chunk].size) {
+    // Move to the next chunk, discarding it if it is too small
+    // to hold the frame. Later chunks are unused.
+    if (chunk != chunks.size())
+      ++chunk;
+    if (chunk != chunks.size() && chunks[chunk].size < n)
+      chunks.resize(chunk);
+    if (chunk == chunks.size()) {
+      std::size_t size = std::max(chunk_size, n);
+      chunks.push_back({std::unique_ptr<Value[]>(new Value[size]), size});
+    }
+    top = 0;
+  }
+  Value* p = chunks[chunk].data.get() + top;
+  std::fill(p, p + n, Value());
+  top += n;
+  return p;
+}
+
+
+namespace
+{
+
+// Assigns frame slots to the parameters and local variables of
+// a function. Variables in disjoint blocks share slots.
+struct Frame_layout
+{
+  Frame_layout()
+    : next(0), size(0)
+  { }
+
+  void allocate(Decl&);
+  void statement(Stmt&);
+
+  int next;
+  int size;
+};
+
+
+void
+Frame_layout::allocate(Decl& d)
+{
+  if (Object_decl* obj = as<Object_decl>(&d)) {
+    obj->slot_ = next++;
+    size = std::max(size, next);
+  }
+}
+
+
+void
+Frame_layout::statement(Stmt& s)
+{
+  struct fn
+  {
+    Frame_layout& self;
+    void operator()(Stmt& s)             { }
+    void operator()(Declaration_stmt& s) { self.allocate(s.declaration()); }
+    void operator()(If_then_stmt& s)     { self.statement(s.true_branch()); }
+    void operator()(While_stmt& s)       { self.statement(s.body()); }
+
+    void operator()(Compound_stmt& s)
+    {
+      int mark = self.next;
+      for (Stmt& s1 : s.statements())
+        self.statement(s1);
+      self.next = mark;
+    }
+
+    void operator()(If_else_stmt& s)
+    {
+      self.statement(s.true_branch());
+      self.statement(s.false_branch());
+    }
+  };
+  apply(s, fn{*this});
+}
+
+} // namespace
+
+
+// Assign frame slots to the parameters and local variables of `f`,
+// and record the size of its frame. This is done once, when the
+// definition of `f` has been elaborated.
+void
+allocate_frame(Function_decl& f)
+{
+  Frame_layout layout;
+  for (Decl& p : f.parameters())
+    layout.allocate(p);
+  if (Function_def* def = as<Function_def>(&f.definition()))
+    layout.statement(def->statement());
+  f.frame_ = layout.size;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Memory management
+
+// Returns the value stored for the local object `d` in the
+// current frame.
+//
+// FIXME: Global variables have no storage.
+Value&
+Evaluator::local(Object_decl const& d)
+{
+  if (!frame || d.slot() < 0)
+    throw Evaluation_error("object is not a local variable");
+  return frame[d.slot()];
+}
+
+
 // Returns a reference to the object or function corresponding
 // do the declaration `d`.
-//
-// FIXME: If d refers to a global variable, then we may not
-// have a binding for for it. We most definitely should.
 Value
 Evaluator::alias(Decl const& d)
 {
   // If the expression refers to an object, then produce
   // a reference to its stored value.
   if (Object_decl const* var = as<Object_decl>(&d))
-    return &stack.lookup(var)->second;
+    return &local(*var);
 
   // If the expression refers to a function, then produce
   // a reference to that function.
@@ -43,7 +162,7 @@ Evaluator::load(Decl const& d)
   // If the expression refers to an object, then produce
   // a reference to its stored value.
   if (Object_decl const* var = as<Object_decl>(&d))
-    return stack.lookup(var)->second;
+    return local(*var);
 
   // What else?
   banjo_unhandled_case(d);
@@ -53,13 +172,12 @@ Evaluator::load(Decl const& d)
 // Stores a value in the object corresponding to the given
 // declaration. This copies the value into the object, and
 // returns a reference to that value.
-//
-// FIXME: We should not be able to store values in objects that
-// have not been allocated.
 Value&
 Evaluator::store(Decl const& d, Value const& v)
 {
-  return stack.top().rebind(&d, v).second;
+  if (Object_decl const* var = as<Object_decl>(&d))
+    return local(*var) = v;
+  banjo_unhandled_case(d);
 }
 
 
@@ -90,9 +208,25 @@ Evaluator::alloca(Decl const& d)
 // -------------------------------------------------------------------------- //
 // Evaluation of expressions
 
+// Evaluate `e` as a complete evaluation. Aggregates created while
+// evaluating `e` are reclaimed when the outermost evaluation ends,
+// except for those in the result.
+Value
+Evaluator::operator()(Expr const& e)
+{
+  Phase_timer timer(evaluation_phase);
+  Enter_evaluation scope;
+  if (scope.outermost())
+    evaluation_budget().reset();
+  return scope.result(evaluate(e));
+}
+
+
 Value
 Evaluator::evaluate(Expr const& e)
 {
+  evaluation_budget().step();
+
   struct fn
   {
     Evaluator& self;
@@ -101,9 +235,35 @@ Evaluator::evaluate(Expr const& e)
     Value operator()(Integer_expr const& e) { return self.evaluate_integer(e); }
     Value operator()(Decl_expr const& e)    { return self.evaluate_reference(e); }
     Value operator()(Call_expr const& e)    { return self.evaluate_call(e); }
+    Value operator()(Add_expr const& e)     { return self.evaluate_binary(e); }
+    Value operator()(Sub_expr const& e)     { return self.evaluate_binary(e); }
+    Value operator()(Mul_expr const& e)     { return self.evaluate_binary(e); }
+    Value operator()(Div_expr const& e)     { return self.evaluate_binary(e); }
+    Value operator()(Rem_expr const& e)     { return self.evaluate_binary(e); }
+    Value operator()(Neg_expr const& e)     { return self.evaluate_unary(e); }
+    Value operator()(Pos_expr const& e)     { return self.evaluate_unary(e); }
+    Value operator()(Bit_and_expr const& e) { return self.evaluate_binary(e); }
+    Value operator()(Bit_or_expr const& e)  { return self.evaluate_binary(e); }
+    Value operator()(Bit_xor_expr const& e) { return self.evaluate_binary(e); }
+    Value operator()(Bit_lsh_expr const& e) { return self.evaluate_binary(e); }
+    Value operator()(Bit_rsh_expr const& e) { return self.evaluate_binary(e); }
+    Value operator()(Bit_not_expr const& e) { return self.evaluate_unary(e); }
+    Value operator()(Eq_expr const& e)      { return self.evaluate_binary(e); }
+    Value operator()(Ne_expr const& e)      { return self.evaluate_binary(e); }
+    Value operator()(Lt_expr const& e)      { return self.evaluate_binary(e); }
+    Value operator()(Gt_expr const& e)      { return self.evaluate_binary(e); }
+    Value operator()(Le_expr const& e)      { return self.evaluate_binary(e); }
+    Value operator()(Ge_expr const& e)      { return self.evaluate_binary(e); }
+    Value operator()(Cmp_expr const& e)     { return self.evaluate_binary(e); }
     Value operator()(And_expr const& e)     { return self.evaluate_and(e); }
     Value operator()(Or_expr const& e)      { return self.evaluate_or(e); }
     Value operator()(Not_expr const& e)     { return self.evaluate_not(e); }
+    Value operator()(Value_conv const& e)   { return self.evaluate_load(e); }
+    Value operator()(Integer_conv const& e) { return self.evaluate_conversion(e); }
+    Value operator()(Copy_init const& e)    { return self.evaluate(e.expression()); }
+
+    Value operator()(Qualification_conv const& e) { return self.evaluate(e.source()); }
+    Value operator()(Boolean_conv const& e)       { return self.evaluate(e.source()).get_integer() != 0; }
   };
   return apply(e, fn{*this});
 }
@@ -116,12 +276,15 @@ Evaluator::evaluate_boolean(Boolean_expr const& e)
 }
 
 
+// The value of an integer is represented as in the register machine,
+// sign- or zero-extended from the precision of its type.
 Value
 Evaluator::evaluate_integer(Integer_expr const& e)
 {
-  // FIXME: Eh? Is this right? Does it matter? It wouldn't if the
-  // value contained an actual integer.
-  return Integer_value(e.value().getu());
+  Integer_value n = e.value().getu();
+  if (Integer_type const* t = as<Integer_type>(&e.type().unqualified_type()))
+    n = extend(n, t->precision(), t->is_signed());
+  return n;
 }
 
 
@@ -140,6 +303,20 @@ Evaluator::evaluate_call(Call_expr const& e)
   Value v = evaluate(e.function());
   Function_decl const& f = *v.get_function();
 
+  // Arguments are evaluated in the caller's frame, exactly once.
+  Expr_list const& args = e.arguments();
+  Value_list vals;
+  vals.reserve(args.size());
+  for (Expr const& arg : args)
+    vals.push_back(evaluate(arg));
+  return call(f, vals);
+}
+
+
+// Call the function `f` with the given arguments.
+Value
+Evaluator::call(Function_decl const& f, Value_list const& vals)
+{
   // There should probably be a body for the function.
   //
   // FIXME: What if the function is = default. How do we determine
@@ -152,21 +329,26 @@ Evaluator::evaluate_call(Call_expr const& e)
   if (!def)
     lingo_unreachable();
 
+  // Prefer the bytecode machine when the function can be lowered.
+  // Otherwise, interpret the definition directly.
+  if (Bytecode const* code = bytecode ? lower(f) : nullptr) {
+    Value result;
+    if (!code->failed && vm.execute(*code, vals, result))
+      return result;
+  }
+
   // Each parameter is declared as a local variable within the
   // function.
-  Enter_frame frame(*this);
-  Expr_list const& args = e.arguments();
+  Enter_call call(evaluation_budget(), f);
+  Enter_frame frame(*this, f);
   Decl_list const& parms = f.parameters();
-  auto ai = args.begin();
+  auto vi = vals.begin();
   auto pi = parms.begin();
-  while (ai != args.end() && pi != parms.end()) {
-    Expr const& arg = *ai;
-    Decl const& parm = *pi;
-
+  while (vi != vals.end() && pi != parms.end()) {
     // TODO: Parameters are copy-initialized. Reuse initialization
     // here, insted of this kind of direct storage. Use alloca
     // and then dispatch to the initializer.
-    store(parm, evaluate(arg));
+    store(*pi++, *vi++);
   }
 
   // Evaluate the function definition.
@@ -183,6 +365,113 @@ Evaluator::evaluate_call(Call_expr const& e)
 }
 
 
+// Arithmetic, bitwise and relational operators. Values of integer type
+// are represented as in the register machine: sign- or zero-extended
+// from the precision of their type. Arithmetic wraps, and operations
+// whose result is undefined in the compiled program fail.
+namespace
+{
+
+using Word = std::uint64_t;
+
+
+// Returns the integer type of `e`, or nullptr if `e` has boolean type.
+inline Integer_type const*
+integer_type(Expr const& e)
+{
+  return as<Integer_type>(&e.type().unqualified_type());
+}
+
+
+// Returns `n` as a value of the type of `e`.
+inline Value
+result(Expr const& e, Word n)
+{
+  if (Integer_type const* t = integer_type(e))
+    return extend(n, t->precision(), t->is_signed());
+  return Integer_value(n);
+}
+
+} // namespace
+
+
+Value
+Evaluator::evaluate_unary(Unary_expr const& e)
+{
+  struct fn
+  {
+    Word a;
+    Word operator()(Expr const& e)         { banjo_unhandled_case(e); }
+    Word operator()(Neg_expr const& e)     { return -a; }
+    Word operator()(Pos_expr const& e)     { return a; }
+    Word operator()(Bit_not_expr const& e) { return ~a; }
+  };
+  Word a = evaluate(e.operand()).get_integer();
+  return result(e, apply(e, fn{a}));
+}
+
+
+// The operands of a binary operator have the same type. Operations
+// that depend on its sign or precision are computed explicitly.
+Value
+Evaluator::evaluate_binary(Binary_expr const& e)
+{
+  struct fn
+  {
+    Integer_value a;
+    Integer_value b;
+    int           w;
+    bool          s;
+
+    Word operator()(Expr const& e)         { banjo_unhandled_case(e); }
+    Word operator()(Add_expr const& e)     { return Word(a) + Word(b); }
+    Word operator()(Sub_expr const& e)     { return Word(a) - Word(b); }
+    Word operator()(Mul_expr const& e)     { return Word(a) * Word(b); }
+    Word operator()(Div_expr const& e)     { divisor(); return s ? Word(a / b) : Word(a) / Word(b); }
+    Word operator()(Rem_expr const& e)     { divisor(); return s ? Word(a % b) : Word(a) % Word(b); }
+    Word operator()(Bit_and_expr const& e) { return Word(a) & Word(b); }
+    Word operator()(Bit_or_expr const& e)  { return Word(a) | Word(b); }
+    Word operator()(Bit_xor_expr const& e) { return Word(a) ^ Word(b); }
+    Word operator()(Bit_lsh_expr const& e) { amount(); return Word(a) << b; }
+    Word operator()(Bit_rsh_expr const& e) { amount(); return s ? Word(a >> b) : Word(a) >> b; }
+    Word operator()(Eq_expr const& e)      { return a == b; }
+    Word operator()(Ne_expr const& e)      { return a != b; }
+    Word operator()(Lt_expr const& e)      { return s ? a < b : Word(a) < Word(b); }
+    Word operator()(Gt_expr const& e)      { return s ? a > b : Word(a) > Word(b); }
+    Word operator()(Le_expr const& e)      { return s ? a <= b : Word(a) <= Word(b); }
+    Word operator()(Ge_expr const& e)      { return s ? a >= b : Word(a) >= Word(b); }
+
+    Word operator()(Cmp_expr const& e)
+    {
+      if (s)
+        return Integer_value((a > b) - (a < b));
+      return Integer_value((Word(a) > Word(b)) - (Word(a) < Word(b)));
+    }
+
+    // The least value of a signed type divided by -1 overflows.
+    void divisor()
+    {
+      if (b == 0)
+        throw Evaluation_error("division by zero");
+      if (s && b == -1 && a == extend(Word(1) << (w - 1), w, true))
+        throw Evaluation_error("division overflow");
+    }
+
+    void amount()
+    {
+      if (b < 0 || b >= w)
+        throw Evaluation_error("shift amount out of range");
+    }
+  };
+  Integer_value a = evaluate(e.left()).get_integer();
+  Integer_value b = evaluate(e.right()).get_integer();
+  Integer_type const* t = integer_type(e.left());
+  int w = t ? t->precision() : 1;
+  bool s = t && t->is_signed();
+  return result(e, apply(e, fn{a, b, w, s}));
+}
+
+
 Value
 Evaluator::evaluate_and(And_expr const& e)
 {
@@ -213,6 +502,25 @@ Evaluator::evaluate_not(Not_expr const& e)
 }
 
 
+// Load the value of the object referred to by the operand.
+Value
+Evaluator::evaluate_load(Value_conv const& e)
+{
+  Value v = evaluate(e.source());
+  if (v.is_reference())
+    return *v.get_reference();
+  return v;
+}
+
+
+Value
+Evaluator::evaluate_conversion(Integer_conv const& e)
+{
+  Value v = evaluate(e.source());
+  return result(e, v.get_integer());
+}
+
+
 // -------------------------------------------------------------------------- //
 // Evaluation of statements
 
@@ -223,6 +531,8 @@ Evaluator::evaluate_not(Not_expr const& e)
 Control
 Evaluator::evaluate(Stmt const& s, Value& r)
 {
+  evaluation_budget().step();
+
   struct fn
   {
     Evaluator& self;
@@ -238,10 +548,11 @@ Evaluator::evaluate(Stmt const& s, Value& r)
 }
 
 
+// Note that the variables of a block are allocated in the frame of
+// the enclosing function, so entering a block does not allocate.
 Control
 Evaluator::evaluate_block(Compound_stmt const& s, Value& r)
 {
-  Enter_frame frame(*this);
   for (Stmt const& s1 : s.statements()) {
     Control ctl = evaluate(s1, r);
     switch (ctl) {
@@ -307,6 +618,53 @@ Evaluator::elaborate_object(Object_decl const& d)
 }
 
 
+// -------------------------------------------------------------------------- //
+// Evaluation of coroutines
+//
+// A coroutine is evaluated as a resumable frame. Starting a coroutine
+// binds its arguments to its parameters without running its body.
+// Each resumption runs the body from the point of the last yield to
+// the next, so consuming all n values of a coroutine takes time
+// proportional to the steps of its body, not to n times that.
+//
+// Coroutines are executed by the bytecode machine, so their parameters,
+// locals and values must be scalars.
+
+// Returns a new coroutine for `c` with the given arguments. The
+// coroutine is owned by this evaluator.
+Coroutine_state*
+Evaluator::start(Coroutine_decl const& c, Value_list const& args)
+{
+  Bytecode const* code = lower(c);
+  if (!code)
+    throw Evaluation_error("coroutine cannot be evaluated");
+  if (args.size() != c.parameters().size())
+    throw Evaluation_error("wrong number of arguments to coroutine");
+
+  std::unique_ptr<Coroutine_state> co(new Coroutine_state(*code));
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (!args[i].is_integer())
+      throw Evaluation_error("coroutine argument is not a scalar");
+    co->regs[i] = args[i].get_integer();
+  }
+  coroutines.push_back(std::move(co));
+  return coroutines.back().get();
+}
+
+
+// Run the coroutine `co` to its next yield, storing the yielded value
+// in `v`. Returns false when the coroutine has finished.
+bool
+Evaluator::resume(Coroutine_state& co, Value& v)
+{
+  Integer_value n;
+  if (!vm.resume(co, n))
+    return false;
+  v = n;
+  return true;
+}
+
+
 // -------------------------------------------------------------------------- //
 // Reduction
 
@@ -8,28 +8,56 @@
 #include "ast.hpp"
 #include "context.hpp"
 #include "value.hpp"
+#include "vm.hpp"
 
-#include <lingo/environment.hpp>
+#include <memory>
 
 
 namespace banjo
 {
 
-// TODO: Specialize the store and call stack to use load and store
-// instead of lookup and bind. That's a bit more conventional for
-// the kinds of operations here.
+// The frame stack holds the parameters and local variables of active
+// function calls. Each parameter and local variable is assigned a
+// slot within its function's frame during elaboration (see
+// allocate_frame), so variable access is an indexed load.
+//
+// Frames are carved from a list of chunks that are never reallocated,
+// so a frame is contiguous and references to its values remain valid
+// while the frame is live. Chunks are retained when frames are popped
+// so that later calls do not allocate.
+struct Frame_stack
+{
+  static constexpr std::size_t chunk_size = 4096;
 
+  // A contiguous region of values.
+  struct Chunk
+  {
+    std::unique_ptr<Value[]> data;
+    std::size_t              size;
+  };
 
-// Dynamic binding of declarations to their values.
-using Store = Environment<Decl const*, Value>;
+  // A saved position in the stack.
+  struct Mark
+  {
+    std::size_t chunk;
+    std::size_t top;
+  };
 
+  Frame_stack()
+    : chunk(0), top(0)
+  { }
 
-// The store stack maintains the dynamic binding between symbols
-// and their values. Each time a new binding environment is entered
-// (e.g., a block scope), a new frame is created to store bindings.
-//
-// This is also the call stack.
-using Call_stack = Stack<Store>;
+  Value* push(std::size_t);
+  Mark   mark() const { return {chunk, top}; }
+  void   release(Mark m) { chunk = m.chunk; top = m.top; }
+
+  std::vector<Chunk> chunks;
+  std::size_t        chunk;
+  std::size_t        top;
+};
+
+
+void allocate_frame(Function_decl&);
 
 
 // Represents the evaluation of a statement. This determines the
@@ -50,16 +78,22 @@ enum Control
 struct Evaluator
 {
 public:
-  Value operator()(Expr const& e) { return evaluate(e); }
+  Value operator()(Expr const&);
 
   Value evaluate(Expr const&);
   Value evaluate_boolean(Boolean_expr const&);
   Value evaluate_integer(Integer_expr const&);
   Value evaluate_reference(Decl_expr const&);
   Value evaluate_call(Call_expr const&);
+  Value evaluate_unary(Unary_expr const&);
+  Value evaluate_binary(Binary_expr const&);
   Value evaluate_and(And_expr const&);
   Value evaluate_or(Or_expr const&);
   Value evaluate_not(Not_expr const&);
+  Value evaluate_load(Value_conv const&);
+  Value evaluate_conversion(Integer_conv const&);
+
+  Value call(Function_decl const&, Value_list const&);
 
   Control evaluate(Stmt const&, Value&);
   Control evaluate_block(Compound_stmt const&, Value&);
@@ -70,7 +104,12 @@ public:
   void elaborate(Decl const&);
   void elaborate_object(Object_decl const&);
 
+  // Coroutines
+  Coroutine_state* start(Coroutine_decl const&, Value_list const&);
+  bool             resume(Coroutine_state&, Value&);
+
   // Memory management
+  Value& local(Object_decl const&);
   Value  alias(Decl const&);
   Value  load(Decl const&);
   Value& store(Decl const&, Value const&);
@@ -78,25 +117,39 @@ public:
 
   struct Enter_frame;
 
-  Call_stack stack;
+  Evaluator()
+    : frame(nullptr), bytecode(true)
+  { }
+
+  Frame_stack     stack;
+  Value*          frame;
+  Virtual_machine vm;
+  bool            bytecode; // Run lowered functions on the machine
+
+  // Coroutines started by this evaluator.
+  std::vector<std::unique_ptr<Coroutine_state>> coroutines;
 };
 
 
-// A helper class for managing stack frames.
+// A helper class for managing stack frames. This allocates the frame
+// for a call to a function and makes it the current frame.
 struct Evaluator::Enter_frame
 {
-  Enter_frame(Evaluator& e)
-    : eval(e)
+  Enter_frame(Evaluator& e, Function_decl const& f)
+    : eval(e), mark(e.stack.mark()), prev(e.frame)
   {
-    eval.stack.push();
+    eval.frame = eval.stack.push(f.frame_size());
   }
 
   ~Enter_frame()
   {
-    eval.stack.pop();
+    eval.stack.release(mark);
+    eval.frame = prev;
   }
 
-  Evaluator& eval;
+  Evaluator&         eval;
+  Frame_stack::Mark  mark;
+  Value*             prev;
 };
 
 
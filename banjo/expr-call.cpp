@@ -13,6 +13,7 @@
 #include "deduction.hpp"
 #include "subsumption.hpp"
 #include "printer.hpp"
+#include "report.hpp"
 
 #include <iostream>
 
@@ -53,6 +54,7 @@ make_dependent_template_call(Context& cxt, Template_ref& e, Expr_list& args)
 
         // The call is admissible iff the current constraints subsume
         // those of the the candidate function.
+        Phase_timer timer(constraint_phase);
         if (!subsumes(cxt, ccons, fcons))
           warning(cxt, "call to function template '{}' not covered by constraints", e);
       }
@@ -83,7 +85,12 @@ make_dependent_call(Context& cxt, Expr& e, Expr_list& args)
 
   // Determine if the constraints explicitly admit this declaration.
   Expr& cons = *cxt.current_template_constraints();
-  if (Expr* ret = admit_expression(cxt, cons, init))
+  Expr* ret;
+  {
+    Phase_timer timer(constraint_phase);
+    ret = admit_expression(cxt, cons, init);
+  }
+  if (ret)
     return *ret;
 
   // Otherwise, e refers to a previous declaration, possibly many.
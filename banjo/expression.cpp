@@ -81,4 +81,29 @@ make_tuple_expr(Context& cxt, Expr_list& es)
 }
 
 
+// Returns a new subscript expression. The index is converted to a value.
+// The result refers to an element of the indexed object, so its type is
+// a reference to the element type. The index must have integer type;
+// booleans and floating point values are not converted.
+Expr&
+make_index(Context& cxt, Expr& e1, Expr& e2)
+{
+  Type& t = e1.type().non_reference_type().unqualified_type();
+  Type* elem;
+  if (Array_type* a = as<Array_type>(&t))
+    elem = &a->type();
+  else if (Dynarray_type* d = as<Dynarray_type>(&t))
+    elem = &d->type();
+  else if (Slice_type* s = as<Slice_type>(&t))
+    elem = &s->type();
+  else
+    throw Type_error("an expression of type '{}' cannot be indexed", t);
+
+  Expr& i = convert_to_value(cxt, e2);
+  if (!is_integer_type(i.type().unqualified_type()))
+    throw Type_error("an index must have integer type, not '{}'", i.type());
+  return cxt.make_index(cxt.get_reference_type(*elem), e1, i);
+}
+
+
 } // namespace banjo
@@ -0,0 +1,122 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "file.hpp"
+
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+
+
+namespace banjo
+{
+
+// -------------------------------------------------------------------------- //
+// Mapped files
+
+namespace
+{
+
+// An empty region used for files of length 0, which cannot be mapped.
+char const empty_region[] = "";
+
+
+// Throw an error describing the failure of a system call on the file.
+[[noreturn]] void
+mapping_error(String const& path, char const* what)
+{
+  throw Translation_error("cannot {} '{}': {}", what, path, std::strerror(errno));
+}
+
+} // namespace
+
+
+// Map the file at `path` into memory. The access pattern is a hint to
+// the system about which pages to read ahead.
+Mapped_region::Mapped_region(String const& path, Access_pattern access)
+  : path_(path), base_(empty_region), size_(0)
+{
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0)
+    mapping_error(path, "open");
+
+  struct stat st;
+  if (::fstat(fd, &st) < 0) {
+    ::close(fd);
+    mapping_error(path, "stat");
+  }
+
+  size_ = st.st_size;
+  if (size_ != 0) {
+    void* p = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == MAP_FAILED) {
+      ::close(fd);
+      mapping_error(path, "map");
+    }
+    base_ = static_cast<char const*>(p);
+
+    if (access == sequential_access)
+      ::madvise(p, size_, MADV_SEQUENTIAL);
+    else
+      ::madvise(p, size_, MADV_RANDOM);
+  }
+
+  // The mapping remains valid after the descriptor is closed.
+  ::close(fd);
+}
+
+
+Mapped_region::~Mapped_region()
+{
+  if (size_ != 0)
+    ::munmap(const_cast<char*>(base_), size_);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Input files
+
+// Returns a new buffer for the file at `path`. The caller is
+// responsible for deleting the buffer.
+Buffer*
+open_input(String const& path)
+{
+  return new File(path);
+}
+
+
+std::int64_t
+modification_time(String const& path)
+{
+  struct stat st;
+  if (::stat(path.c_str(), &st) != 0)
+    return -1;
+  return std::int64_t(st.st_mtim.tv_sec) * 1000000000 + st.st_mtim.tv_nsec;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Resource usage
+
+// Note that Linux reports the maximum resident set size in kilobytes,
+// but Mac OS X reports it in bytes.
+std::size_t
+peak_resident_set_size()
+{
+  struct rusage usage;
+  if (::getrusage(RUSAGE_SELF, &usage) < 0)
+    return 0;
+#if defined(__APPLE__)
+  return usage.ru_maxrss / 1024;
+#else
+  return usage.ru_maxrss;
+#endif
+}
+
+
+} // namespace banjo
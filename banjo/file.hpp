@@ -0,0 +1,68 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_FILE_HPP
+#define BANJO_FILE_HPP
+
+// This module provides access to source files and to memory mapped
+// files.
+
+#include "prelude.hpp"
+
+#include <lingo/buffer.hpp>
+#include <lingo/file.hpp>
+
+#include <cstdint>
+
+
+namespace banjo
+{
+
+// The expected pattern of access to a mapped file.
+enum Access_pattern
+{
+  sequential_access, // Read once from front to back
+  random_access,     // Read in no particular order
+};
+
+
+// A read-only memory mapping of a file. This owns the mapped region.
+struct Mapped_region
+{
+  Mapped_region(String const&, Access_pattern = sequential_access);
+  ~Mapped_region();
+
+  // Non-copyable
+  Mapped_region(Mapped_region const&) = delete;
+  Mapped_region& operator=(Mapped_region const&) = delete;
+
+  // Returns the path to the mapped file.
+  String const& path() const { return path_; }
+
+  // Returns the mapped text and its size in bytes.
+  char const* data() const { return base_; }
+  std::size_t size() const { return size_; }
+
+  String      path_;
+  char const* base_;
+  std::size_t size_;
+};
+
+
+// Returns a new buffer containing the text of the file at `path`.
+Buffer* open_input(String const&);
+
+
+// Returns the time at which a file was last modified, in nanoseconds,
+// or -1 if it does not exist.
+std::int64_t modification_time(String const&);
+
+
+// Returns the peak resident set size of the process in kilobytes.
+std::size_t peak_resident_set_size();
+
+
+} // namespace banjo
+
+
+#endif
@@ -3,6 +3,9 @@
 
 #include "generator.hpp"
 
+#include <banjo/evaluation.hpp>
+#include <banjo/gen/globals.hpp>
+
 #include <iostream>
 
 
@@ -12,11 +15,704 @@ namespace banjo
 namespace cxx
 {
 
+namespace
+{
+
+// The prelude of every generated translation unit. Slices are views
+// of a sequence of objects, made from arrays and dynamic arrays by
+// make_slice. The three-way comparison evaluates each operand once.
+char const* prelude_text =
+  "#include <array>\n"
+  "#include <cstddef>\n"
+  "#include <cstdint>\n"
+  "#include <vector>\n"
+  "\n"
+  "namespace banjo_rt\n"
+  "{\n"
+  "\n"
+  "template<typename T>\n"
+  "struct slice\n"
+  "{\n"
+  "  T& operator[](std::int64_t n) const { return data[n]; }\n"
+  "\n"
+  "  T*           data;\n"
+  "  std::int64_t size;\n"
+  "};\n"
+  "\n"
+  "template<typename T, std::size_t N>\n"
+  "inline slice<T>\n"
+  "make_slice(std::array<T, N>& a)\n"
+  "{\n"
+  "  return {a.data(), std::int64_t(N)};\n"
+  "}\n"
+  "\n"
+  "template<typename T>\n"
+  "inline slice<T>\n"
+  "make_slice(std::vector<T>& v)\n"
+  "{\n"
+  "  return {v.data(), std::int64_t(v.size())};\n"
+  "}\n"
+  "\n"
+  "template<typename T>\n"
+  "inline int\n"
+  "cmp(T const& a, T const& b)\n"
+  "{\n"
+  "  return (b < a) - (a < b);\n"
+  "}\n"
+  "\n"
+  "} // namespace banjo_rt\n";
+
+
+// C++ keywords and names used by generated code. A Banjo identifier
+// that is spelled the same has an underscore appended.
+bool
+is_reserved(String const& s)
+{
+  static std::unordered_set<String> words {
+    "alignas", "alignof", "and", "and_eq", "asm", "auto", "bitand",
+    "bitor", "bool", "case", "catch", "char", "char16_t", "char32_t",
+    "class", "compl", "const", "const_cast", "constexpr", "decltype",
+    "default", "delete", "do", "double", "dynamic_cast", "enum",
+    "explicit", "export", "extern", "float", "for", "friend", "goto",
+    "inline", "int", "long", "mutable", "namespace", "new", "noexcept",
+    "not", "not_eq", "nullptr", "operator", "or", "or_eq", "private",
+    "protected", "public", "register", "reinterpret_cast", "short",
+    "signed", "sizeof", "static", "static_assert", "static_cast",
+    "struct", "switch", "template", "this", "thread_local", "throw",
+    "try", "typedef", "typeid", "typename", "union", "unsigned",
+    "using", "virtual", "void", "volatile", "wchar_t", "xor", "xor_eq",
+    "std", "banjo_rt",
+  };
+  return words.count(s);
+}
+
+
+// Returns the extent of an array type.
+Integer_value
+get_extent(Expr const& e)
+{
+  return evaluate(e).get_integer();
+}
+
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Translation units
+//
+// A translation unit is generated in three parts: a declaration of
+// every function, then the definitions of global variables, and then
+// the definitions of functions. Because every function is declared
+// before any definition, functions may be defined in any order.
+//
+// Global variables are initialized in the order in which they are
+// defined, so a global is defined after the globals that are read by
+// its initializer (see gen/globals.hpp).
+//
+// Declarations that are not owned by the generator (e.g., those
+// imported from a module) are declared, but not defined.
+
+void
+Generator::translation_unit(Stmt const& s)
+{
+  Decl_seq functions;
+  Decl_seq globals;
+  for (Stmt const& s1 : cast<Translation_stmt>(s).statements()) {
+    if (is<Empty_stmt>(&s1))
+      continue;
+    Declaration_stmt const* ds = as<Declaration_stmt>(&s1);
+    if (!ds)
+      banjo_unhandled_case(s1);
+    Decl const& d = ds->declaration();
+    if (is<Variable_decl>(&d))
+      globals.push_back(&d);
+    else
+      functions.push_back(&d);
+  }
+
+  prelude();
+  for (Decl const* d : functions)
+    declaration(*d);
+  newline();
+  for (Decl const* d : order_globals(globals))
+    definition(*d);
+  for (Decl const* d : functions)
+    definition(*d);
+  flush();
+}
+
+
+void
+Generator::prelude()
+{
+  put(prelude_text);
+  newline();
+  newline();
+}
+
+
+// -------------------------------------------------------------------------- //
+// Declarations
+
+// Generate the declaration of a function.
+void
+Generator::declaration(Decl const& d)
+{
+  struct fn
+  {
+    Generator& g;
+    void operator()(Decl const& d)          { banjo_unhandled_case(d); }
+    void operator()(Function_decl const& d) { g.function_declaration(d); }
+
+    void operator()(Coroutine_decl const& d)
+    {
+      throw Translation_error("coroutines are not supported by the C++ generator");
+    }
+  };
+  apply(d, fn{*this});
+}
+
+
+void
+Generator::definition(Decl const& d)
+{
+  struct fn
+  {
+    Generator& g;
+    void operator()(Decl const& d)          { banjo_unhandled_case(d); }
+    void operator()(Variable_decl const& d) { g.global_variable(d); }
+    void operator()(Function_decl const& d) { g.function_definition(d); }
+  };
+  if (defines(d))
+    apply(d, fn{*this});
+  else if (Variable_decl const* var = as<Variable_decl>(&d))
+    extern_variable(*var);
+}
+
+
+// Returns true if the definition of `d` is generated.
+bool
+Generator::defines(Decl const& d) const
+{
+  return !owned || owned->count(&d);
+}
+
+
+void
+Generator::global_variable(Variable_decl const& d)
+{
+  variable(d);
+  newline();
+}
+
+
+// Declare a global variable that is defined in another translation
+// unit.
+void
+Generator::extern_variable(Variable_decl const& d)
+{
+  put("extern ");
+  put(type(d.type()));
+  put(' ');
+  put(name(d));
+  put(';');
+  newline();
+}
+
+
+// Generate the definition of a variable. A variable without an
+// initializer is value-initialized, so that the value of a local
+// does not depend on the contents of the stack. A dynamic array is
+// allocated with its extent, and cannot be initialized otherwise.
+void
+Generator::variable(Variable_decl const& d)
+{
+  Type const& t = d.type();
+  Expression_def const* def = as<Expression_def>(&d.initializer());
+  Dynarray_type const* a = as<Dynarray_type>(&t.unqualified_type());
+  if (a && def && !is<Trivial_init>(&def->expression()))
+    throw Translation_error("dynamic arrays cannot have initializers");
+  put(type(t));
+  put(' ');
+  put(name(d));
+  if (a) {
+    put('(');
+    expression(a->extent());
+    put(')');
+  } else if (def) {
+    if (is<Trivial_init>(&def->expression())) {
+      put("{}");
+    } else {
+      put(" = ");
+      expression(def->expression());
+    }
+  } else if (is<Empty_def>(&d.initializer())) {
+    put("{}");
+  } else {
+    banjo_unhandled_case(d.initializer());
+  }
+  put(';');
+}
+
+
+void
+Generator::function_declaration(Function_decl const& d)
+{
+  put(type(d.return_type()));
+  put(' ');
+  put(name(d));
+  parameters(d);
+  put(';');
+  newline();
+}
+
+
+void
+Generator::function_definition(Function_decl const& d)
+{
+  Function_def const* def = as<Function_def>(&d.definition());
+  if (!def)
+    banjo_unhandled_case(d.definition());
+  newline();
+  put(type(d.return_type()));
+  newline();
+  put(name(d));
+  parameters(d);
+  newline();
+  statement(def->statement());
+  newline();
+}
+
+
+// Generate the parameters of a function. A dynamic array is passed by
+// reference, since the LLVM generator passes a pointer to its elements
+// and the callee's changes are seen by the caller.
+void
+Generator::parameters(Function_decl const& d)
+{
+  put('(');
+  bool first = true;
+  for (Decl const& p : d.parameters()) {
+    if (!first)
+      put(", ");
+    put(type(p.type()));
+    if (is<Dynarray_type>(&p.type().unqualified_type()))
+      put('&');
+    put(' ');
+    put(name(p));
+    first = false;
+  }
+  put(')');
+}
+
+
+// -------------------------------------------------------------------------- //
+// Names and types
+
+String
+Generator::name(Decl const& d)
+{
+  Name const& n = d.name();
+  if (Simple_id const* id = as<Simple_id>(&n)) {
+    String s = id->symbol().spelling();
+    if (is_reserved(s))
+      s += '_';
+    return s;
+  }
+  banjo_unhandled_case(n);
+}
+
+
+// Returns the C++ type corresponding to `t`. Integers have the same
+// precision and signedness as in Banjo.
+String
+Generator::type(Type const& t)
+{
+  struct fn
+  {
+    Generator& g;
+    String operator()(Type const& t)         { banjo_unhandled_case(t); }
+    String operator()(Void_type const& t)    { return "void"; }
+    String operator()(Boolean_type const& t) { return "bool"; }
+    String operator()(Byte_type const& t)    { return "std::uint8_t"; }
+    String operator()(Float_type const& t)   { return t.precision() == 32 ? "float" : "double"; }
+
+    String operator()(Integer_type const& t)
+    {
+      String s = t.is_signed() ? "std::int" : "std::uint";
+      return s + std::to_string(t.precision()) + "_t";
+    }
+
+    String operator()(Qualified_type const& t)
+    {
+      String s = g.type(t.unqualified_type());
+      if (t.is_const())
+        s += " const";
+      if (t.is_volatile())
+        s += " volatile";
+      return s;
+    }
+
+    String operator()(Reference_type const& t)
+    {
+      return g.type(t.non_reference_type()) + "&";
+    }
+
+    String operator()(Array_type const& t)
+    {
+      String n = std::to_string(get_extent(t.extent()));
+      return "std::array<" + g.type(t.type()) + ", " + n + ">";
+    }
+
+    String operator()(Dynarray_type const& t)
+    {
+      return "std::vector<" + g.type(t.type()) + ">";
+    }
+
+    String operator()(Slice_type const& t)
+    {
+      return "banjo_rt::slice<" + g.type(t.type()) + ">";
+    }
+
+    String operator()(Auto_type const& t)
+    {
+      throw Translation_error("cannot generate code for a non-deduced type");
+    }
+  };
+  return apply(t, fn{*this});
+}
+
+
+// -------------------------------------------------------------------------- //
+// Statements
+//
+// Each statement begins at the current position. The enclosing
+// statement starts a new line before each nested statement.
+
+void
+Generator::statement(Stmt const& s)
+{
+  struct fn
+  {
+    Generator& g;
+    void operator()(Stmt const& s)             { banjo_unhandled_case(s); }
+    void operator()(Empty_stmt const& s)       { g.put(';'); }
+    void operator()(Compound_stmt const& s)    { g.statement(s); }
+    void operator()(Expression_stmt const& s)  { g.statement(s); }
+    void operator()(Declaration_stmt const& s) { g.statement(s); }
+    void operator()(Return_stmt const& s)      { g.statement(s); }
+    void operator()(If_then_stmt const& s)     { g.statement(s); }
+    void operator()(If_else_stmt const& s)     { g.statement(s); }
+    void operator()(While_stmt const& s)       { g.statement(s); }
+    void operator()(Break_stmt const& s)       { g.put("break;"); }
+    void operator()(Continue_stmt const& s)    { g.put("continue;"); }
+
+    void operator()(Yield_stmt const& s)
+    {
+      throw Translation_error("yield statement outside of a coroutine");
+    }
+  };
+  apply(s, fn{*this});
+}
+
+
+void
+Generator::statement(Compound_stmt const& s)
+{
+  put('{');
+  {
+    Indent in(*this);
+    for (Stmt const& s1 : s.statements()) {
+      newline();
+      statement(s1);
+    }
+  }
+  newline();
+  put('}');
+}
+
+
+void
+Generator::statement(Expression_stmt const& s)
+{
+  expression(s.expression());
+  put(';');
+}
+
+
+void
+Generator::statement(Declaration_stmt const& s)
+{
+  Decl const& d = s.declaration();
+  if (Variable_decl const* var = as<Variable_decl>(&d))
+    return variable(*var);
+  banjo_unhandled_case(d);
+}
+
+
+void
+Generator::statement(Return_stmt const& s)
+{
+  put("return ");
+  expression(s.expression());
+  put(';');
+}
+
+
+void
+Generator::statement(If_then_stmt const& s)
+{
+  put("if (");
+  expression(s.condition());
+  put(") ");
+  block(s.true_branch());
+}
+
+
+void
+Generator::statement(If_else_stmt const& s)
+{
+  put("if (");
+  expression(s.condition());
+  put(") ");
+  block(s.true_branch());
+  put(" else ");
+  block(s.false_branch());
+}
+
+
+void
+Generator::statement(While_stmt const& s)
+{
+  put("while (");
+  expression(s.condition());
+  put(") ");
+  block(s.body());
+}
+
+
+// Generate the branch or body of a statement as a compound statement.
+void
+Generator::block(Stmt const& s)
+{
+  if (Compound_stmt const* c = as<Compound_stmt>(&s))
+    return statement(*c);
+  put('{');
+  {
+    Indent in(*this);
+    newline();
+    statement(s);
+  }
+  newline();
+  put('}');
+}
+
+
+// -------------------------------------------------------------------------- //
+// Expressions
+//
+// Every operator is parenthesized, so the C++ precedence of operators
+// never changes the meaning of an expression.
+
+void
+Generator::expression(Expr const& e)
+{
+  struct fn
+  {
+    Generator& g;
+    void operator()(Expr const& e)               { banjo_unhandled_case(e); }
+    void operator()(Boolean_expr const& e)       { g.literal(e); }
+    void operator()(Integer_expr const& e)       { g.literal(e); }
+    void operator()(Object_expr const& e)        { g.put(g.name(e.declaration())); }
+    void operator()(Function_expr const& e)      { g.put(g.name(e.declaration())); }
+    void operator()(Add_expr const& e)           { g.binary("+", e); }
+    void operator()(Sub_expr const& e)           { g.binary("-", e); }
+    void operator()(Mul_expr const& e)           { g.binary("*", e); }
+    void operator()(Div_expr const& e)           { g.binary("/", e); }
+    void operator()(Rem_expr const& e)           { g.binary("%", e); }
+    void operator()(Neg_expr const& e)           { g.unary("-", e); }
+    void operator()(Pos_expr const& e)           { g.unary("+", e); }
+    void operator()(Bit_and_expr const& e)       { g.binary("&", e); }
+    void operator()(Bit_or_expr const& e)        { g.binary("|", e); }
+    void operator()(Bit_xor_expr const& e)       { g.binary("^", e); }
+    void operator()(Bit_lsh_expr const& e)       { g.binary("<<", e); }
+    void operator()(Bit_rsh_expr const& e)       { g.binary(">>", e); }
+    void operator()(Bit_not_expr const& e)       { g.unary("~", e); }
+    void operator()(Eq_expr const& e)            { g.binary("==", e); }
+    void operator()(Ne_expr const& e)            { g.binary("!=", e); }
+    void operator()(Lt_expr const& e)            { g.binary("<", e); }
+    void operator()(Gt_expr const& e)            { g.binary(">", e); }
+    void operator()(Le_expr const& e)            { g.binary("<=", e); }
+    void operator()(Ge_expr const& e)            { g.binary(">=", e); }
+    void operator()(Cmp_expr const& e)           { g.compare(e); }
+    void operator()(And_expr const& e)           { g.binary("&&", e); }
+    void operator()(Or_expr const& e)            { g.binary("||", e); }
+    void operator()(Not_expr const& e)           { g.unary("!", e); }
+    void operator()(Assign_expr const& e)        { g.binary("=", e); }
+    void operator()(Call_expr const& e)          { g.call(e); }
+    void operator()(Index_expr const& e)         { g.index(e); }
+    void operator()(Value_conv const& e)         { g.expression(e.source()); }
+    void operator()(Qualification_conv const& e) { g.expression(e.source()); }
+    void operator()(Boolean_conv const& e)       { g.convert(e); }
+    void operator()(Integer_conv const& e)       { g.convert(e); }
+    void operator()(Float_conv const& e)         { g.convert(e); }
+    void operator()(Numeric_conv const& e)       { g.convert(e); }
+    void operator()(Slice_conv const& e)         { g.slice(e); }
+    void operator()(Copy_init const& e)          { g.expression(e.expression()); }
+    void operator()(Bind_init const& e)          { g.expression(e.expression()); }
+  };
+  apply(e, fn{*this});
+}
+
+
+void
+Generator::literal(Boolean_expr const& e)
+{
+  put(e.value() ? "true" : "false");
+}
+
+
+// Literals of type int are written as is. Others are converted to
+// their type.
+void
+Generator::literal(Integer_expr const& e)
+{
+  Integer_type const& t = cast<Integer_type>(e.type());
+  String n = e.value().impl().toString(10, t.is_signed());
+  if (t.is_signed() && t.precision() == 32)
+    return put(n);
+  put(type(t));
+  put('(');
+  put(n);
+  put(t.is_signed() ? "ll" : "ull");
+  put(')');
+}
+
+
+void
+Generator::unary(char const* op, Unary_expr const& e)
+{
+  put('(');
+  put(op);
+  expression(e.operand());
+  put(')');
+}
+
+
+void
+Generator::binary(char const* op, Binary_expr const& e)
+{
+  put('(');
+  expression(e.left());
+  put(' ');
+  put(op);
+  put(' ');
+  expression(e.right());
+  put(')');
+}
+
+
+void
+Generator::call(Call_expr const& e)
+{
+  expression(e.function());
+  put('(');
+  bool first = true;
+  for (Expr const& a : e.arguments()) {
+    if (!first)
+      put(", ");
+    expression(a);
+    first = false;
+  }
+  put(')');
+}
+
+
+void
+Generator::index(Index_expr const& e)
+{
+  expression(e.object());
+  put('[');
+  expression(e.index());
+  put(']');
+}
+
+
+void
+Generator::slice(Slice_conv const& e)
+{
+  put("banjo_rt::make_slice(");
+  expression(e.source());
+  put(')');
+}
+
+
+// The three-way comparison yields -1, 0, or 1.
+void
+Generator::compare(Cmp_expr const& e)
+{
+  put("banjo_rt::cmp(");
+  expression(e.left());
+  put(", ");
+  expression(e.right());
+  put(')');
+}
+
+
+void
+Generator::convert(Conv const& e)
+{
+  put("static_cast<");
+  put(type(e.destination()));
+  put(">(");
+  expression(e.source());
+  put(')');
+}
+
+
+// -------------------------------------------------------------------------- //
+// Output
+
+void
+Generator::put(char c)
+{
+  buf += c;
+}
+
+
+void
+Generator::put(char const* s)
+{
+  buf += s;
+}
+
+
+void
+Generator::put(String const& s)
+{
+  buf += s;
+}
+
+
+// Start a new line at the current indentation. Pending output is
+// written once the buffer is full, so a line is never split between
+// writes.
+void
+Generator::newline()
+{
+  buf += '\n';
+  if (buf.size() >= flush_size)
+    flush();
+  buf.append(2 * indent, ' ');
+}
+
 
-// TODO: Implement me.
 void
-Generator::translation_unit()
+Generator::flush()
 {
+  os.write(buf.data(), buf.size());
+  buf.clear();
 }
 
 
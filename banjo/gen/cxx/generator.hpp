@@ -8,8 +8,12 @@
 // single translation unit (.cpp file) from the AST of a Banjo program.
 
 #include <banjo/language.hpp>
+#include <banjo/ast.hpp>
 
 #include <iosfwd>
+#include <string>
+#include <unordered_set>
+#include <vector>
 
 
 namespace banjo
@@ -18,18 +22,102 @@ namespace banjo
 namespace cxx
 {
 
+// A set of declarations.
+using Decl_set = std::unordered_set<Decl const*>;
+
+
+// A sequence of declarations.
+using Decl_seq = std::vector<Decl const*>;
+
+
 // The generator class encapsulates the resources needed to generate the
-// C++ code corresponding to a Banjo program. 
+// C++ code corresponding to a Banjo program.
+//
+// Output is accumulated in a buffer, which is written to the output
+// stream whenever it grows past flush_size, and when the translation
+// unit is complete. Large programs are never held in memory at once.
 struct Generator
 {
+  static constexpr std::size_t flush_size = 64 * 1024;
+
   Generator(Context& cxt, std::ostream& os)
-    : cxt(cxt), os(os)
+    : cxt(cxt), os(os), indent(0), owned(nullptr)
   { }
 
-  void translation_unit();
+  void translation_unit(Stmt const&);
+
+  // Declarations
+  void prelude();
+  void declaration(Decl const&);
+  void definition(Decl const&);
+  void global_variable(Variable_decl const&);
+  void extern_variable(Variable_decl const&);
+  void variable(Variable_decl const&);
+  void function_declaration(Function_decl const&);
+  void function_definition(Function_decl const&);
+  void parameters(Function_decl const&);
+  bool defines(Decl const&) const;
+
+  // Names and types
+  String name(Decl const&);
+  String type(Type const&);
+
+  // Statements
+  void statement(Stmt const&);
+  void statement(Compound_stmt const&);
+  void statement(Expression_stmt const&);
+  void statement(Declaration_stmt const&);
+  void statement(Return_stmt const&);
+  void statement(If_then_stmt const&);
+  void statement(If_else_stmt const&);
+  void statement(While_stmt const&);
+  void block(Stmt const&);
+
+  // Expressions
+  void expression(Expr const&);
+  void literal(Boolean_expr const&);
+  void literal(Integer_expr const&);
+  void unary(char const*, Unary_expr const&);
+  void binary(char const*, Binary_expr const&);
+  void call(Call_expr const&);
+  void index(Index_expr const&);
+  void compare(Cmp_expr const&);
+  void convert(Conv const&);
+  void slice(Slice_conv const&);
+
+  // Output
+  void put(char);
+  void put(char const*);
+  void put(String const&);
+  void newline();
+  void flush();
+
+  Context&        cxt;
+  std::ostream&   os;
+  std::string     buf;    // Pending output
+  int             indent; // Current indentation level
+  Decl_set const* owned;  // Definitions to generate, or null for all
+
+  struct Indent;
+};
+
+
+// An RAII class that increases the indentation of nested
+// statements.
+struct Generator::Indent
+{
+  Indent(Generator& g)
+    : gen(g)
+  {
+    ++gen.indent;
+  }
+
+  ~Indent()
+  {
+    --gen.indent;
+  }
 
-  Context&      cxt;
-  std::ostream& os;
+  Generator& gen;
 };
 
 
@@ -0,0 +1,107 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "globals.hpp"
+
+#include <unordered_set>
+
+
+namespace banjo
+{
+
+namespace
+{
+
+using Decl_set = std::unordered_set<Decl const*>;
+using Decl_seq = std::vector<Decl const*>;
+
+
+// Adds the global variables referred to by `e` to `refs`.
+void
+global_references(Expr const& e, Decl_set const& globals, Decl_set& refs)
+{
+  struct fn
+  {
+    Decl_set const& globals;
+    Decl_set&       refs;
+    void operator()(Expr const& e)      { }
+    void operator()(Unary_expr const& e) { global_references(e.operand(), globals, refs); }
+    void operator()(Conv const& e)      { global_references(e.source(), globals, refs); }
+    void operator()(Copy_init const& e) { global_references(e.expression(), globals, refs); }
+    void operator()(Bind_init const& e) { global_references(e.expression(), globals, refs); }
+
+    void operator()(Object_expr const& e)
+    {
+      if (globals.count(&e.declaration()))
+        refs.insert(&e.declaration());
+    }
+
+    void operator()(Binary_expr const& e)
+    {
+      global_references(e.left(), globals, refs);
+      global_references(e.right(), globals, refs);
+    }
+
+    void operator()(Call_expr const& e)
+    {
+      global_references(e.function(), globals, refs);
+      for (Expr const& a : e.arguments())
+        global_references(a, globals, refs);
+    }
+  };
+  apply(e, fn{globals, refs});
+}
+
+} // namespace
+
+
+// Returns the global variables `vars` in the order in which they must
+// be initialized. This is a depth-first traversal of the references made
+// by their initializers. When initializers refer to each other in a
+// cycle, the cycle is broken at the variable defined first in the
+// program.
+//
+// TODO: Follow references made by the functions called from an
+// initializer.
+Decl_seq
+order_globals(Decl_seq const& vars)
+{
+  Decl_set globals(vars.begin(), vars.end());
+  Decl_set visited;
+  Decl_seq result;
+
+  struct fn
+  {
+    Decl_set const& globals;
+    Decl_set&       visited;
+    Decl_seq&       result;
+
+    void operator()(Decl const* d)
+    {
+      if (!visited.insert(d).second)
+        return;
+      Variable_decl const& var = cast<Variable_decl>(*d);
+      if (Expression_def const* def = as<Expression_def>(&var.initializer())) {
+        Decl_set refs;
+        global_references(def->expression(), globals, refs);
+
+        // Visit references in program order, so that the output
+        // does not depend on the hashing of declarations.
+        for (Decl const* d1 : vars_in_order)
+          if (refs.count(d1))
+            (*this)(d1);
+      }
+      result.push_back(d);
+    }
+
+    Decl_seq const& vars_in_order;
+  };
+
+  fn visit{globals, visited, result, vars};
+  for (Decl const* d : vars)
+    visit(d);
+  return result;
+}
+
+
+} // namespace banjo
@@ -0,0 +1,26 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_GEN_GLOBALS_HPP
+#define BANJO_GEN_GLOBALS_HPP
+
+// Global variables are initialized in the order in which they are
+// defined, except that a global is initialized after the globals that
+// are read by its initializer. Every code generator uses this order,
+// so that programs behave the same whichever generates them.
+
+#include <banjo/ast.hpp>
+
+#include <vector>
+
+
+namespace banjo
+{
+
+std::vector<Decl const*> order_globals(std::vector<Decl const*> const&);
+
+
+} // namespace banjo
+
+
+#endif
@@ -0,0 +1,511 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "bounds.hpp"
+
+#include <cstdint>
+#include <vector>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+// A subscript is known to be in range when its object is an array whose
+// extent is a literal and either:
+//
+//    - the index is a literal less than the extent, or
+//
+//    - the index is an induction variable `i` of an enclosing loop
+//      whose condition is `i < n` (or `n > i`), where `n` is a literal
+//      no greater than the extent, and `i` has not been assigned since
+//      the condition was tested.
+//
+// An induction variable must be a local variable of integer type whose
+// value can never be negative: it is initialized with a literal, and
+// every assignment to it either stores a literal or adds a literal to
+// it. No reference may be bound to it. Signed arithmetic wraps, so an
+// addition must also be bounded: it must occur under the bound of an
+// enclosing loop whose limit plus the literal does not exceed the
+// largest value of the variable's type.
+//
+// The lengths of dynamic arrays and slices are not known statically,
+// so subscripts of those are always checked.
+//
+// The analysis is conservative: if the function contains a statement
+// or expression that it does not understand, no subscripts are safe.
+
+namespace
+{
+
+struct Unknown { };
+
+
+// Returns `e` without any enclosing conversions.
+Expr const&
+strip(Expr const& e)
+{
+  if (Conv const* c = as<Conv>(&e))
+    return strip(c->source());
+  if (Copy_init const* c = as<Copy_init>(&e))
+    return strip(c->expression());
+  return e;
+}
+
+
+// Returns the variable referred to by `e`, or null if `e` does not
+// refer to a variable.
+Decl const*
+get_variable(Expr const& e)
+{
+  if (Object_expr const* obj = as<Object_expr>(&strip(e)))
+    return &obj->declaration();
+  return nullptr;
+}
+
+
+// If `e` is an integer literal, stores its value in `n` and returns
+// true.
+bool
+get_literal(Expr const& e, std::uint64_t& n)
+{
+  if (Integer_expr const* lit = as<Integer_expr>(&strip(e))) {
+    n = lit->value().getu();
+    return true;
+  }
+  return false;
+}
+
+
+// Returns true if `e` adds a literal to the variable `d`, and stores
+// the literal in `n`.
+bool
+is_increment(Expr const& e, Decl const& d, std::uint64_t& n)
+{
+  if (Add_expr const* add = as<Add_expr>(&strip(e))) {
+    if (get_variable(add->left()) == &d && get_literal(add->right(), n))
+      return true;
+    if (get_variable(add->right()) == &d && get_literal(add->left(), n))
+      return true;
+  }
+  return false;
+}
+
+
+// Returns the largest value of the type of the variable `d`, or 0 if
+// it does not have integer type.
+std::uint64_t
+max_value(Decl const& d)
+{
+  Type const& t = declared_type(d).unqualified_type();
+  Integer_type const* z = as<Integer_type>(&t);
+  if (!z)
+    return 0;
+  int bits = z->precision() - z->is_signed();
+  if (bits >= 64)
+    return UINT64_MAX;
+  return (std::uint64_t(1) << bits) - 1;
+}
+
+
+// Call `f` on `e` and each of its subexpressions, in order.
+template<typename F>
+void
+walk(Expr const& e, F f)
+{
+  struct fn
+  {
+    F& f;
+    void operator()(Expr const& e)         { throw Unknown(); }
+    void operator()(Boolean_expr const& e) { }
+    void operator()(Integer_expr const& e) { }
+    void operator()(Decl_expr const& e)    { }
+    void operator()(Trivial_init const& e) { }
+    void operator()(Unary_expr const& e)   { walk(e.operand(), f); }
+    void operator()(Conv const& e)         { walk(e.source(), f); }
+    void operator()(Copy_init const& e)    { walk(e.expression(), f); }
+    void operator()(Bind_init const& e)    { walk(e.expression(), f); }
+
+    void operator()(Binary_expr const& e)
+    {
+      walk(e.left(), f);
+      walk(e.right(), f);
+    }
+
+    void operator()(Call_expr const& e)
+    {
+      walk(e.function(), f);
+      for (Expr const& a : e.arguments())
+        walk(a, f);
+    }
+  };
+  f(e);
+  apply(e, fn{f});
+}
+
+
+// Call `f` on each statement in `s`, and `g` on each expression in
+// those statements, in order.
+template<typename F, typename G>
+void
+walk(Stmt const& s, F f, G g)
+{
+  struct fn
+  {
+    F& f;
+    G& g;
+    void operator()(Stmt const& s)            { throw Unknown(); }
+    void operator()(Empty_stmt const& s)      { }
+    void operator()(Break_stmt const& s)      { }
+    void operator()(Continue_stmt const& s)   { }
+    void operator()(Return_stmt const& s)     { walk(s.expression(), g); }
+    void operator()(Expression_stmt const& s) { walk(s.expression(), g); }
+
+    void operator()(Compound_stmt const& s)
+    {
+      for (Stmt const& s1 : s.statements())
+        walk(s1, f, g);
+    }
+
+    void operator()(If_then_stmt const& s)
+    {
+      walk(s.condition(), g);
+      walk(s.true_branch(), f, g);
+    }
+
+    void operator()(If_else_stmt const& s)
+    {
+      walk(s.condition(), g);
+      walk(s.true_branch(), f, g);
+      walk(s.false_branch(), f, g);
+    }
+
+    void operator()(While_stmt const& s)
+    {
+      walk(s.condition(), g);
+      walk(s.body(), f, g);
+    }
+
+    void operator()(Declaration_stmt const& s)
+    {
+      Variable_decl const* var = as<Variable_decl>(&s.declaration());
+      if (!var)
+        throw Unknown();
+      if (Expression_def const* def = as<Expression_def>(&var->initializer()))
+        walk(def->expression(), g);
+      else if (!is<Empty_def>(&var->initializer()))
+        throw Unknown();
+    }
+  };
+  f(s);
+  apply(s, fn{f, g});
+}
+
+
+using Decl_set = std::unordered_set<Decl const*>;
+
+
+// Adds the variable assigned by `e`, if any, to `vars`.
+void
+assigned_variable(Expr const& e, Decl_set& vars)
+{
+  if (Assign_expr const* a = as<Assign_expr>(&e))
+    if (Decl const* d = get_variable(a->left()))
+      vars.insert(d);
+}
+
+
+// Returns the set of variables assigned within `e`.
+Decl_set
+assigned_variables(Expr const& e)
+{
+  Decl_set vars;
+  walk(e, [&vars](Expr const& e1) { assigned_variable(e1, vars); });
+  return vars;
+}
+
+
+// Returns the set of variables assigned within `s`.
+Decl_set
+assigned_variables(Stmt const& s)
+{
+  Decl_set vars;
+  walk(s, [](Stmt const&) { }, [&vars](Expr const& e1) { assigned_variable(e1, vars); });
+  return vars;
+}
+
+
+// The condition of an enclosing loop that bounds an induction
+// variable. The bound is dirty once the variable has been assigned
+// after the condition was tested.
+struct Bound
+{
+  Decl const*   var;
+  std::uint64_t limit;
+  bool          dirty;
+};
+
+
+struct Bounds_analysis
+{
+  void function(Function_decl const&);
+  void find_induction_variables(Stmt const&);
+  void statement(Stmt const&);
+  void expression(Expr const&);
+  void loop(While_stmt const&);
+  void index(Index_expr const&);
+  void increment(Expr const&);
+  void invalidate(Decl_set const&);
+
+  Decl_set                        inductions;
+  Decl_set                        unbounded;
+  std::vector<Bound>              bounds;
+  Expr_set                        safe;
+};
+
+
+void
+Bounds_analysis::function(Function_decl const& f)
+{
+  Function_def const* def = as<Function_def>(&f.definition());
+  if (!def)
+    return;
+  try {
+    find_induction_variables(def->statement());
+    statement(def->statement());
+
+    // An unbounded addition disqualifies its variable, which can only
+    // remove bounds. Repeat until every addition is bounded.
+    while (!unbounded.empty()) {
+      for (Decl const* d : unbounded)
+        inductions.erase(d);
+      unbounded.clear();
+      safe.clear();
+      statement(def->statement());
+    }
+  } catch (Unknown&) {
+    safe.clear();
+  }
+}
+
+
+// Find the local variables whose values are never negative.
+void
+Bounds_analysis::find_induction_variables(Stmt const& body)
+{
+  Decl_set bad;
+
+  auto stmt = [&](Stmt const& s) {
+    Declaration_stmt const* ds = as<Declaration_stmt>(&s);
+    if (!ds)
+      return;
+    Variable_decl const* var = as<Variable_decl>(&ds->declaration());
+    if (!var)
+      return;
+    Expression_def const* def = as<Expression_def>(&var->initializer());
+    std::uint64_t n;
+    if (def && get_literal(def->expression(), n) && n <= max_value(*var))
+      inductions.insert(var);
+  };
+
+  auto expr = [&](Expr const& e) {
+    if (Assign_expr const* a = as<Assign_expr>(&e)) {
+      if (Decl const* d = get_variable(a->left())) {
+        std::uint64_t n;
+        if (get_literal(a->right(), n)) {
+          if (n > max_value(*d))
+            bad.insert(d);
+        } else if (!is_increment(a->right(), *d, n)) {
+          bad.insert(d);
+        }
+      }
+    } else if (Bind_init const* b = as<Bind_init>(&e)) {
+      if (Decl const* d = get_variable(b->expression()))
+        bad.insert(d);
+    }
+  };
+
+  walk(body, stmt, expr);
+  for (Decl const* d : bad)
+    inductions.erase(d);
+}
+
+
+void
+Bounds_analysis::statement(Stmt const& s)
+{
+  struct fn
+  {
+    Bounds_analysis& self;
+    void operator()(Stmt const& s)            { throw Unknown(); }
+    void operator()(Empty_stmt const& s)      { }
+    void operator()(Break_stmt const& s)      { }
+    void operator()(Continue_stmt const& s)   { }
+    void operator()(Return_stmt const& s)     { self.expression(s.expression()); }
+    void operator()(Expression_stmt const& s) { self.expression(s.expression()); }
+    void operator()(While_stmt const& s)      { self.loop(s); }
+
+    void operator()(Compound_stmt const& s)
+    {
+      for (Stmt const& s1 : s.statements())
+        self.statement(s1);
+    }
+
+    // Assignments in either branch invalidate the bounds that follow
+    // the statement. Because bounds are never restored, those in the
+    // false branch are also invalidated by assignments in the true
+    // branch, which is conservative.
+    void operator()(If_then_stmt const& s)
+    {
+      self.expression(s.condition());
+      self.statement(s.true_branch());
+    }
+
+    void operator()(If_else_stmt const& s)
+    {
+      self.expression(s.condition());
+      self.statement(s.true_branch());
+      self.statement(s.false_branch());
+    }
+
+    void operator()(Declaration_stmt const& s)
+    {
+      Variable_decl const& var = cast<Variable_decl>(s.declaration());
+      if (Expression_def const* def = as<Expression_def>(&var.initializer()))
+        self.expression(def->expression());
+    }
+  };
+  apply(s, fn{*this});
+}
+
+
+// The order in which the subexpressions of an expression are evaluated
+// is not specified, so variables assigned anywhere in the expression
+// invalidate their bounds before any subscript is checked.
+void
+Bounds_analysis::expression(Expr const& e)
+{
+  walk(e, [this](Expr const& e1) { increment(e1); });
+  invalidate(assigned_variables(e));
+  walk(e, [this](Expr const& e1) {
+    if (Index_expr const* ix = as<Index_expr>(&e1))
+      index(*ix);
+  });
+}
+
+
+// A loop body is executed repeatedly, so variables assigned anywhere in
+// the loop invalidate enclosing bounds before the loop is entered. The
+// loop condition establishes a new bound for the body, which holds
+// until the variable is assigned in the body.
+void
+Bounds_analysis::loop(While_stmt const& s)
+{
+  invalidate(assigned_variables(s));
+  expression(s.condition());
+
+  Expr const& cond = strip(s.condition());
+  Decl const* var = nullptr;
+  std::uint64_t limit;
+  if (Lt_expr const* lt = as<Lt_expr>(&cond)) {
+    if (get_literal(lt->right(), limit))
+      var = get_variable(lt->left());
+  } else if (Gt_expr const* gt = as<Gt_expr>(&cond)) {
+    if (get_literal(gt->left(), limit))
+      var = get_variable(gt->right());
+  }
+
+  if (var && inductions.count(var)) {
+    bounds.push_back({var, limit, false});
+    statement(s.body());
+    bounds.pop_back();
+  } else {
+    statement(s.body());
+  }
+}
+
+
+void
+Bounds_analysis::index(Index_expr const& e)
+{
+  Type const& t = e.object().type().non_reference_type().unqualified_type();
+  Array_type const* a = as<Array_type>(&t);
+  std::uint64_t extent;
+  if (!a || !get_literal(a->extent(), extent))
+    return;
+
+  // A literal index.
+  std::uint64_t n;
+  if (get_literal(e.index(), n)) {
+    if (n < extent)
+      safe.insert(&e);
+    return;
+  }
+
+  // An induction variable bounded by an enclosing loop.
+  Decl const* var = get_variable(e.index());
+  if (!var)
+    return;
+  for (auto iter = bounds.rbegin(); iter != bounds.rend(); ++iter) {
+    if (iter->var == var && !iter->dirty && iter->limit <= extent) {
+      safe.insert(&e);
+      return;
+    }
+  }
+}
+
+
+// An addition to an induction variable cannot overflow when the
+// variable is bounded by an enclosing loop whose limit plus the
+// literal is no greater than the largest value of its type. The
+// addition invalidates the bound, so a second addition in the same
+// expression is not bounded by it.
+void
+Bounds_analysis::increment(Expr const& e)
+{
+  Assign_expr const* a = as<Assign_expr>(&e);
+  if (!a)
+    return;
+  Decl const* var = get_variable(a->left());
+  std::uint64_t n;
+  if (!var || !inductions.count(var) || !is_increment(a->right(), *var, n))
+    return;
+  std::uint64_t max = max_value(*var);
+  bool bounded = false;
+  for (Bound const& b : bounds) {
+    if (b.var == var && !b.dirty && b.limit <= max && n <= max - b.limit)
+      bounded = true;
+  }
+  if (!bounded)
+    unbounded.insert(var);
+  invalidate(Decl_set{var});
+}
+
+
+void
+Bounds_analysis::invalidate(Decl_set const& vars)
+{
+  for (Bound& b : bounds)
+    if (vars.count(b.var))
+      b.dirty = true;
+}
+
+
+} // namespace
+
+
+// Returns the subscripts in `f` whose indexes are known to be in range.
+Expr_set
+find_safe_indexes(Function_decl const& f)
+{
+  Bounds_analysis a;
+  a.function(f);
+  return std::move(a.safe);
+}
+
+
+} // namespace ll
+
+} // namespace banjo
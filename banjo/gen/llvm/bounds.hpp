@@ -0,0 +1,52 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_BOUNDS_HPP
+#define BANJO_BOUNDS_HPP
+
+// Static elimination of bounds checks.
+//
+// When bounds checking is enabled, every subscript of an array, dynamic
+// array, or slice is checked against the length of the indexed object,
+// except where the index is known to be in range. This module finds
+// those subscripts.
+
+#include <banjo/ast.hpp>
+
+#include <unordered_set>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+using Expr_set = std::unordered_set<Expr const*>;
+
+
+// Counts the bounds checks inserted into and eliminated from the
+// generated code.
+struct Bounds_check_stats
+{
+  Bounds_check_stats& operator+=(Bounds_check_stats const& x)
+  {
+    inserted += x.inserted;
+    eliminated += x.eliminated;
+    return *this;
+  }
+
+  std::size_t inserted = 0;
+  std::size_t eliminated = 0;
+};
+
+
+Expr_set find_safe_indexes(Function_decl const&);
+
+
+} // namespace ll
+
+} // namespace banjo
+
+
+#endif
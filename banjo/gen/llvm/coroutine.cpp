@@ -0,0 +1,105 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "coroutine.hpp"
+
+#include <algorithm>
+#include <iterator>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+namespace
+{
+
+// Returns true if `s` contains a yield statement.
+bool
+contains_yield(Stmt const& s)
+{
+  struct fn
+  {
+    bool operator()(Stmt const& s)          { return false; }
+    bool operator()(Yield_stmt const& s)    { return true; }
+    bool operator()(If_then_stmt const& s)  { return contains_yield(s.true_branch()); }
+    bool operator()(While_stmt const& s)    { return contains_yield(s.body()); }
+
+    bool operator()(Compound_stmt const& s)
+    {
+      Stmt_list const& ss = s.statements();
+      return std::any_of(ss.begin(), ss.end(), contains_yield);
+    }
+
+    bool operator()(If_else_stmt const& s)
+    {
+      return contains_yield(s.true_branch()) || contains_yield(s.false_branch());
+    }
+  };
+  return apply(s, fn{});
+}
+
+
+// Adds the local variables of `s` that live across a yield to the
+// frame, and counts its yield statements.
+//
+// The scope of a local variable extends from its declaration to the
+// end of its enclosing block, so it lives across a yield only when a
+// later statement of that block contains one. This includes a loop
+// containing a yield, whose next iteration may read the variable. A
+// variable declared after a yield in a loop body is initialized again
+// on every iteration, so it does not live across the yield.
+void
+hoist(Stmt const& s, Coroutine_frame& f)
+{
+  struct fn
+  {
+    Coroutine_frame& f;
+    void operator()(Stmt const& s)         { }
+    void operator()(Yield_stmt const& s)   { ++f.suspends; }
+    void operator()(If_then_stmt const& s) { hoist(s.true_branch(), f); }
+    void operator()(While_stmt const& s)   { hoist(s.body(), f); }
+
+    void operator()(If_else_stmt const& s)
+    {
+      hoist(s.true_branch(), f);
+      hoist(s.false_branch(), f);
+    }
+
+    void operator()(Compound_stmt const& s)
+    {
+      Stmt_list const& ss = s.statements();
+      for (auto iter = ss.begin(); iter != ss.end(); ++iter) {
+        if (Declaration_stmt const* d = as<Declaration_stmt>(&*iter))
+          if (std::any_of(std::next(iter), ss.end(), contains_yield))
+            f.vars.push_back(&d->declaration());
+        hoist(*iter, f);
+      }
+    }
+  };
+  apply(s, fn{f});
+}
+
+} // namespace
+
+
+// Returns the layout of the frame of the coroutine `d`. Every
+// parameter is stored in the frame, since the frame is initialized
+// from the arguments before the coroutine first runs.
+Coroutine_frame
+layout_frame(Coroutine_decl const& d)
+{
+  Coroutine_frame f;
+  for (Decl const& p : d.parameters())
+    f.vars.push_back(&p);
+  if (Function_def const* def = as<Function_def>(&d.definition()))
+    hoist(def->statement(), f);
+  return f;
+}
+
+
+} // namespace ll
+
+} // namespace banjo
@@ -0,0 +1,41 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_COROUTINE_HPP
+#define BANJO_COROUTINE_HPP
+
+// Layout of coroutine frames.
+//
+// A coroutine is lowered to a state machine whose state is stored in a
+// frame provided by the caller. This module determines which variables
+// of a coroutine must be stored in its frame.
+
+#include <banjo/ast.hpp>
+
+#include <vector>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+// The variables stored in the frame of a coroutine, and the number of
+// points at which it suspends. Parameters precede local variables.
+struct Coroutine_frame
+{
+  std::vector<Decl const*> vars;
+  int                      suspends = 0;
+};
+
+
+Coroutine_frame layout_frame(Coroutine_decl const&);
+
+
+} // namespace ll
+
+} // namespace banjo
+
+
+#endif
@@ -0,0 +1,154 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "emitter.hpp"
+
+#include <llvm/Bitcode/ReaderWriter.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/FileSystem.h>
+#include <llvm/Support/FormattedStream.h>
+#include <llvm/Support/Host.h>
+#include <llvm/Support/TargetRegistry.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Target/TargetOptions.h>
+#include <llvm/Target/TargetSubtargetInfo.h>
+
+#include <memory>
+#include <mutex>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+namespace
+{
+
+// Returns the code generation level for an optimization level.
+llvm::CodeGenOpt::Level
+codegen_level(int opt)
+{
+  switch (opt) {
+    case 0: return llvm::CodeGenOpt::None;
+    case 1: return llvm::CodeGenOpt::Less;
+    case 2: return llvm::CodeGenOpt::Default;
+    default: return llvm::CodeGenOpt::Aggressive;
+  }
+}
+
+
+// Create a target machine for the host.
+std::unique_ptr<llvm::TargetMachine>
+make_target_machine(std::string const& triple, int opt)
+{
+  initialize_targets();
+
+  std::string err;
+  llvm::Target const* target = llvm::TargetRegistry::lookupTarget(triple, err);
+  if (!target)
+    throw Translation_error("cannot generate code for '{}': {}", triple, err);
+
+  llvm::TargetOptions opts;
+  llvm::TargetMachine* tm = target->createTargetMachine(
+    triple,
+    llvm::sys::getHostCPUName(),
+    "",
+    opts,
+    llvm::Reloc::PIC_,
+    llvm::CodeModel::Default,
+    codegen_level(opt));
+  if (!tm)
+    throw Translation_error("cannot create a target machine for '{}'", triple);
+  return std::unique_ptr<llvm::TargetMachine>(tm);
+}
+
+
+// Generate assembly or object code for `mod`.
+void
+emit_native(llvm::Module& mod, Output_kind k, llvm::raw_fd_ostream& os, int opt)
+{
+  std::unique_ptr<llvm::TargetMachine> tm = make_target_machine(mod, opt);
+
+  auto type = k == obj_output
+    ? llvm::TargetMachine::CGFT_ObjectFile
+    : llvm::TargetMachine::CGFT_AssemblyFile;
+
+  llvm::legacy::PassManager pm;
+  pm.add(new llvm::DataLayoutPass());
+  llvm::formatted_raw_ostream fos(os);
+  if (tm->addPassesToEmitFile(pm, fos, type))
+    throw Translation_error("the target cannot emit this kind of file");
+  pm.run(mod);
+}
+
+
+} // namespace
+
+
+// Initialize code generation for the host. This is done before the
+// first target machine is created, or ahead of time by a compile
+// server. Target registration is not thread-safe, so it is done only
+// once, even when partitions are emitted concurrently.
+void
+initialize_targets()
+{
+  static std::once_flag once;
+  std::call_once(once, []() {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+  });
+}
+
+
+// Create a target machine for the host, and set the target triple and
+// data layout of `mod` to those of the machine. This is done before
+// the module is optimized, since the optimizer consults both.
+std::unique_ptr<llvm::TargetMachine>
+make_target_machine(llvm::Module& mod, int opt)
+{
+  std::string triple = llvm::sys::getDefaultTargetTriple();
+  std::unique_ptr<llvm::TargetMachine> tm = make_target_machine(triple, opt);
+  mod.setTargetTriple(triple);
+  mod.setDataLayout(tm->getSubtargetImpl()->getDataLayout());
+  return tm;
+}
+
+
+// Write `mod` to the file at `path` as output of kind `k`. A path
+// of "-" denotes the standard output. The optimization level
+// determines the level of code generation.
+void
+emit(llvm::Module& mod, Output_kind k, String const& path, int opt)
+{
+  std::error_code ec;
+  llvm::sys::fs::OpenFlags flags = llvm::sys::fs::F_None;
+  if (k == llvm_output || k == asm_output)
+    flags = llvm::sys::fs::F_Text;
+  llvm::raw_fd_ostream os(path, ec, flags);
+  if (ec)
+    throw Translation_error("cannot open '{}': {}", path, ec.message());
+
+  switch (k) {
+    case llvm_output:
+      os << mod;
+      break;
+    case bc_output:
+      llvm::WriteBitcodeToFile(&mod, os);
+      break;
+    case asm_output:
+    case obj_output:
+      emit_native(mod, k, os, opt);
+      break;
+  }
+}
+
+
+} // namespace ll
+
+} // namespace banjo
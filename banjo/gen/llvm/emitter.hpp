@@ -0,0 +1,50 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_EMITTER_HPP
+#define BANJO_EMITTER_HPP
+
+// Writes LLVM modules as textual IR, bitcode, assembly, or object
+// code. Assembly and object code are generated in process by a
+// target machine for the host.
+
+#include <banjo/prelude.hpp>
+
+#include <memory>
+
+namespace llvm
+{
+
+class Module;
+class TargetMachine;
+
+} // namespace llvm
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+// The kinds of output that can be written.
+enum Output_kind
+{
+  llvm_output, // Textual IR
+  bc_output,   // Bitcode
+  asm_output,  // Native assembly
+  obj_output,  // Native object code
+};
+
+
+void initialize_targets();
+std::unique_ptr<llvm::TargetMachine> make_target_machine(llvm::Module&, int);
+void emit(llvm::Module&, Output_kind, String const&, int);
+
+
+} // namespace ll
+
+} // namespace banjo
+
+
+#endif
@@ -2,20 +2,36 @@
 // All rights reserved
 
 #include "generator.hpp"
+#include "emitter.hpp"
 
 #include <banjo/ast.hpp>
 #include <banjo/printer.hpp>
 #include <banjo/evaluation.hpp>
+#include <banjo/gen/globals.hpp>
 
+#include <llvm/IR/CFG.h>
 #include <llvm/IR/Type.h>
+#include <llvm/IR/ValueHandle.h>
 #include <llvm/IR/GlobalVariable.h>
 #include <llvm/IR/Function.h>
 #include <llvm/IR/Constants.h>
+#include <llvm/IR/DataLayout.h>
 #include <llvm/IR/Instructions.h>
+#include <llvm/IR/Intrinsics.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/Pass.h>
+#include <llvm/Support/Timer.h>
 #include <llvm/Support/raw_ostream.h>
+#include <llvm/Target/TargetMachine.h>
+#include <llvm/Transforms/IPO.h>
+#include <llvm/Transforms/IPO/PassManagerBuilder.h>
+#include <llvm/Transforms/Utils/ModuleUtils.h>
 
 #include <iostream>
+#include <limits>
+#include <mutex>
 
 
 namespace banjo
@@ -24,6 +40,29 @@ namespace banjo
 namespace ll
 {
 
+namespace
+{
+
+// Dynamic arrays up to this size in bytes are allocated on the stack.
+constexpr std::uint64_t dynarray_stack_limit = 4096;
+
+
+// Guards the constant evaluator, which is not thread safe, when
+// partitions of a module are generated in parallel.
+std::mutex evaluation_mutex;
+
+
+// Returns the extent of an array type.
+Integer_value
+get_extent(Expr const& e)
+{
+  std::lock_guard<std::mutex> lock(evaluation_mutex);
+  return evaluate(e).get_integer();
+}
+
+} // namespace
+
+
 // -------------------------------------------------------------------------- //
 // Generation of names
 
@@ -43,10 +82,26 @@ Generator::get_name(Decl const& d)
 //
 // The type generator transforms a beaker type into its correspondiong
 // LLVM type.
+//
+// Lowered types are memoized. Each distinct type is lowered once, and
+// every later use of an equivalent type (in a signature, a local, or a
+// call) finds the previous result.
 
 
 llvm::Type*
 Generator::get_type(Type const& t)
+{
+  auto iter = lowered.find(&t);
+  if (iter != lowered.end())
+    return iter->second;
+  llvm::Type* r = lower_type(t);
+  lowered.emplace(&t, r);
+  return r;
+}
+
+
+llvm::Type*
+Generator::lower_type(Type const& t)
 {
   struct fn
   {
@@ -54,10 +109,13 @@ Generator::get_type(Type const& t)
     llvm::Type* operator()(Type const& t)          { lingo_unhandled(t); }
     llvm::Type* operator()(Void_type const& t)     { return g.get_type(t); }
     llvm::Type* operator()(Boolean_type const& t)  { return g.get_type(t); }
+    llvm::Type* operator()(Byte_type const& t)     { return g.get_type(t); }
     llvm::Type* operator()(Integer_type const& t)  { return g.get_type(t); }
     llvm::Type* operator()(Float_type const& t)    { return g.get_type(t); }
     llvm::Type* operator()(Function_type const& t) { return g.get_type(t); }
+    llvm::Type* operator()(Tuple_type const& t)    { return g.get_type(t); }
     llvm::Type* operator()(Array_type const& t)    { return g.get_type(t); }
+    llvm::Type* operator()(Slice_type const& t)    { return g.get_type(t); }
     llvm::Type* operator()(Dynarray_type const& t) { return g.get_type(t); }
     llvm::Type* operator()(Auto_type const& t)     { return g.get_type(t); }
   };
@@ -80,6 +138,14 @@ Generator::get_type(Boolean_type const&)
 }
 
 
+// Return the 8 bit integer type.
+llvm::Type*
+Generator::get_type(Byte_type const&)
+{
+  return build.getInt8Ty();
+}
+
+
 // FIXME: This isn't realistic.
 llvm::Type*
 Generator::get_type(Integer_type const& t)
@@ -109,23 +175,59 @@ Generator::get_type(Function_type const& t)
 }
 
 
+// Return a literal structure type whose members are the lowered
+// element types.
+llvm::Type*
+Generator::get_type(Tuple_type const& t)
+{
+  std::vector<llvm::Type*> elems;
+  elems.reserve(t.type_list().size());
+  for (Type const& et : t.type_list())
+    elems.push_back(get_type(et));
+  return llvm::StructType::get(cxt, elems);
+}
+
+
 //return an array type
 llvm::Type*
 Generator::get_type(Array_type const& t) 
 {
   llvm::Type* t1 = get_type(t.type());
-  Value v = evaluate(t.extent());
-  return llvm::ArrayType::get(t1, v.get_integer());
+  return llvm::ArrayType::get(t1, get_extent(t.extent()));
 }
 
 
-//return an array type
+// A slice is a view of a sequence of objects, represented by a pointer
+// to its first element and its length.
+//
+//    { T*, i64 }
+//
+// Slices are passed and returned by value. The pair fits in two
+// registers, so passing a slice never copies the elements.
 llvm::Type*
-Generator::get_type(Dynarray_type const& t) 
+Generator::get_type(Slice_type const& t)
 {
   llvm::Type* t1 = get_type(t.type());
-  Value v = evaluate(t.extent());
-  return llvm::ArrayType::get(t1, v.get_integer());
+  llvm::Type* parts[] {
+    llvm::PointerType::getUnqual(t1),
+    build.getInt64Ty()
+  };
+  return llvm::StructType::get(cxt, parts);
+}
+
+
+// A dynamic array has the same representation as a slice. Its extent
+// is computed at runtime, and its elements are allocated separately
+// (see gen_dynarray).
+llvm::Type*
+Generator::get_type(Dynarray_type const& t)
+{
+  llvm::Type* t1 = get_type(t.type());
+  llvm::Type* parts[] {
+    llvm::PointerType::getUnqual(t1),
+    build.getInt64Ty()
+  };
+  return llvm::StructType::get(cxt, parts);
 }
 
 
@@ -150,35 +252,47 @@ Generator::gen(Expr const& e)
   struct fn
   {
     Generator& g;
-    llvm::Value* operator()(Expr const& e) { lingo_unhandled(e); }
-    llvm::Value* operator()(Boolean_expr const& e) { return g.gen(e); }
-    llvm::Value* operator()(Integer_expr const& e) { return g.gen(e); }
-    
-    // llvm::Value* operator()(Id_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Decl_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Lambda_expr const* e) const { lingo_unreachable(); }
-    // llvm::Value* operator()(Add_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Sub_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Mul_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Div_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Rem_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Neg_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Pos_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Eq_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Ne_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Lt_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Gt_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Le_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Ge_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(And_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Or_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Not_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Call_expr const* e) const { return g.gen(e); }
+    llvm::Value* operator()(Expr const& e)               { lingo_unhandled(e); }
+    llvm::Value* operator()(Boolean_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Integer_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Object_expr const& e)        { return g.gen(e); }
+    llvm::Value* operator()(Function_expr const& e)      { return g.gen(e); }
+    llvm::Value* operator()(Add_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Sub_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Mul_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Div_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Rem_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Neg_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Pos_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Bit_and_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Bit_or_expr const& e)        { return g.gen(e); }
+    llvm::Value* operator()(Bit_xor_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Bit_lsh_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Bit_rsh_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Bit_not_expr const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Eq_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Ne_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Lt_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Gt_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Le_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Ge_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Cmp_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(And_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Or_expr const& e)            { return g.gen(e); }
+    llvm::Value* operator()(Not_expr const& e)           { return g.gen(e); }
+    llvm::Value* operator()(Assign_expr const& e)        { return g.gen(e); }
+    llvm::Value* operator()(Call_expr const& e)          { return g.gen(e); }
+    llvm::Value* operator()(Index_expr const& e)         { return g.gen(e); }
+    llvm::Value* operator()(Value_conv const& e)         { return g.gen(e); }
+    llvm::Value* operator()(Qualification_conv const& e) { return g.gen(e.source()); }
+    llvm::Value* operator()(Integer_conv const& e)       { return g.gen(e.source()); }
+    llvm::Value* operator()(Boolean_conv const& e)       { return g.gen(e); }
+    llvm::Value* operator()(Slice_conv const& e)         { return g.gen(e); }
+    llvm::Value* operator()(Copy_init const& e)          { return g.gen(e.expression()); }
+
     // llvm::Value* operator()(Dot_expr const* e) const { return g.gen(e); }
     // llvm::Value* operator()(Field_expr const* e) const { return g.gen(e); }
     // llvm::Value* operator()(Method_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Index_expr const* e) const { return g.gen(e); }
-    // llvm::Value* operator()(Value_conv const* e) const { return g.gen(e); }
     // llvm::Value* operator()(Promote_conv const* e) const { return g.gen(e); }
     // llvm::Value* operator()(Block_conv const* e) const { return g.gen(e); }
     // llvm::Value* operator()(Base_conv const* e) const { return g.gen(e); }
@@ -202,105 +316,158 @@ Generator::gen(Integer_expr const& e)
 }
 
 
-#if 0
-
-// Return the value corresponding to a literal expression.
+// Returns the value of a variable. Reading a register yields its
+// current definition. Otherwise, the value is loaded from memory.
+//
+// Note that operands of arithmetic and relational operators are not
+// yet converted to values during elaboration, so any reference to an
+// object that is not an assignment target is a read.
 llvm::Value*
-Generator::gen(Literal_expr const* e)
+Generator::gen(Object_expr const& e)
 {
-  // TODO: Write better type queries.
-  //
-  // TODO: Write a better interface for values.
-  Value v = evaluate(e);
-  Type const* t = e->type();
-  if (t == get_boolean_type())
-    return build.getInt1(v.get_integer());
-  if (t == get_character_type())
-    return build.getInt8(v.get_integer());
-  if (t == get_integer_type())
-    return build.getInt32(v.get_integer());
+  Decl const& d = e.declaration();
+  if (is_register(d))
+    return read_variable(d, build.GetInsertBlock());
+  return build.CreateLoad(gen_address(e));
+}
 
-  // FIXME: How should we generate array literals? Are
-  // these global constants or are they local alloca
-  // objects. Does it depend on context?
 
-  // A string literal produces a new global string constant.
-  // and returns a pointer to an array of N characters.
-  if (is_string(t)) {
-    Array_value a = v.get_array();
-    String s = a.get_string();
+// Returns the address of an object. Variables held in registers have
+// no address.
+llvm::Value*
+Generator::gen_address(Expr const& e)
+{
+  if (Object_expr const* obj = as<Object_expr>(&e)) {
+    lingo_assert(!is_register(obj->declaration()));
+    return lookup_global(obj->declaration());
+  }
+  if (Index_expr const* ix = as<Index_expr>(&e))
+    return gen_address(*ix);
+  lingo_unhandled(e);
+}
 
-    // FIXME: This does not unify equivalent strings.
-    // Maybe we needt maintain a mapping in order to
-    // avoid redunancies.
-    auto iter = strings.find(s);
-    if (iter == strings.end()) {
-      llvm::Value* v = build.CreateGlobalString(s);
-      iter = strings.emplace(s, v).first;
+
+// Returns the address of an element of an array, dynamic array, or
+// slice. The index is checked against the length of the object when
+// bounds checking is enabled.
+llvm::Value*
+Generator::gen_address(Index_expr const& e)
+{
+  Type const& t = e.object().type().non_reference_type().unqualified_type();
+  llvm::Value* i = build.CreateSExtOrTrunc(gen(e.index()), build.getInt64Ty());
+  if (Array_type const* a = as<Array_type>(&t)) {
+    llvm::Value* arr = gen_address(e.object());
+    if (bounds_check) {
+      llvm::Value* n = build.getInt64(get_extent(a->extent()));
+      gen_bounds_check(e, i, n);
     }
-    return iter->second;
+    llvm::Value* args[] = {build.getInt64(0), i};
+    return build.CreateGEP(arr, args);
   }
 
-  else
-    throw std::runtime_error("cannot generate function literal");
+  // Dynamic arrays and slices are represented by a pointer to their
+  // first element and their length.
+  llvm::Value* rep = gen(e.object());
+  llvm::Value* ptr = build.CreateExtractValue(rep, 0);
+  if (bounds_check) {
+    llvm::Value* n = build.CreateExtractValue(rep, 1);
+    gen_bounds_check(e, i, n);
+  }
+  return build.CreateGEP(ptr, i);
 }
 
 
 llvm::Value*
-Generator::gen(Id_expr const* e)
+Generator::gen(Index_expr const& e)
 {
-  lingo_unreachable();
+  return build.CreateLoad(gen_address(e));
 }
 
 
-// Returns the value associated with the declaration.
-llvm::Value*
-Generator::gen(Decl_expr const* e)
+// Branch to the trap block unless the index `i` is less than the length
+// `n`. Because the comparison is unsigned, this also traps on negative
+// indexes. Subscripts found to be in range by the bounds analysis are
+// not checked.
+void
+Generator::gen_bounds_check(Index_expr const& e, llvm::Value* i, llvm::Value* n)
 {
-  auto const* bind = stack.lookup(e->declaration());
-  llvm::Value* result = bind->second;
+  if (safe_indexes.count(&e)) {
+    ++bounds_stats.eliminated;
+    return;
+  }
+  ++bounds_stats.inserted;
+  gen_check(build.CreateICmpULT(i, n), "inbounds");
+}
 
-  // Fetch the value from a reference declaration.
-  Decl const* decl = bind->first;
 
-  if (is_reference(decl))
-    return build.CreateLoad(result);
-  return result;
+// Continue in a new block named `name` if `cond` is true. Otherwise,
+// the program traps.
+void
+Generator::gen_check(llvm::Value* cond, char const* name)
+{
+  llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, name, fn);
+  llvm::MDBuilder md(cxt);
+  build.CreateCondBr(cond, ok, trap_block(), md.createBranchWeights(1 << 20, 1));
+  seal_block(ok);
+  build.SetInsertPoint(ok);
+}
+
+
+// Returns the block to which failed runtime checks branch, creating it
+// on first use. There is one such block per function.
+llvm::BasicBlock*
+Generator::trap_block()
+{
+  if (trap)
+    return trap;
+  llvm::IRBuilder<> b(cxt);
+  trap = llvm::BasicBlock::Create(cxt, "trap", fn);
+  b.SetInsertPoint(trap);
+  b.CreateCall(llvm::Intrinsic::getDeclaration(mod, llvm::Intrinsic::trap));
+  b.CreateUnreachable();
+  return trap;
 }
 
 
 llvm::Value*
-Generator::gen(Add_expr const* e)
+Generator::gen(Function_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  return lookup_global(e.declaration());
+}
+
+
+llvm::Value*
+Generator::gen(Add_expr const& e)
+{
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateAdd(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Sub_expr const* e)
+Generator::gen(Sub_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateSub(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Mul_expr const* e)
+Generator::gen(Mul_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateMul(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Div_expr const* e)
+Generator::gen(Div_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateSDiv(l, r);
 }
 
@@ -308,101 +475,167 @@ Generator::gen(Div_expr const* e)
 // FIXME: decide on unsigned or signed remainder
 // based on types of expressions
 llvm::Value*
-Generator::gen(Rem_expr const* e)
+Generator::gen(Rem_expr const& e)
+{
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  return build.CreateSRem(l, r);
+}
+
+
+llvm::Value*
+Generator::gen(Neg_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
-  return build.CreateURem(l, r);
+  return build.CreateNeg(gen(e.operand()));
 }
 
 
 llvm::Value*
-Generator::gen(Neg_expr const* e)
+Generator::gen(Pos_expr const& e)
 {
-  llvm::Value* zero = build.getInt32(0);
-  llvm::Value* val = gen(e->operand());
-  return build.CreateSub(zero, val);
+  return gen(e.operand());
 }
 
 
 llvm::Value*
-Generator::gen(Pos_expr const* e)
+Generator::gen(Bit_and_expr const& e)
 {
-  return gen(e->operand());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  return build.CreateAnd(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Eq_expr const* e)
+Generator::gen(Bit_or_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  return build.CreateOr(l, r);
+}
+
+
+llvm::Value*
+Generator::gen(Bit_xor_expr const& e)
+{
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  return build.CreateXor(l, r);
+}
+
+
+llvm::Value*
+Generator::gen(Bit_lsh_expr const& e)
+{
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  return build.CreateShl(l, r);
+}
+
+
+llvm::Value*
+Generator::gen(Bit_rsh_expr const& e)
+{
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  return build.CreateAShr(l, r);
+}
+
+
+llvm::Value*
+Generator::gen(Bit_not_expr const& e)
+{
+  return build.CreateNot(gen(e.operand()));
+}
+
+
+llvm::Value*
+Generator::gen(Eq_expr const& e)
+{
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateICmpEQ(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Ne_expr const* e)
+Generator::gen(Ne_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateICmpNE(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Lt_expr const* e)
+Generator::gen(Lt_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateICmpSLT(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Gt_expr const* e)
+Generator::gen(Gt_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateICmpSGT(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Le_expr const* e)
+Generator::gen(Le_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateICmpSLE(l, r);
 }
 
 
 llvm::Value*
-Generator::gen(Ge_expr const* e)
+Generator::gen(Ge_expr const& e)
 {
-  llvm::Value* l = gen(e->left());
-  llvm::Value* r = gen(e->right());
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
   return build.CreateICmpSGE(l, r);
 }
 
 
+// The three-way comparison yields -1, 0, or 1.
 llvm::Value*
-Generator::gen(And_expr const* e)
+Generator::gen(Cmp_expr const& e)
 {
-  llvm::BasicBlock* head_block = build.GetInsertBlock();
-  llvm::BasicBlock* tail_block = llvm::BasicBlock::Create(cxt, "", fn, head_block->getNextNode());
-  llvm::BasicBlock* then_block = llvm::BasicBlock::Create(cxt, "", fn, tail_block);
+  llvm::Value* l = gen(e.left());
+  llvm::Value* r = gen(e.right());
+  llvm::Type* t = get_type(e.type());
+  llvm::Value* lt = build.CreateICmpSLT(l, r);
+  llvm::Value* gt = build.CreateICmpSGT(l, r);
+  llvm::Value* v = build.CreateSelect(gt, llvm::ConstantInt::get(t, 1),
+                                          llvm::ConstantInt::get(t, 0));
+  return build.CreateSelect(lt, llvm::ConstantInt::getSigned(t, -1), v);
+}
+
 
-  // Generate code for the left operand.
-  llvm::Value* left = gen(e->left());
+llvm::Value*
+Generator::gen(And_expr const& e)
+{
+  llvm::Value* left = gen(e.left());
+  llvm::BasicBlock* head_block = build.GetInsertBlock();
+  llvm::BasicBlock* then_block = llvm::BasicBlock::Create(cxt, "and.then", fn);
+  llvm::BasicBlock* tail_block = llvm::BasicBlock::Create(cxt, "and.done", fn);
   build.CreateCondBr(left, then_block, tail_block);
-  build.SetInsertPoint(then_block);
+  seal_block(then_block);
 
   // Generate code for the right operand.
-  llvm::Value* right = gen(e->right());
+  build.SetInsertPoint(then_block);
+  llvm::Value* right = gen(e.right());
+  then_block = build.GetInsertBlock();
   build.CreateBr(tail_block);
-  build.SetInsertPoint(tail_block);
+  seal_block(tail_block);
 
+  build.SetInsertPoint(tail_block);
   llvm::PHINode* phi_inst = build.CreatePHI(build.getInt1Ty(), 2);
   phi_inst->addIncoming(build.getFalse(), head_block);
   phi_inst->addIncoming(right, then_block);
@@ -411,22 +644,23 @@ Generator::gen(And_expr const* e)
 
 
 llvm::Value*
-Generator::gen(Or_expr const* e)
+Generator::gen(Or_expr const& e)
 {
+  llvm::Value* left = gen(e.left());
   llvm::BasicBlock* head_block = build.GetInsertBlock();
-  llvm::BasicBlock* tail_block = llvm::BasicBlock::Create(cxt, "", fn, head_block->getNextNode());
-  llvm::BasicBlock* then_block = llvm::BasicBlock::Create(cxt, "", fn, tail_block);
-
-  // Generate code for the left operand.
-  llvm::Value* left = gen(e->left());
+  llvm::BasicBlock* then_block = llvm::BasicBlock::Create(cxt, "or.else", fn);
+  llvm::BasicBlock* tail_block = llvm::BasicBlock::Create(cxt, "or.done", fn);
   build.CreateCondBr(left, tail_block, then_block);
-  build.SetInsertPoint(then_block);
+  seal_block(then_block);
 
   // Generate code for the right operand.
-  llvm::Value* right = gen(e->right());
+  build.SetInsertPoint(then_block);
+  llvm::Value* right = gen(e.right());
+  then_block = build.GetInsertBlock();
   build.CreateBr(tail_block);
-  build.SetInsertPoint(tail_block);
+  seal_block(tail_block);
 
+  build.SetInsertPoint(tail_block);
   llvm::PHINode* phi_inst = build.CreatePHI(build.getInt1Ty(), 2);
   phi_inst->addIncoming(build.getTrue(), head_block);
   phi_inst->addIncoming(right, then_block);
@@ -438,75 +672,146 @@ Generator::gen(Or_expr const* e)
 // 1 xor 1 = 0
 // 0 xor 1 = 1
 llvm::Value*
-Generator::gen(Not_expr const* e)
+Generator::gen(Not_expr const& e)
 {
   llvm::Value* one = build.getTrue();
-  llvm::Value* operand = gen(e->operand());
+  llvm::Value* operand = gen(e.operand());
   return build.CreateXor(one, operand);
 }
 
 
-namespace
+// Assignment to a register defines a new value of the variable.
+// Otherwise, the value is stored in the object. The result is the
+// assigned value.
+llvm::Value*
+Generator::gen(Assign_expr const& e)
 {
+  llvm::Value* v = gen(e.right());
+  if (Object_expr const* obj = as<Object_expr>(&e.left())) {
+    if (is_register(obj->declaration())) {
+      write_variable(obj->declaration(), build.GetInsertBlock(), v);
+      return v;
+    }
+  }
+  build.CreateStore(v, gen_address(e.left()));
+  return v;
+}
+
 
-// Returns a method declaration if e is a virtual call
-// to that method. Otherwise, returns nullptr.
-inline Method_decl const*
-calls_virtual_method(Call_expr const* e)
+// TODO: Generate virtual calls.
+llvm::Value*
+Generator::gen(Call_expr const& e)
 {
-  if (Decl_expr const* d = as<Decl_expr>(e->target()))
-    if (Method_decl const* m = as<Method_decl>(d->declaration()))
-      if (m->is_polymorphic())
-        return m;
-  return nullptr;
+  llvm::Value* callee = gen(e.function());
+  std::vector<llvm::Value*> args;
+  for (Expr const& a : e.arguments())
+    args.push_back(gen(a));
+  return build.CreateCall(callee, args);
 }
 
 
-} // namespace
+// Object references already yield values, so the conversion has no
+// effect.
+llvm::Value*
+Generator::gen(Value_conv const& e)
+{
+  return gen(e.source());
+}
 
 
 llvm::Value*
-Generator::gen(Call_expr const* e)
+Generator::gen(Boolean_conv const& e)
 {
-  // Generate the code for a virtual function call.
-  //
-  //    f(x, args...)
-  //
-  // If x is a polymorphic record type, then we want to
-  // transform that to:
-  //
-  //    x.vptr[m](x, args...);
-  //
-  // where n is the offset of the f in the virtual table
-  // of x's type.
-  //
-  // TODO: Consider representing virtual calls separately
-  // within the AST. That would help simplify the code
-  // generation a bit.
+  llvm::Value* v = gen(e.source());
+  if (v->getType()->isIntegerTy(1))
+    return v;
+  return build.CreateIsNotNull(v);
+}
+
+
+// A slice of an array is a pointer to its first element and its
+// extent. A dynamic array already has the representation of a slice.
+llvm::Value*
+Generator::gen(Slice_conv const& e)
+{
+  Type const& t = e.source().type().non_reference_type();
+  Array_type const* a = as<Array_type>(&t);
+  if (!a)
+    return gen(e.source());
+
+  llvm::Value* args[] = {build.getInt64(0), build.getInt64(0)};
+  llvm::Value* ptr = build.CreateGEP(gen_address(e.source()), args);
+  llvm::Value* n = build.getInt64(get_extent(a->extent()));
+  llvm::Value* rep = llvm::UndefValue::get(get_type(e.type()));
+  rep = build.CreateInsertValue(rep, ptr, 0);
+  return build.CreateInsertValue(rep, n, 1);
+}
+
+
+#if 0
+
+// Return the value corresponding to a literal expression.
+llvm::Value*
+Generator::gen(Literal_expr const* e)
+{
+  // TODO: Write better type queries.
   //
-  // TODO: If x refers to a variable of non-reference type,
-  // then we can call the method directly, since x's dynamic
-  // type is known.
-  llvm::Value* fn;
-  if (Method_decl const* m = calls_virtual_method(e)) {
-    Expr_seq const& args = e->arguments();
-
-    // Get (and load) the virtual function pointer.
-    llvm::Value* vptr = gen_vptr(args.front());
-    llvm::Value* a[] = {
-      build.getInt32(0),
-      build.getInt32(m->vtable_entry())
-    };
-    llvm::Value* vfpp = build.CreateInBoundsGEP(vptr, a);
-    fn = build.CreateLoad(vfpp);
-  } else {
-    fn = gen(e->target());
+  // TODO: Write a better interface for values.
+  Value v = evaluate(e);
+  Type const* t = e->type();
+  if (t == get_boolean_type())
+    return build.getInt1(v.get_integer());
+  if (t == get_character_type())
+    return build.getInt8(v.get_integer());
+  if (t == get_integer_type())
+    return build.getInt32(v.get_integer());
+
+  // FIXME: How should we generate array literals? Are
+  // these global constants or are they local alloca
+  // objects. Does it depend on context?
+
+  // A string literal produces a new global string constant.
+  // and returns a pointer to an array of N characters.
+  if (is_string(t)) {
+    Array_value a = v.get_array();
+    String s = a.get_string();
+
+    // FIXME: This does not unify equivalent strings.
+    // Maybe we needt maintain a mapping in order to
+    // avoid redunancies.
+    auto iter = strings.find(s);
+    if (iter == strings.end()) {
+      llvm::Value* v = build.CreateGlobalString(s);
+      iter = strings.emplace(s, v).first;
+    }
+    return iter->second;
   }
 
-  std::vector<llvm::Value*> args;
-  for (Expr const* a : e->arguments())
-    args.push_back(gen(a));
-  return build.CreateCall(fn, args);
+  else
+    throw std::runtime_error("cannot generate function literal");
+}
+
+
+llvm::Value*
+Generator::gen(Id_expr const* e)
+{
+  lingo_unreachable();
+}
+
+
+// Returns the value associated with the declaration.
+llvm::Value*
+Generator::gen(Decl_expr const* e)
+{
+  auto const* bind = stack.lookup(e->declaration());
+  llvm::Value* result = bind->second;
+
+  // Fetch the value from a reference declaration.
+  Decl const* decl = bind->first;
+
+  if (is_reference(decl))
+    return build.CreateLoad(result);
+  return result;
 }
 
 
@@ -534,117 +839,434 @@ Generator::gen(Field_expr const* e)
     return build.getInt32(n);
   });
 
-  return build.CreateGEP(obj, args);
+  return build.CreateGEP(obj, args);
+}
+
+
+// Just generate the base object. This will be used
+// as the argument for the method call.
+llvm::Value*
+Generator::gen(Method_expr const* e)
+{
+  return gen(e->container());
+}
+
+
+llvm::Value*
+Generator::gen(Index_expr const* e)
+{
+  llvm::Value* arr = gen(e->array());
+  llvm::Value* ix = gen(e->index());
+  std::vector<llvm::Value*> args {
+    build.getInt32(0), // 0th element from base
+    ix                 // requested index
+  };
+  return build.CreateGEP(arr, args);
+}
+
+
+llvm::Value*
+Generator::gen(Value_conv const* e)
+{
+
+  llvm::Value* v = gen(e->source());
+  return build.CreateLoad(v);
+}
+
+llvm::Value*
+Generator::gen(Promote_conv const* e)
+{
+  llvm::Value* v = gen(e->source());
+  const Type * t = e->target();
+
+  if(is<Integer_type>(t)) {
+    const Integer_type * t2 = dynamic_cast<const Integer_type*>(t);
+    return build.CreateIntCast(v, get_type(t2), t2->is_signed());
+  }
+  else if (is<Float_type>(t) || is<Double_type>(t)) {
+    return build.CreateFPCast(v, get_type(t));
+  }
+
+  else
+    return v;
+
+}
+
+
+llvm::Value*
+Generator::gen(Block_conv const* e)
+{
+  // Generate the array value.
+  llvm::Value* a = gen(e->source());
+
+  // Decay the array pointer to an array into
+  // a pointer to the first object. This effectively
+  // returns a pointer to the first object in the
+  // array.
+  llvm::Value *zero = build.getInt32(0);
+  llvm::Value *args[] = { zero, zero };
+  return build.CreateInBoundsGEP(a, args);
+}
+
+
+// Build a GEP to the base class sub-object. Note that
+// for derivation from the first base class, a bit-cast
+// would be appropriate.
+llvm::Value*
+Generator::gen(Base_conv const* e)
+{
+  llvm::Value* a = gen(e->source());
+  std::vector<llvm::Value*> args(e->path().size(), build.getInt32(0));
+  return build.CreateGEP(a, args);
+}
+
+// TODO: Return the value or store it?
+void
+Generator::gen_init(llvm::Value* ptr, Default_init const* e)
+{
+  Type const* t = e->type();
+  llvm::Type* type = get_type(t);
+  llvm::Value* init = nullptr;
+
+  // Scalar types should get a 0 value in the
+  // appropriate type.
+  if (is_scalar(t))
+    init = llvm::ConstantInt::get(type, 0);
+
+  // Aggregate types are zero initialized.
+  //
+  // NOTE: This isn't actually correct. Aggregate types
+  // should be memberwise default initialized.
+  if (is_aggregate(t))
+    init = llvm::ConstantAggregateZero::get(type);
+
+  if (init != nullptr) {
+    build.CreateStore(init, ptr);
+    return;
+  }
+
+  throw std::runtime_error("unhahndled default initializer");
+}
+
+
+#endif
+
+
+// -------------------------------------------------------------------------- //
+// Static single assignment
+//
+// Parameters and local variables of scalar type whose address is never
+// taken are not allocated storage. Their values are kept in SSA
+// registers that are built directly during code generation using the
+// algorithm of Braun et al., "Simple and Efficient Construction of
+// Static Single Assignment Form" (CC 2013).
+//
+// Each assignment records the current definition of a variable in the
+// current block. A read finds the definition in the current block or,
+// failing that, in its predecessors, inserting a phi node where control
+// flow joins. A block is sealed when all of its predecessors are known.
+// Reads in an unsealed block (the top of a loop) create incomplete phis
+// whose operands are added when the block is sealed. Phis that turn out
+// to have a single distinct operand are removed.
+
+namespace
+{
+
+// Determines which parameters and local variables of a function have
+// their address taken. A variable is held in a register unless a
+// reference is bound to it.
+//
+// The analysis is conservative: if the function contains a statement
+// or expression that is not understood, no variables are registers.
+struct Register_analysis
+{
+  struct Unknown { };
+
+  void function(Function_decl const&);
+  void variable(Decl const&);
+  void statement(Stmt const&);
+  void expression(Expr const&);
+
+  Decl_set candidates;
+  Decl_set taken;
+};
+
+
+void
+Register_analysis::function(Function_decl const& f)
+{
+  Function_def const* def = as<Function_def>(&f.definition());
+  if (!def)
+    return;
+  try {
+    for (Decl const& p : f.parameters())
+      variable(p);
+    statement(def->statement());
+  } catch (Unknown&) {
+    candidates.clear();
+  }
+  for (Decl const* d : taken)
+    candidates.erase(d);
+}
+
+
+void
+Register_analysis::variable(Decl const& d)
+{
+  Type const& t = declared_type(d).unqualified_type();
+  if (is_boolean_type(t) || is_integer_type(t))
+    candidates.insert(&d);
+}
+
+
+void
+Register_analysis::statement(Stmt const& s)
+{
+  struct fn
+  {
+    Register_analysis& self;
+    void operator()(Stmt const& s)             { throw Unknown(); }
+    void operator()(Empty_stmt const& s)       { }
+    void operator()(Break_stmt const& s)       { }
+    void operator()(Continue_stmt const& s)    { }
+    void operator()(Return_stmt const& s)      { self.expression(s.expression()); }
+
+    void operator()(Compound_stmt const& s)
+    {
+      for (Stmt const& s1 : s.statements())
+        self.statement(s1);
+    }
+
+    void operator()(If_then_stmt const& s)
+    {
+      self.expression(s.condition());
+      self.statement(s.true_branch());
+    }
+
+    void operator()(If_else_stmt const& s)
+    {
+      self.expression(s.condition());
+      self.statement(s.true_branch());
+      self.statement(s.false_branch());
+    }
+
+    void operator()(While_stmt const& s)
+    {
+      self.expression(s.condition());
+      self.statement(s.body());
+    }
+
+    void operator()(Expression_stmt const& s)
+    {
+      self.expression(s.expression());
+    }
+
+    void operator()(Declaration_stmt const& s)
+    {
+      Variable_decl const* var = as<Variable_decl>(&s.declaration());
+      if (!var)
+        throw Unknown();
+      self.variable(*var);
+      if (Expression_def const* def = as<Expression_def>(&var->initializer()))
+        self.expression(def->expression());
+      else if (!is<Empty_def>(&var->initializer()))
+        throw Unknown();
+    }
+  };
+  apply(s, fn{*this});
+}
+
+
+void
+Register_analysis::expression(Expr const& e)
+{
+  struct fn
+  {
+    Register_analysis& self;
+    void operator()(Expr const& e)          { throw Unknown(); }
+    void operator()(Boolean_expr const& e)  { }
+    void operator()(Integer_expr const& e)  { }
+    void operator()(Function_expr const& e) { }
+    void operator()(Object_expr const& e)   { }
+    void operator()(Unary_expr const& e)    { self.expression(e.operand()); }
+    void operator()(Conv const& e)          { self.expression(e.source()); }
+    void operator()(Copy_init const& e)     { self.expression(e.expression()); }
+
+    void operator()(Binary_expr const& e)
+    {
+      self.expression(e.left());
+      self.expression(e.right());
+    }
+
+    void operator()(Call_expr const& e)
+    {
+      self.expression(e.function());
+      for (Expr const& a : e.arguments())
+        self.expression(a);
+    }
+
+    // Binding a reference to a variable takes its address.
+    void operator()(Bind_init const& e)
+    {
+      if (Object_expr const* obj = as<Object_expr>(&e.expression()))
+        self.taken.insert(&obj->declaration());
+      else
+        self.expression(e.expression());
+    }
+  };
+  apply(e, fn{*this});
 }
 
+} // namespace
 
-// Just generate the base object. This will be used
-// as the argument for the method call.
-llvm::Value*
-Generator::gen(Method_expr const* e)
+
+// Determine the parameters and locals of `f` that are held in
+// registers.
+void
+Generator::find_registers(Function_decl const& f)
 {
-  return gen(e->container());
+  Register_analysis a;
+  a.function(f);
+  registers = std::move(a.candidates);
 }
 
 
-llvm::Value*
-Generator::gen(Index_expr const* e)
+// Discard all SSA state for the current function.
+void
+Generator::clear_registers()
 {
-  llvm::Value* arr = gen(e->array());
-  llvm::Value* ix = gen(e->index());
-  std::vector<llvm::Value*> args {
-    build.getInt32(0), // 0th element from base
-    ix                 // requested index
-  };
-  return build.CreateGEP(arr, args);
+  registers.clear();
+  defs.clear();
+  sealed.clear();
+  incomplete.clear();
 }
 
 
-llvm::Value*
-Generator::gen(Value_conv const* e)
+// Record `v` as the current value of the variable `d` in block `b`.
+void
+Generator::write_variable(Decl const& d, llvm::BasicBlock* b, llvm::Value* v)
 {
-
-  llvm::Value* v = gen(e->source());
-  return build.CreateLoad(v);
+  defs[&d][b] = v;
 }
 
+
+// Returns the current value of the variable `d` in block `b`.
 llvm::Value*
-Generator::gen(Promote_conv const* e)
+Generator::read_variable(Decl const& d, llvm::BasicBlock* b)
 {
-  llvm::Value* v = gen(e->source());
-  const Type * t = e->target();
-
-  if(is<Integer_type>(t)) {
-    const Integer_type * t2 = dynamic_cast<const Integer_type*>(t);
-    return build.CreateIntCast(v, get_type(t2), t2->is_signed());
-  }
-  else if (is<Float_type>(t) || is<Double_type>(t)) {
-    return build.CreateFPCast(v, get_type(t));
+  auto iter = defs.find(&d);
+  if (iter != defs.end()) {
+    auto def = iter->second.find(b);
+    if (def != iter->second.end())
+      return def->second;
   }
+  return read_variable_recursive(d, b);
+}
 
-  else
-    return v;
 
+// Find the value of `d` in the predecessors of `b`. In an unsealed
+// block, this creates an incomplete phi. In a block with a single
+// predecessor, no phi is needed. Otherwise, a phi is created to break
+// cycles in the search, and its operands are read from each
+// predecessor.
+llvm::Value*
+Generator::read_variable_recursive(Decl const& d, llvm::BasicBlock* b)
+{
+  llvm::Value* v;
+  if (!sealed.count(b)) {
+    llvm::PHINode* phi = make_phi(d, b);
+    incomplete[b].push_back({&d, phi});
+    v = phi;
+  } else if (llvm::BasicBlock* p = b->getSinglePredecessor()) {
+    v = read_variable(d, p);
+  } else if (llvm::pred_begin(b) == llvm::pred_end(b)) {
+    // The variable is read before it is defined, or the block is
+    // unreachable.
+    v = llvm::UndefValue::get(get_type(declared_type(d)));
+  } else {
+    llvm::PHINode* phi = make_phi(d, b);
+    write_variable(d, b, phi);
+    v = add_phi_operands(d, phi);
+  }
+  write_variable(d, b, v);
+  return v;
 }
 
 
-llvm::Value*
-Generator::gen(Block_conv const* e)
+// Create an empty phi for `d` at the beginning of `b`.
+llvm::PHINode*
+Generator::make_phi(Decl const& d, llvm::BasicBlock* b)
 {
-  // Generate the array value.
-  llvm::Value* a = gen(e->source());
-
-  // Decay the array pointer to an array into
-  // a pointer to the first object. This effectively
-  // returns a pointer to the first object in the
-  // array.
-  llvm::Value *zero = build.getInt32(0);
-  llvm::Value *args[] = { zero, zero };
-  return build.CreateInBoundsGEP(a, args);
+  llvm::Type* t = get_type(declared_type(d));
+  String name = cast<Simple_id>(d.name()).symbol().spelling();
+  if (b->empty())
+    return llvm::PHINode::Create(t, 2, name, b);
+  else
+    return llvm::PHINode::Create(t, 2, name, &b->front());
 }
 
 
-// Build a GEP to the base class sub-object. Note that
-// for derivation from the first base class, a bit-cast
-// would be appropriate.
+// Add an operand to `phi` for each predecessor of its block, and then
+// try to remove it.
 llvm::Value*
-Generator::gen(Base_conv const* e)
+Generator::add_phi_operands(Decl const& d, llvm::PHINode* phi)
 {
-  llvm::Value* a = gen(e->source());
-  std::vector<llvm::Value*> args(e->path().size(), build.getInt32(0));
-  return build.CreateGEP(a, args);
+  llvm::BasicBlock* b = phi->getParent();
+  for (auto pi = llvm::pred_begin(b); pi != llvm::pred_end(b); ++pi)
+    phi->addIncoming(read_variable(d, *pi), *pi);
+  return remove_trivial_phi(phi);
 }
 
-// TODO: Return the value or store it?
-void
-Generator::gen_init(llvm::Value* ptr, Default_init const* e)
-{
-  Type const* t = e->type();
-  llvm::Type* type = get_type(t);
-  llvm::Value* init = nullptr;
 
-  // Scalar types should get a 0 value in the
-  // appropriate type.
-  if (is_scalar(t))
-    init = llvm::ConstantInt::get(type, 0);
+// If every operand of `phi` is either the phi itself or a single other
+// value, replace the phi by that value. Removing a phi can make phis
+// that use it trivial, so those are tried again.
+//
+// Current definitions are held by value handles, which follow the
+// replacement.
+llvm::Value*
+Generator::remove_trivial_phi(llvm::PHINode* phi)
+{
+  llvm::Value* same = nullptr;
+  for (llvm::Value* op : phi->operands()) {
+    if (op == same || op == phi)
+      continue;
+    if (same)
+      return phi;
+    same = op;
+  }
+  if (!same)
+    same = llvm::UndefValue::get(phi->getType());
 
-  // Aggregate types are zero initialized.
-  //
-  // NOTE: This isn't actually correct. Aggregate types
-  // should be memberwise default initialized.
-  if (is_aggregate(t))
-    init = llvm::ConstantAggregateZero::get(type);
+  std::vector<llvm::WeakVH> users;
+  for (llvm::User* u : phi->users())
+    if (u != phi && llvm::isa<llvm::PHINode>(u))
+      users.push_back(u);
 
-  if (init != nullptr) {
-    build.CreateStore(init, ptr);
-    return;
-  }
+  llvm::WeakVH result(same);
+  phi->replaceAllUsesWith(same);
+  phi->eraseFromParent();
 
-  throw std::runtime_error("unhahndled default initializer");
+  for (llvm::Value* u : users)
+    if (llvm::PHINode* p = llvm::dyn_cast_or_null<llvm::PHINode>(u))
+      remove_trivial_phi(p);
+  return result;
 }
 
 
-#endif
+// Mark `b` as having all of its predecessors. The incomplete phis of
+// the block are completed.
+void
+Generator::seal_block(llvm::BasicBlock* b)
+{
+  auto iter = incomplete.find(b);
+  if (iter != incomplete.end()) {
+    for (auto& inc : iter->second)
+      add_phi_operands(*inc.first, inc.second);
+    incomplete.erase(iter);
+  }
+  sealed.insert(b);
+}
 
 
 // -------------------------------------------------------------------------- //
@@ -667,7 +1289,8 @@ Generator::gen(Stmt const& s)
     void operator()(Break_stmt const& s)       { g.gen(s); }
     void operator()(Continue_stmt const& s)    { g.gen(s); }
     void operator()(Declaration_stmt const& s) { g.gen(s); }
-    // void operator()(Expression_stmt const& s) { g.gen(s); }
+    void operator()(Expression_stmt const& s)  { g.gen(s); }
+    void operator()(Yield_stmt const& s)       { g.gen(s); }
   };
   apply(s, Fn{*this});
 }
@@ -692,13 +1315,7 @@ Generator::gen(Translation_stmt const& s)
   mod = new llvm::Module("a.ll", cxt);
 
   gen(s.statements());
-
-  // Dump the code to stdout.
-  //
-  // FIXME: This is stupid. Actually dump it to a file.
-  std::error_code err;
-  llvm::raw_fd_ostream ofs(STDOUT_FILENO, false);
-  ofs << *mod;
+  gen_global_init(s);
 }
 
 
@@ -721,11 +1338,14 @@ Generator::gen(Compound_stmt const& s)
 // Generate a return statement. Note that this does not return diretctly. 
 // We store the return value and then branch to the exit block. This strategy 
 // allows us to execute destructors in the exit block.
+//
+// A return statement finishes a coroutine. Its value is discarded.
 void
 Generator::gen(Return_stmt const& s)
 {
   llvm::Value* v = gen(s.expression());
-  build.CreateStore(v, ret);
+  if (!frame)
+    build.CreateStore(v, ret);
   build.CreateBr(exit);
 }
 
@@ -738,6 +1358,7 @@ Generator::gen(If_then_stmt const& s)
   llvm::BasicBlock* then = llvm::BasicBlock::Create(cxt, "if.then", fn);
   llvm::BasicBlock* done = llvm::BasicBlock::Create(cxt, "if.done", fn);
   build.CreateCondBr(cond, then, done);
+  seal_block(then);
 
   // Emit the 'then' block
   build.SetInsertPoint(then);
@@ -747,6 +1368,7 @@ Generator::gen(If_then_stmt const& s)
     build.CreateBr(done);
 
   // Emit the merge point.
+  seal_block(done);
   build.SetInsertPoint(done);
 }
 
@@ -760,6 +1382,8 @@ Generator::gen(If_else_stmt const& s)
   llvm::BasicBlock* other = llvm::BasicBlock::Create(cxt, "if.else", fn);
   llvm::BasicBlock* done = llvm::BasicBlock::Create(cxt, "if.done", fn);
   build.CreateCondBr(cond, then, other);
+  seal_block(then);
+  seal_block(other);
 
   // Emit the then block.
   build.SetInsertPoint(then);
@@ -776,6 +1400,7 @@ Generator::gen(If_else_stmt const& s)
     build.CreateBr(done);
 
   // Emit the done block.
+  seal_block(done);
   build.SetInsertPoint(done);
 }
 
@@ -793,10 +1418,12 @@ Generator::gen(While_stmt const& s)
   llvm::BasicBlock* body = llvm::BasicBlock::Create(cxt, "while.body", fn, bot);
   build.CreateBr(top);
 
-  // Emit the condition test.
+  // Emit the condition test. The top of the loop cannot be sealed
+  // until the back edge and every continue have been emitted.
   build.SetInsertPoint(top);
   llvm::Value* cond = gen(s.condition());
   build.CreateCondBr(cond, body, bot);
+  seal_block(body);
 
   // Emit the loop body.
   build.SetInsertPoint(body);
@@ -804,8 +1431,10 @@ Generator::gen(While_stmt const& s)
   body = build.GetInsertBlock();
   if (!body->getTerminator())
     build.CreateBr(top);
+  seal_block(top);
 
-  // Emit the bottom block.
+  // Emit the bottom block. All breaks have been emitted.
+  seal_block(bot);
   build.SetInsertPoint(bot);
 }
 
@@ -842,28 +1471,35 @@ Generator::gen(Stmt_list const& s)
 }
 
 
-#if 0
-
-
-
 void
-Generator::gen(Assign_stmt const* s)
+Generator::gen(Expression_stmt const& s)
 {
-  llvm::Value* lhs = gen(s->object());
-  llvm::Value* rhs = gen(s->value());
-  build.CreateStore(rhs, lhs);
+  gen(s.expression());
 }
 
 
-
+// A yield statement stores its value in the frame, records the point
+// at which the coroutine resumes, and returns from the resume function.
+// Code following the yield is generated into the block that the resume
+// switch selects for that point.
 void
-Generator::gen(Expression_stmt const* s)
+Generator::gen(Yield_stmt const& s)
 {
-  gen(s->expression());
-}
+  if (!frame)
+    throw Translation_error("yield statement outside of a coroutine");
+
+  llvm::Value* v = gen(s.expression());
+  build.CreateStore(v, build.CreateStructGEP(frame, 1));
+  llvm::ConstantInt* state = build.getInt32(++suspends);
+  build.CreateStore(state, build.CreateStructGEP(frame, 0));
+  build.CreateRet(build.getTrue());
 
+  llvm::BasicBlock* next = llvm::BasicBlock::Create(cxt, "resume", fn);
+  resume->addCase(state, next);
+  seal_block(next);
+  build.SetInsertPoint(next);
+}
 
-#endif
 
 // -------------------------------------------------------------------------- //
 // Code generation for declarations
@@ -877,6 +1513,7 @@ Generator::gen(Decl const& d)
     void operator()(Decl const& d)          { lingo_unhandled(d); }
     void operator()(Variable_decl const& d) { return g.gen(d); }
     void operator()(Function_decl const& d) { return g.gen(d); }
+    void operator()(Coroutine_decl const& d) { return g.gen(d); }
 
     // void operator()(Record_decl const& d)    { return g.gen(d); }
     // void operator()(Field_decl const& d)     { return g.gen(d); }
@@ -892,39 +1529,202 @@ Generator::gen(Decl const& d)
 void
 Generator::gen_local_variable(Variable_decl const& d)
 {
-  // Create the alloca instruction at the beginning of the function, and 
-  // not at the point it is declare. That is automatic storage is allocated
-  // at the beginning of the function. Initialization happens here.
-  llvm::BasicBlock& b = fn->getEntryBlock();
-  llvm::IRBuilder<> tmp(&b, b.begin());
-  llvm::Type* type = get_type(d.type());
+  // A variable whose address is never taken is held in an SSA register.
+  // Its initial value is its first definition.
+  if (is_register(d)) {
+    llvm::Value* init;
+    if (Expression_def const* def = as<Expression_def>(&d.initializer()))
+      init = gen(def->expression());
+    else
+      init = llvm::UndefValue::get(get_type(d.type()));
+    write_variable(d, build.GetInsertBlock(), init);
+    return;
+  }
 
-  // TODO: Between this and parameter names, I'm convinced I need
-  // an easier way to get non-mangled ids.
-  Simple_id const& id = cast<Simple_id>(d.name());
-  String name = id.symbol().spelling();
-  llvm::Value* ptr = tmp.CreateAlloca(type, nullptr, name);
+  // A variable that lives across a yield is already bound to its slot
+  // in the coroutine frame.
+  llvm::Value* ptr;
+  if (hoisted.count(&d)) {
+    ptr = lookup(d);
+  } else {
+    // Create the alloca instruction at the beginning of the function, and 
+    // not at the point it is declare. That is automatic storage is allocated
+    // at the beginning of the function. Initialization happens here.
+    llvm::BasicBlock& b = fn->getEntryBlock();
+    llvm::IRBuilder<> tmp(&b, b.begin());
+    llvm::Type* type = get_type(d.type());
+
+    // TODO: Between this and parameter names, I'm convinced I need
+    // an easier way to get non-mangled ids.
+    Simple_id const& id = cast<Simple_id>(d.name());
+    String name = id.symbol().spelling();
+    ptr = tmp.CreateAlloca(type, nullptr, name);
+
+    // Save the decl binding.
+    declare(d, ptr);
+  }
 
-  // Save the decl binding.
-  declare(d, ptr);
+  // Allocate the elements of a dynamic array.
+  //
+  // TODO: Support dynamic arrays in coroutines. Their buffers must
+  // outlive suspension, and be released when the coroutine finishes.
+  if (Dynarray_type const* t = as<Dynarray_type>(&d.type().unqualified_type())) {
+    if (frame)
+      throw Translation_error("dynamic arrays are not supported in coroutines");
+    check_dynarray_init(d);
+    gen_dynarray(ptr, *t);
+    return;
+  }
 
   // Generate the initializer.
   gen_local_init(ptr, d.initializer());
 }
 
 
+// Allocate the elements of a dynamic array whose representation is
+// stored in `ptr`. Arrays of up to dynarray_stack_limit bytes are
+// allocated on the stack. Larger arrays are allocated with malloc
+// and released when the function returns.
+//
+// A declaration within a loop is executed repeatedly, and stack
+// allocations would accumulate until the function returns, so those
+// arrays are always allocated on the heap. When the declaration is
+// executed again, the previous array is dead and its buffer is freed.
+void
+Generator::gen_dynarray(llvm::Value* ptr, Dynarray_type const& t)
+{
+  llvm::Type* elem = get_type(t.type());
+  llvm::Type* elem_ptr = llvm::PointerType::getUnqual(elem);
+  llvm::Type* byte_ptr = build.getInt8PtrTy();
+  llvm::Constant* null = llvm::Constant::getNullValue(byte_ptr);
+
+  // Create the heap buffer slot in the entry block.
+  llvm::BasicBlock& b = fn->getEntryBlock();
+  llvm::IRBuilder<> tmp(&b, b.begin());
+  llvm::Value* heap = tmp.CreateAlloca(byte_ptr, nullptr, "dyn.heap");
+  tmp.CreateStore(null, heap);
+  cleanups.push_back(heap);
+
+  // Compute the extent and the size of the array in bytes.
+  llvm::Value* n = gen_extent(t);
+  llvm::Value* size = build.CreateMul(n, llvm::ConstantExpr::getSizeOf(elem));
+
+  llvm::Value* data;
+  if (top) {
+    build.CreateCall(free_function(), build.CreateLoad(heap));
+    llvm::Value* mem = gen_malloc(size);
+    build.CreateStore(mem, heap);
+    data = build.CreateBitCast(mem, elem_ptr);
+  } else {
+    llvm::Value* limit = build.getInt64(dynarray_stack_limit);
+    llvm::Value* small = build.CreateICmpULE(size, limit);
+    llvm::BasicBlock* on_stack = llvm::BasicBlock::Create(cxt, "dyn.stack", fn);
+    llvm::BasicBlock* on_heap = llvm::BasicBlock::Create(cxt, "dyn.heap", fn);
+    llvm::BasicBlock* done = llvm::BasicBlock::Create(cxt, "dyn.done", fn);
+    build.CreateCondBr(small, on_stack, on_heap);
+    seal_block(on_stack);
+    seal_block(on_heap);
+
+    build.SetInsertPoint(on_stack);
+    llvm::Value* p1 = build.CreateAlloca(elem, n);
+    build.CreateBr(done);
+
+    build.SetInsertPoint(on_heap);
+    llvm::Value* mem = gen_malloc(size);
+    build.CreateStore(mem, heap);
+    llvm::Value* p2 = build.CreateBitCast(mem, elem_ptr);
+    on_heap = build.GetInsertBlock();
+    build.CreateBr(done);
+
+    seal_block(done);
+    build.SetInsertPoint(done);
+    llvm::PHINode* phi = build.CreatePHI(elem_ptr, 2);
+    phi->addIncoming(p1, on_stack);
+    phi->addIncoming(p2, on_heap);
+    data = phi;
+  }
+
+  // Store the representation.
+  llvm::Value* rep = llvm::UndefValue::get(get_type(t));
+  rep = build.CreateInsertValue(rep, data, 0);
+  rep = build.CreateInsertValue(rep, n, 1);
+  build.CreateStore(rep, ptr);
+}
+
+
+// Returns the extent of the dynamic array type `t` as a 64-bit integer.
+// The program traps if the extent is negative, or if the size of the
+// array in bytes cannot be represented.
+llvm::Value*
+Generator::gen_extent(Dynarray_type const& t)
+{
+  llvm::Type* elem = get_type(t.type());
+  llvm::Value* n = build.CreateSExtOrTrunc(gen(t.extent()), build.getInt64Ty());
+  llvm::Constant* max = llvm::ConstantExpr::getUDiv(
+    build.getInt64(std::numeric_limits<std::int64_t>::max()),
+    llvm::ConstantExpr::getSizeOf(elem));
+  gen_check(build.CreateICmpULE(n, max), "extent.ok");
+  return n;
+}
+
+
+// Allocate `size` bytes with malloc. The program traps if the
+// allocation fails.
+llvm::Value*
+Generator::gen_malloc(llvm::Value* size)
+{
+  llvm::Value* mem = build.CreateCall(malloc_function(), size);
+  llvm::Value* ok = build.CreateOr(build.CreateIsNotNull(mem),
+                                   build.CreateICmpEQ(size, build.getInt64(0)));
+  gen_check(ok, "alloc.ok");
+  return mem;
+}
+
+
+// Dynamic arrays are allocated with their extent, and cannot be
+// initialized otherwise.
+void
+Generator::check_dynarray_init(Variable_decl const& d)
+{
+  if (Expression_def const* def = as<Expression_def>(&d.initializer()))
+    if (!is<Trivial_init>(&def->expression()))
+      throw Translation_error("dynamic arrays cannot have initializers");
+}
+
+
+// Returns the declaration of malloc.
+llvm::Function*
+Generator::malloc_function()
+{
+  llvm::Type* byte_ptr = build.getInt8PtrTy();
+  llvm::Constant* f = mod->getOrInsertFunction("malloc", byte_ptr, build.getInt64Ty(), nullptr);
+  return llvm::cast<llvm::Function>(f);
+}
+
+
+// Returns the declaration of free.
+llvm::Function*
+Generator::free_function()
+{
+  llvm::Type* byte_ptr = build.getInt8PtrTy();
+  llvm::Constant* f = mod->getOrInsertFunction("free", build.getVoidTy(), byte_ptr, nullptr);
+  return llvm::cast<llvm::Function>(f);
+}
+
+
 void
 Generator::gen_global_variable(Variable_decl const& d)
 {
   String      name = get_name(d);
   llvm::Type* type = get_type(d.type());
 
-  // Generate a null constant initializer for the global. Note that this 
-  // might be overritten by a static initializer later.
-  //
-  // TODO: Check the variable definition. If it's non-constant, then
-  // add it to a static initialization queue for later.
-  llvm::Constant* init = llvm::Constant::getNullValue(type);
+  // Generate a null constant initializer for the global. This is
+  // replaced by a constant initializer, or the variable is initialized
+  // before main (see gen_global_init). A variable defined in another
+  // module has no initializer.
+  llvm::Constant* init = nullptr;
+  if (defines(d))
+    init = llvm::Constant::getNullValue(type);
 
 
   // Build the global variable, automatically adding
@@ -943,6 +1743,83 @@ Generator::gen_global_variable(Variable_decl const& d)
 }
 
 
+// Generate the initialization of the global variables defined by the
+// translation unit `s`. A global whose initializer is a constant is
+// initialized statically. The others are initialized, in the order
+// given by order_globals, by a function that runs before main. The C++
+// generator defines globals in the same order.
+void
+Generator::gen_global_init(Translation_stmt const& s)
+{
+  std::vector<Decl const*> vars;
+  for (Stmt const& s1 : s.statements()) {
+    if (Declaration_stmt const* ds = as<Declaration_stmt>(&s1)) {
+      Decl const& d = ds->declaration();
+      if (is<Variable_decl>(&d) && defines(d))
+        vars.push_back(&d);
+    }
+  }
+
+  fn = llvm::Function::Create(
+    llvm::FunctionType::get(build.getVoidTy(), false),
+    llvm::Function::InternalLinkage,
+    "banjo.init",
+    mod);
+  entry = llvm::BasicBlock::Create(cxt, "entry", fn);
+  build.SetInsertPoint(entry);
+  seal_block(entry);
+
+  bool dynamic = false;
+  for (Decl const* d : order_globals(vars)) {
+    Variable_decl const& var = cast<Variable_decl>(*d);
+    llvm::GlobalVariable* ptr = llvm::cast<llvm::GlobalVariable>(lookup_global(var));
+    if (Dynarray_type const* t = as<Dynarray_type>(&var.type().unqualified_type())) {
+      check_dynarray_init(var);
+      gen_global_dynarray(ptr, *t);
+      dynamic = true;
+      continue;
+    }
+    Expression_def const* def = as<Expression_def>(&var.initializer());
+    if (!def || is<Trivial_init>(&def->expression()))
+      continue;
+    llvm::Value* init = gen(def->expression());
+    if (llvm::Constant* c = llvm::dyn_cast<llvm::Constant>(init)) {
+      ptr->setInitializer(c);
+    } else {
+      build.CreateStore(init, ptr);
+      dynamic = true;
+    }
+  }
+  build.CreateRetVoid();
+
+  if (dynamic)
+    llvm::appendToGlobalCtors(*mod, fn, 65535);
+  else
+    fn->eraseFromParent();
+  fn = nullptr;
+  entry = nullptr;
+  trap = nullptr;
+  clear_registers();
+}
+
+
+// Allocate the elements of a global dynamic array, whose representation
+// is stored in `ptr`. The elements live as long as the program.
+void
+Generator::gen_global_dynarray(llvm::Value* ptr, Dynarray_type const& t)
+{
+  llvm::Type* elem = get_type(t.type());
+  llvm::Type* elem_ptr = llvm::PointerType::getUnqual(elem);
+  llvm::Value* n = gen_extent(t);
+  llvm::Value* size = build.CreateMul(n, llvm::ConstantExpr::getSizeOf(elem));
+  llvm::Value* mem = gen_malloc(size);
+  llvm::Value* rep = llvm::UndefValue::get(get_type(t));
+  rep = build.CreateInsertValue(rep, build.CreateBitCast(mem, elem_ptr), 0);
+  rep = build.CreateInsertValue(rep, n, 1);
+  build.CreateStore(rep, ptr);
+}
+
+
 // Generate code for a variable declaration. Note that
 // code generation depends heavily on context. Globals
 // and locals are very different.
@@ -1020,6 +1897,11 @@ Generator::gen(Function_decl const& d)
   // Create a new binding for the variable.
   declare(d, fn);
 
+  // A function defined in another module is only declared.
+  if (!defines(d)) {
+    fn = nullptr;
+    return;
+  }
 
   // Establish a new environment for declarations within this 
   // function's scope.
@@ -1042,10 +1924,18 @@ Generator::gen(Function_decl const& d)
     }
   }
 
+  // Find the parameters and locals that can be held in registers.
+  find_registers(d);
+
+  // Find the subscripts that need no bounds checks.
+  if (bounds_check)
+    safe_indexes = find_safe_indexes(d);
+
   // Build the entry and exit blocks for the function.
   entry = llvm::BasicBlock::Create(cxt, "entry", fn);
   exit = llvm::BasicBlock::Create(cxt, "exit");
   build.SetInsertPoint(entry);
+  seal_block(entry);
 
   // Build storage for the return value if non-void.
   if (!is<Void_type>(d.return_type()))
@@ -1054,13 +1944,20 @@ Generator::gen(Function_decl const& d)
     ret = nullptr;
 
   // Allocate storage for each parameter and cause its argument value
-  // to be copied to storage.
+  // to be copied to storage. A parameter whose address is never taken
+  // is held in an SSA register, whose initial value is the argument.
   {
     auto ai = fn->arg_begin();
     auto pi = d.parameters().begin();
     while (ai != fn->arg_end()) {
       Decl const& p = *pi;
       llvm::Argument* arg = &*ai;
+      if (is_register(p)) {
+        write_variable(p, entry, arg);
+        ++ai;
+        ++pi;
+        continue;
+      }
 
       // Create a local variable for the argument, and store copy
       // the argument into that storage.
@@ -1087,8 +1984,14 @@ Generator::gen(Function_decl const& d)
   // Insert the exit block and generate the actual
   // return statement,
   fn->getBasicBlockList().push_back(exit);
+  seal_block(exit);
   build.SetInsertPoint(exit);
 
+  // Release heap allocated dynamic arrays.
+  for (llvm::Value* heap : cleanups)
+    build.CreateCall(free_function(), build.CreateLoad(heap));
+  cleanups.clear();
+
   // Load and return the returned value.
   if (ret)
     build.CreateRet(build.CreateLoad(ret));
@@ -1098,6 +2001,151 @@ Generator::gen(Function_decl const& d)
   // Reset stateful info.
   ret = nullptr;
   fn = nullptr;
+  trap = nullptr;
+  safe_indexes.clear();
+  clear_registers();
+}
+
+
+// -------------------------------------------------------------------------- //
+// Coroutine declarations
+
+// A coroutine is lowered to a frame type and a pair of functions. For
+// the coroutine
+//
+//    codef f : (p1 : T1, ..., pn : Tn) -> R { ... }
+//
+// we generate
+//
+//    %f.frame = type { i32, R, T1, ..., Tn, L1, ..., Lm }
+//    define void @f.init(%f.frame*, T1, ..., Tn)
+//    define i1 @f.resume(%f.frame*)
+//
+// The frame holds the state of the coroutine, the most recently yielded
+// value, the parameters, and the local variables L that live across a
+// yield. The caller provides storage for the frame, so the coroutine
+// never allocates, and a frame can live on the caller's stack.
+//
+// Initialization stores the arguments in the frame. Each call to resume
+// runs the coroutine to its next yield, and returns true after storing
+// the yielded value in the frame. When the coroutine finishes, resume
+// returns false, as does every later call.
+void
+Generator::gen(Coroutine_decl const& d)
+{
+  String name = get_name(d);
+  Coroutine_frame layout = layout_frame(d);
+
+  // Build the frame type.
+  std::vector<llvm::Type*> ts {build.getInt32Ty(), get_type(d.return_type())};
+  for (Decl const* v : layout.vars)
+    ts.push_back(get_type(v->type()));
+  llvm::StructType* type = llvm::StructType::create(cxt, ts, name + ".frame");
+  llvm::Type* ptr = type->getPointerTo();
+
+  // Build the functions.
+  std::vector<llvm::Type*> parms {ptr};
+  for (Decl const& p : d.parameters())
+    parms.push_back(get_type(p.type()));
+  llvm::Function* init = llvm::Function::Create(
+    llvm::FunctionType::get(build.getVoidTy(), parms, false),
+    llvm::Function::ExternalLinkage,
+    name + ".init",
+    mod);
+  llvm::Function* res = llvm::Function::Create(
+    llvm::FunctionType::get(build.getInt1Ty(), ptr, false),
+    llvm::Function::ExternalLinkage,
+    name + ".resume",
+    mod);
+
+  // A coroutine defined in another module is only declared.
+  if (!defines(d))
+    return;
+
+  gen_coroutine_init(init);
+  gen_coroutine_resume(d, res, layout);
+}
+
+
+// The initial state is 0, which starts the body of the coroutine.
+void
+Generator::gen_coroutine_init(llvm::Function* init)
+{
+  llvm::BasicBlock* b = llvm::BasicBlock::Create(cxt, "entry", init);
+  build.SetInsertPoint(b);
+
+  auto ai = init->arg_begin();
+  llvm::Value* f = &*ai++;
+  f->setName("frame");
+  build.CreateStore(build.getInt32(0), build.CreateStructGEP(f, 0));
+
+  // Parameters are the first variables of the frame.
+  for (unsigned n = 2; ai != init->arg_end(); ++ai, ++n)
+    build.CreateStore(&*ai, build.CreateStructGEP(f, n));
+  build.CreateRetVoid();
+}
+
+
+// The resume function begins with a switch over the state of the
+// coroutine. State 0 selects the start of the body, and state n the
+// statement following the nth yield. Any other state, including the
+// final state -1, selects the exit block, which returns false.
+//
+// Local variables that do not live across a yield are allocated in the
+// resume function, like those of a normal function.
+void
+Generator::gen_coroutine_resume(Coroutine_decl const& d,
+                                llvm::Function* f,
+                                Coroutine_frame const& layout)
+{
+  fn = f;
+  Enter_context scope(*this, function_cxt);
+
+  frame = &*fn->arg_begin();
+  frame->setName("frame");
+
+  entry = llvm::BasicBlock::Create(cxt, "entry", fn);
+  exit = llvm::BasicBlock::Create(cxt, "exit");
+  build.SetInsertPoint(entry);
+  seal_block(entry);
+  ret = nullptr;
+
+  // Bind the parameters and hoisted locals to their slots.
+  unsigned n = 2;
+  for (Decl const* v : layout.vars) {
+    declare(*v, build.CreateStructGEP(frame, n++, get_name(*v)));
+    if (!is<Object_parm>(v))
+      hoisted.insert(v);
+  }
+
+  // Dispatch on the state.
+  llvm::Value* state = build.CreateLoad(build.CreateStructGEP(frame, 0));
+  llvm::BasicBlock* start = llvm::BasicBlock::Create(cxt, "start", fn);
+  resume = build.CreateSwitch(state, exit, layout.suspends + 1);
+  resume->addCase(build.getInt32(0), start);
+  seal_block(start);
+  build.SetInsertPoint(start);
+
+  // Generate the body.
+  gen_function_definition(d.definition());
+  if (!build.GetInsertBlock()->getTerminator())
+    build.CreateBr(exit);
+
+  // The coroutine is finished.
+  fn->getBasicBlockList().push_back(exit);
+  seal_block(exit);
+  build.SetInsertPoint(exit);
+  build.CreateStore(build.getInt32(-1), build.CreateStructGEP(frame, 0));
+  build.CreateRet(build.getFalse());
+
+  // Reset stateful info.
+  fn = nullptr;
+  frame = nullptr;
+  resume = nullptr;
+  suspends = 0;
+  trap = nullptr;
+  hoisted.clear();
+  clear_registers();
 }
 
 
@@ -1303,11 +2351,69 @@ Generator::gen_vref(Record_decl const* r, llvm::Value* obj)
 
 #endif
 
+// -------------------------------------------------------------------------- //
+// Optimization
+
+// Run the standard optimization pipeline for the optimization level
+// over the module. This is the same pipeline used by clang: the
+// per-function passes (including mem2reg, which promotes the allocas
+// created for parameters and locals) followed by the module passes
+// (inlining, instcombine, GVN, and loop passes).
+//
+// The module is first targeted to the host. Both pass managers start
+// with the module's data layout and the target's analyses, so that
+// passes see the real sizes of types and the target's costs.
+//
+// When pass timing is enabled, a report of the time spent in each pass
+// is written to stderr.
+void
+Generator::optimize()
+{
+  if (opt == 0)
+    return;
+
+  if (time_passes)
+    llvm::TimePassesIsEnabled = true;
+
+  std::unique_ptr<llvm::TargetMachine> tm = make_target_machine(*mod, opt);
+
+  llvm::PassManagerBuilder pmb;
+  pmb.OptLevel = opt;
+  pmb.SizeLevel = 0;
+  if (opt > 1)
+    pmb.Inliner = llvm::createFunctionInliningPass(opt, 0);
+  else
+    pmb.Inliner = llvm::createAlwaysInlinerPass();
+  pmb.LoopVectorize = opt > 2;
+  pmb.SLPVectorize = opt > 2;
+
+  llvm::legacy::FunctionPassManager fpm(mod);
+  fpm.add(new llvm::DataLayoutPass());
+  tm->addAnalysisPasses(fpm);
+  pmb.populateFunctionPassManager(fpm);
+  fpm.doInitialization();
+  for (llvm::Function& f : *mod)
+    fpm.run(f);
+  fpm.doFinalization();
+
+  llvm::legacy::PassManager mpm;
+  mpm.add(new llvm::DataLayoutPass());
+  tm->addAnalysisPasses(mpm);
+  pmb.populateModulePassManager(mpm);
+  mpm.run(*mod);
+
+  if (time_passes)
+    llvm::TimerGroup::printAll(llvm::errs());
+}
+
+
+// Generate and optimize a module for the translation unit.
 llvm::Module*
 Generator::operator()(Stmt const& s)
 {
   assert(is<Translation_stmt>(s));
   gen(s);
+  optimize();
   return mod;
 }
 
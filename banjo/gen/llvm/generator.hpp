@@ -9,12 +9,18 @@
 #include <banjo/language.hpp>
 #include <banjo/ast.hpp>
 
+#include "bounds.hpp"
+#include "coroutine.hpp"
+
 #include <lingo/environment.hpp>
 
 #include <llvm/IR/LLVMContext.h>
 #include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/ValueHandle.h>
 
 #include <stack>
+#include <unordered_map>
+#include <unordered_set>
 
 
 namespace banjo
@@ -46,22 +52,50 @@ using Symbol_stack = Stack<Symbol_env>;
 using Type_env = Environment<Decl const*, llvm::Type*>;
 
 
+// Maps banjo types to their corresponding LLVM types. Equivalent types
+// share a single entry.
+using Type_map = std::unordered_map<Type const*, llvm::Type*, Type_hash, Type_eq>;
+
+
+// A set of declarations.
+using Decl_set = std::unordered_set<Decl const*>;
+
+
+// The definitions of a variable held in an SSA register, in each
+// block where it is defined or read. Value handles follow phis that
+// are replaced during construction.
+using Definition_map = std::unordered_map<llvm::BasicBlock*, llvm::WeakVH>;
+using Definition_table = std::unordered_map<Decl const*, Definition_map>;
+using Block_set = std::unordered_set<llvm::BasicBlock*>;
+
+
+// A phi whose operands are added when its block is sealed.
+using Incomplete_phi = std::pair<Decl const*, llvm::PHINode*>;
+using Incomplete_phi_seq = std::vector<Incomplete_phi>;
+using Incomplete_phi_map = std::unordered_map<llvm::BasicBlock*, Incomplete_phi_seq>;
+
+
 struct Generator
 {
   Generator();
 
   llvm::Module* operator()(Stmt const&);
 
+  void optimize();
+
   String get_name(Decl const&);
 
   llvm::Type* get_type(Type const&);
+  llvm::Type* lower_type(Type const&);
   llvm::Type* get_type(Void_type const&);
   llvm::Type* get_type(Boolean_type const&);
+  llvm::Type* get_type(Byte_type const&);
   llvm::Type* get_type(Integer_type const&);
   llvm::Type* get_type(Float_type const&);
   llvm::Type* get_type(Function_type const&);
   llvm::Type* get_type(Tuple_type const&);
   llvm::Type* get_type(Array_type const&);
+  llvm::Type* get_type(Slice_type const&);
   llvm::Type* get_type(Dynarray_type const&);
   llvm::Type* get_type(Auto_type const&);
 
@@ -69,6 +103,8 @@ struct Generator
   llvm::Value* gen(Boolean_expr const&);
   llvm::Value* gen(Integer_expr const&);
   llvm::Value* gen(Real_expr const&);
+  llvm::Value* gen(Object_expr const&);
+  llvm::Value* gen(Function_expr const&);
   llvm::Value* gen(Add_expr const&);
   llvm::Value* gen(Sub_expr const&);
   llvm::Value* gen(Mul_expr const&);
@@ -76,6 +112,12 @@ struct Generator
   llvm::Value* gen(Rem_expr const&);
   llvm::Value* gen(Neg_expr const&);
   llvm::Value* gen(Pos_expr const&);
+  llvm::Value* gen(Bit_and_expr const&);
+  llvm::Value* gen(Bit_or_expr const&);
+  llvm::Value* gen(Bit_xor_expr const&);
+  llvm::Value* gen(Bit_lsh_expr const&);
+  llvm::Value* gen(Bit_rsh_expr const&);
+  llvm::Value* gen(Bit_not_expr const&);
   llvm::Value* gen(Eq_expr const&);
   llvm::Value* gen(Ne_expr const&);
   llvm::Value* gen(Lt_expr const&);
@@ -86,7 +128,31 @@ struct Generator
   llvm::Value* gen(And_expr const&);
   llvm::Value* gen(Or_expr const&);
   llvm::Value* gen(Not_expr const&);
+  llvm::Value* gen(Assign_expr const&);
   llvm::Value* gen(Call_expr const&);
+  llvm::Value* gen(Index_expr const&);
+  llvm::Value* gen(Value_conv const&);
+  llvm::Value* gen(Boolean_conv const&);
+  llvm::Value* gen(Slice_conv const&);
+  llvm::Value* gen_address(Expr const&);
+  llvm::Value* gen_address(Index_expr const&);
+
+  // Bounds checking
+  void gen_bounds_check(Index_expr const&, llvm::Value*, llvm::Value*);
+  void gen_check(llvm::Value*, char const*);
+  llvm::BasicBlock* trap_block();
+
+  // SSA construction
+  void find_registers(Function_decl const&);
+  void clear_registers();
+  bool is_register(Decl const&) const;
+  void write_variable(Decl const&, llvm::BasicBlock*, llvm::Value*);
+  llvm::Value* read_variable(Decl const&, llvm::BasicBlock*);
+  llvm::Value* read_variable_recursive(Decl const&, llvm::BasicBlock*);
+  llvm::PHINode* make_phi(Decl const&, llvm::BasicBlock*);
+  llvm::Value* add_phi_operands(Decl const&, llvm::PHINode*);
+  llvm::Value* remove_trivial_phi(llvm::PHINode*);
+  void seal_block(llvm::BasicBlock*);
 
   void gen(Stmt const&);
   void gen(Empty_stmt const&);
@@ -101,15 +167,21 @@ struct Generator
   void gen(Continue_stmt const&);
   void gen(Expression_stmt const&);
   void gen(Declaration_stmt const&);
+  void gen(Yield_stmt const&);
   void gen(Stmt_list const&);
 
 
   void gen(Decl const&);
   void gen(Variable_decl const&);
   void gen_local_variable(Variable_decl const&);
+  void gen_dynarray(llvm::Value*, Dynarray_type const&);
+  void check_dynarray_init(Variable_decl const&);
+  llvm::Value* gen_extent(Dynarray_type const&);
+  llvm::Value* gen_malloc(llvm::Value*);
   void gen_global_variable(Variable_decl const&);
   void gen_local_init(llvm::Value*, Def const&);
-  void gen_global_init(llvm::Value*, Def const&);
+  void gen_global_init(Translation_stmt const&);
+  void gen_global_dynarray(llvm::Value*, Dynarray_type const&);
   void gen_init(llvm::Value*, Empty_def const&);
   void gen_init(llvm::Value*, Expression_def const&);
 
@@ -120,9 +192,20 @@ struct Generator
   void gen(Type_decl const&);
   void gen(Object_parm const&);
 
+  void gen(Coroutine_decl const&);
+  void gen_coroutine_init(llvm::Function*);
+  void gen_coroutine_resume(Coroutine_decl const&, llvm::Function*, Coroutine_frame const&);
+
+  // Runtime support
+  llvm::Function* malloc_function();
+  llvm::Function* free_function();
+
   // Name bindings
   void declare(Decl const&, llvm::Value*);
   llvm::Value* lookup(Decl const&);
+  llvm::Value* lookup_global(Decl const&);
+
+  bool defines(Decl const&) const;
 
   // The context and default IR builder.
   llvm::LLVMContext cxt;
@@ -138,11 +221,38 @@ struct Generator
   llvm::BasicBlock* exit;  // Function exit
   llvm::BasicBlock* top;   // Loop top
   llvm::BasicBlock* bot;   // Loop bottom
+  llvm::BasicBlock* trap;  // Target of failed bounds checks
 
   // Environment.
   int           declcxt; // The current declaration context
   Symbol_stack  stack;   // Local symbol names
   Type_env      types;   // Declared types
+  Type_map      lowered; // Lowered types
+  Decl_set const* owned; // Definitions in this module, or null for all
+
+  // SSA registers for the current function.
+  Decl_set           registers;  // Variables held in registers
+  Definition_table   defs;       // Current definitions
+  Block_set          sealed;     // Blocks whose predecessors are known
+  Incomplete_phi_map incomplete; // Phis in unsealed blocks
+
+  // Information about the current coroutine.
+  llvm::Value*      frame;    // The frame argument, or null in functions
+  llvm::SwitchInst* resume;   // Dispatches to suspension points
+  int               suspends; // Suspension points generated so far
+  Decl_set          hoisted;  // Local variables stored in the frame
+
+  // Heap buffers released on function exit.
+  std::vector<llvm::Value*> cleanups;
+
+  // Bounds checking.
+  Expr_set           safe_indexes; // Subscripts that need no check
+  Bounds_check_stats bounds_stats; // Checks inserted and eliminated
+
+  // Options.
+  int  opt;          // Optimization level (0-3)
+  bool time_passes;  // Report the time spent in each pass
+  bool bounds_check; // Check subscripts against array lengths
 
   struct Enter_context;
   struct Enter_loop;
@@ -151,7 +261,10 @@ struct Generator
 
 inline
 Generator::Generator()
-  : cxt(), build(cxt), mod(nullptr), declcxt(invalid_cxt)
+  : cxt(), build(cxt), mod(nullptr), top(nullptr), bot(nullptr), trap(nullptr)
+  , declcxt(invalid_cxt), owned(nullptr)
+  , frame(nullptr), resume(nullptr), suspends(0)
+  , opt(0), time_passes(false), bounds_check(false)
 { }
 
 
@@ -169,6 +282,33 @@ Generator::lookup(Decl const& d)
 }
 
 
+// Returns the value bound to `d` in the innermost enclosing context
+// that declares it. This finds functions and global variables from
+// within a function.
+inline llvm::Value*
+Generator::lookup_global(Decl const& d)
+{
+  return stack.lookup(&d)->second;
+}
+
+
+// Returns true if `d` is held in an SSA register.
+inline bool
+Generator::is_register(Decl const& d) const
+{
+  return registers.count(&d);
+}
+
+
+// Returns true if the definition of `d` is generated into the current
+// module. Otherwise, only a declaration of `d` is generated.
+inline bool
+Generator::defines(Decl const& d) const
+{
+  return !owned || owned->count(&d);
+}
+
+
 // An RAII class used to manage the registration and
 // removal of name-to-value bindings for code generation.
 struct Generator::Enter_context
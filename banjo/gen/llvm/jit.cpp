@@ -0,0 +1,569 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "jit.hpp"
+
+#include <banjo/ast.hpp>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/IRBuilder.h>
+#include <llvm/IR/LegacyPassManager.h>
+#include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/Module.h>
+#include <llvm/IR/Verifier.h>
+#include <llvm/Support/TargetSelect.h>
+#include <llvm/Transforms/Scalar.h>
+
+#include <memory>
+#include <unordered_map>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+// Bytecode is translated to LLVM IR one function at a time. Each
+// register becomes a stack slot, which is promoted back to an SSA
+// value by the optimizer, and each basic block of bytecode becomes a
+// basic block of IR. The function being compiled and every function
+// it may call are placed in a single module, so calls between them
+// are direct.
+//
+// Native code cannot throw exceptions. Instead, failures are recorded
+// in the status field of the shared Native_state, and every function
+// returns immediately when the status is set. The step count is
+// updated once per basic block, and the call depth once per call.
+//
+// Note that LLVM 3.6 does not provide the ORC APIs, so compiled code
+// is managed by an MCJIT execution engine, one per compiled module.
+
+namespace
+{
+
+// Fields of Native_state.
+enum
+{
+  steps_field,
+  max_steps_field,
+  depth_field,
+  max_depth_field,
+  status_field,
+};
+
+
+// A compiled module. The context must outlive the engine.
+struct Jit_module
+{
+  std::unique_ptr<llvm::LLVMContext>     cxt;
+  std::unique_ptr<llvm::ExecutionEngine> engine;
+};
+
+
+std::vector<Jit_module>&
+jit_modules()
+{
+  static std::vector<Jit_module> mods;
+  return mods;
+}
+
+
+void
+initialize_native_target()
+{
+  static bool init = false;
+  if (!init) {
+    llvm::InitializeNativeTarget();
+    llvm::InitializeNativeTargetAsmPrinter();
+    llvm::InitializeNativeTargetAsmParser();
+    LLVMLinkInMCJIT();
+    init = true;
+  }
+}
+
+
+// Thrown when a function cannot be compiled.
+struct Uncompilable { };
+
+
+// Translates the bytecode of a function and its callees into a
+// module.
+struct Translator
+{
+  using Function_map = std::unordered_map<Bytecode const*, llvm::Function*>;
+
+  Translator(llvm::LLVMContext& c, llvm::Module& m)
+    : cxt(c), mod(m), build(c)
+  {
+    llvm::Type* i64 = build.getInt64Ty();
+    state = llvm::StructType::create(cxt, {i64, i64, i64, i64, i64}, "state");
+  }
+
+  llvm::Function* declare(Bytecode const&);
+  void define(Bytecode const&, llvm::Function*);
+  llvm::Function* entry(Bytecode const&);
+
+  // Helpers
+  llvm::Value* field(int);
+  void fail(Native_status);
+
+  llvm::LLVMContext& cxt;
+  llvm::Module&      mod;
+  llvm::IRBuilder<>  build;
+  llvm::StructType*  state;
+  Function_map       fns;
+  std::vector<Bytecode const*> work;
+
+  // Information about the current function
+  llvm::Value*      st;   // The state argument
+  llvm::BasicBlock* bail; // Returns after a failure
+};
+
+
+// Returns the IR function for `code`, declaring it if needed, and
+// schedules it for definition.
+llvm::Function*
+Translator::declare(Bytecode const& code)
+{
+  auto iter = fns.find(&code);
+  if (iter != fns.end())
+    return iter->second;
+
+  llvm::Type* i64 = build.getInt64Ty();
+  std::vector<llvm::Type*> parms(code.parms + 1, i64);
+  parms[0] = state->getPointerTo();
+  llvm::FunctionType* type = llvm::FunctionType::get(i64, parms, false);
+  llvm::Function* fn = llvm::Function::Create(
+    type,
+    llvm::Function::InternalLinkage,
+    "fn" + std::to_string(fns.size()),
+    &mod);
+  fns.emplace(&code, fn);
+  work.push_back(&code);
+  return fn;
+}
+
+
+llvm::Value*
+Translator::field(int n)
+{
+  return build.CreateStructGEP(st, n);
+}
+
+
+// Record a failure and return.
+void
+Translator::fail(Native_status s)
+{
+  build.CreateStore(build.getInt64(s), field(status_field));
+  build.CreateBr(bail);
+}
+
+
+// Translate the bytecode of a function.
+void
+Translator::define(Bytecode const& code, llvm::Function* fn)
+{
+  Instruction_seq const& ins = code.code;
+  llvm::Type* i64 = build.getInt64Ty();
+
+  // Find the leaders of basic blocks: the first instruction, the
+  // targets of jumps, and the instructions following jumps, calls,
+  // returns and traps. Calls end a block so that the status can be
+  // checked after the call.
+  std::vector<llvm::BasicBlock*> blocks(ins.size() + 1, nullptr);
+  llvm::BasicBlock* entry = llvm::BasicBlock::Create(cxt, "entry", fn);
+  auto lead = [&](std::size_t n) {
+    if (n < ins.size() && !blocks[n])
+      blocks[n] = llvm::BasicBlock::Create(cxt, "", fn);
+  };
+  lead(0);
+  for (std::size_t n = 0; n < ins.size(); ++n) {
+    Instruction const& i = ins[n];
+    switch (i.op) {
+      case jmp_insn:
+        lead(i.a);
+        lead(n + 1);
+        break;
+      case jf_insn:
+      case jt_insn:
+        lead(i.b);
+        lead(n + 1);
+        break;
+      case call_insn:
+      case ret_insn:
+      case trap_insn:
+        lead(n + 1);
+        break;
+      default:
+        break;
+    }
+  }
+  bail = llvm::BasicBlock::Create(cxt, "bail", fn);
+
+  // Allocate registers and check the call depth.
+  build.SetInsertPoint(entry);
+  auto ai = fn->arg_begin();
+  st = &*ai++;
+  std::vector<llvm::Value*> r(code.regs);
+  for (int n = 0; n < code.regs; ++n)
+    r[n] = build.CreateAlloca(i64);
+  for (int n = 0; n < code.parms; ++n)
+    build.CreateStore(&*ai++, r[n]);
+  {
+    llvm::Value* depth = build.CreateLoad(field(depth_field));
+    llvm::Value* max = build.CreateLoad(field(max_depth_field));
+    llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "", fn);
+    llvm::BasicBlock* deep = llvm::BasicBlock::Create(cxt, "", fn);
+    build.CreateCondBr(build.CreateICmpUGE(depth, max), deep, ok);
+    build.SetInsertPoint(deep);
+    build.CreateStore(build.getInt64(native_depth), field(status_field));
+    build.CreateRet(build.getInt64(0));
+    build.SetInsertPoint(ok);
+    build.CreateStore(build.CreateAdd(depth, build.getInt64(1)), field(depth_field));
+    build.CreateBr(blocks[0]);
+  }
+
+  // The bail block leaves the call.
+  auto leave = [&]() {
+    llvm::Value* depth = build.CreateLoad(field(depth_field));
+    build.CreateStore(build.CreateSub(depth, build.getInt64(1)), field(depth_field));
+  };
+  build.SetInsertPoint(bail);
+  leave();
+  build.CreateRet(build.getInt64(0));
+
+  auto load = [&](int n) { return build.CreateLoad(r[n]); };
+  auto store = [&](int n, llvm::Value* v) { build.CreateStore(v, r[n]); };
+  auto flag = [&](llvm::Value* v) { return build.CreateZExt(v, i64); };
+
+  // Charge the steps of a block on entry to it.
+  auto charge = [&](std::size_t n) {
+    std::size_t len = 1;
+    while (n + len < ins.size() && !blocks[n + len])
+      ++len;
+    llvm::Value* steps = build.CreateAdd(build.CreateLoad(field(steps_field)), build.getInt64(len));
+    build.CreateStore(steps, field(steps_field));
+    llvm::Value* max = build.CreateLoad(field(max_steps_field));
+    llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "", fn);
+    llvm::BasicBlock* over = llvm::BasicBlock::Create(cxt, "", fn);
+    build.CreateCondBr(build.CreateICmpUGT(steps, max), over, ok);
+    build.SetInsertPoint(over);
+    fail(native_steps);
+    build.SetInsertPoint(ok);
+  };
+
+  // Check the divisor of a division.
+  auto divisor = [&](int n) {
+    llvm::Value* d = load(n);
+    llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "", fn);
+    llvm::BasicBlock* zero = llvm::BasicBlock::Create(cxt, "", fn);
+    build.CreateCondBr(build.CreateICmpEQ(d, build.getInt64(0)), zero, ok);
+    build.SetInsertPoint(zero);
+    fail(native_division);
+    build.SetInsertPoint(ok);
+    return d;
+  };
+
+  // Check that a signed division of operands of precision `w` does
+  // not divide the least value by -1, whose quotient overflows.
+  auto dividend = [&](int n, llvm::Value* d, int w) {
+    llvm::Value* x = load(n);
+    llvm::Value* min = build.getInt64(extend(std::uint64_t(1) << (w - 1), w, true));
+    llvm::Value* over = build.CreateAnd(
+      build.CreateICmpEQ(d, build.getInt64(-1)),
+      build.CreateICmpEQ(x, min));
+    llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "", fn);
+    llvm::BasicBlock* out = llvm::BasicBlock::Create(cxt, "", fn);
+    build.CreateCondBr(over, out, ok);
+    build.SetInsertPoint(out);
+    fail(native_overflow);
+    build.SetInsertPoint(ok);
+    return x;
+  };
+
+  // Check the amount of a shift of a value of precision `w`.
+  auto amount = [&](int n, int w) {
+    llvm::Value* s = load(n);
+    llvm::BasicBlock* ok = llvm::BasicBlock::Create(cxt, "", fn);
+    llvm::BasicBlock* out = llvm::BasicBlock::Create(cxt, "", fn);
+    build.CreateCondBr(build.CreateICmpUGE(s, build.getInt64(w)), out, ok);
+    build.SetInsertPoint(out);
+    fail(native_shift);
+    build.SetInsertPoint(ok);
+    return s;
+  };
+
+  // Truncate to `w` bits.
+  auto narrow = [&](int n, int w) {
+    return build.CreateTrunc(load(n), build.getIntNTy(w));
+  };
+
+  for (std::size_t n = 0; n < ins.size(); ++n) {
+    // Start a new block, falling through from the previous one.
+    if (blocks[n]) {
+      if (n != 0 && !build.GetInsertBlock()->getTerminator())
+        build.CreateBr(blocks[n]);
+      build.SetInsertPoint(blocks[n]);
+      charge(n);
+    }
+
+    Instruction const& i = ins[n];
+    switch (i.op) {
+      case ldk_insn:
+        store(i.a, build.getInt64(code.consts[i.b]));
+        break;
+      case mov_insn:
+        store(i.a, load(i.b));
+        break;
+      case sext_insn:
+        store(i.a, build.CreateSExt(narrow(i.b, i.c), i64));
+        break;
+      case zext_insn:
+        store(i.a, build.CreateZExt(narrow(i.b, i.c), i64));
+        break;
+      case add_insn:
+        store(i.a, build.CreateAdd(load(i.b), load(i.c)));
+        break;
+      case sub_insn:
+        store(i.a, build.CreateSub(load(i.b), load(i.c)));
+        break;
+      case mul_insn:
+        store(i.a, build.CreateMul(load(i.b), load(i.c)));
+        break;
+      case div_insn: {
+        llvm::Value* d = divisor(i.c);
+        store(i.a, build.CreateSDiv(dividend(i.b, d, i.w), d));
+        break;
+      }
+      case udiv_insn: {
+        llvm::Value* d = divisor(i.c);
+        store(i.a, build.CreateUDiv(load(i.b), d));
+        break;
+      }
+      case rem_insn: {
+        llvm::Value* d = divisor(i.c);
+        store(i.a, build.CreateSRem(dividend(i.b, d, i.w), d));
+        break;
+      }
+      case urem_insn: {
+        llvm::Value* d = divisor(i.c);
+        store(i.a, build.CreateURem(load(i.b), d));
+        break;
+      }
+      case neg_insn:
+        store(i.a, build.CreateNeg(load(i.b)));
+        break;
+      case and_insn:
+        store(i.a, build.CreateAnd(load(i.b), load(i.c)));
+        break;
+      case or_insn:
+        store(i.a, build.CreateOr(load(i.b), load(i.c)));
+        break;
+      case xor_insn:
+        store(i.a, build.CreateXor(load(i.b), load(i.c)));
+        break;
+      case lsh_insn: {
+        llvm::Value* s = amount(i.c, i.w);
+        store(i.a, build.CreateShl(load(i.b), s));
+        break;
+      }
+      case rsh_insn: {
+        llvm::Value* s = amount(i.c, i.w);
+        store(i.a, build.CreateAShr(load(i.b), s));
+        break;
+      }
+      case ursh_insn: {
+        llvm::Value* s = amount(i.c, i.w);
+        store(i.a, build.CreateLShr(load(i.b), s));
+        break;
+      }
+      case compl_insn:
+        store(i.a, build.CreateNot(load(i.b)));
+        break;
+      case not_insn:
+        store(i.a, flag(build.CreateICmpEQ(load(i.b), build.getInt64(0))));
+        break;
+      case bool_insn:
+        store(i.a, flag(build.CreateICmpNE(load(i.b), build.getInt64(0))));
+        break;
+      case eq_insn:
+        store(i.a, flag(build.CreateICmpEQ(load(i.b), load(i.c))));
+        break;
+      case ne_insn:
+        store(i.a, flag(build.CreateICmpNE(load(i.b), load(i.c))));
+        break;
+      case lt_insn:
+        store(i.a, flag(build.CreateICmpSLT(load(i.b), load(i.c))));
+        break;
+      case ult_insn:
+        store(i.a, flag(build.CreateICmpULT(load(i.b), load(i.c))));
+        break;
+      case gt_insn:
+        store(i.a, flag(build.CreateICmpSGT(load(i.b), load(i.c))));
+        break;
+      case ugt_insn:
+        store(i.a, flag(build.CreateICmpUGT(load(i.b), load(i.c))));
+        break;
+      case le_insn:
+        store(i.a, flag(build.CreateICmpSLE(load(i.b), load(i.c))));
+        break;
+      case ule_insn:
+        store(i.a, flag(build.CreateICmpULE(load(i.b), load(i.c))));
+        break;
+      case ge_insn:
+        store(i.a, flag(build.CreateICmpSGE(load(i.b), load(i.c))));
+        break;
+      case uge_insn:
+        store(i.a, flag(build.CreateICmpUGE(load(i.b), load(i.c))));
+        break;
+      case cmp_insn: {
+        llvm::Value* x = load(i.b);
+        llvm::Value* y = load(i.c);
+        llvm::Value* gt = flag(build.CreateICmpSGT(x, y));
+        llvm::Value* lt = flag(build.CreateICmpSLT(x, y));
+        store(i.a, build.CreateSub(gt, lt));
+        break;
+      }
+      case ucmp_insn: {
+        llvm::Value* x = load(i.b);
+        llvm::Value* y = load(i.c);
+        llvm::Value* gt = flag(build.CreateICmpUGT(x, y));
+        llvm::Value* lt = flag(build.CreateICmpULT(x, y));
+        store(i.a, build.CreateSub(gt, lt));
+        break;
+      }
+      case jmp_insn:
+        build.CreateBr(blocks[i.a]);
+        break;
+      case jf_insn:
+        build.CreateCondBr(build.CreateICmpEQ(load(i.a), build.getInt64(0)), blocks[i.b], blocks[n + 1]);
+        break;
+      case jt_insn:
+        build.CreateCondBr(build.CreateICmpNE(load(i.a), build.getInt64(0)), blocks[i.b], blocks[n + 1]);
+        break;
+      case call_insn: {
+        Bytecode const* callee = code.links[i.b];
+        if (!callee)
+          callee = code.links[i.b] = lower(*code.callees[i.b]);
+        if (!callee)
+          throw Uncompilable();
+        std::vector<llvm::Value*> args {st};
+        for (int k = 0; k < callee->parms; ++k)
+          args.push_back(load(i.c + k));
+        store(i.a, build.CreateCall(declare(*callee), args));
+
+        // Return if the callee failed.
+        llvm::Value* status = build.CreateLoad(field(status_field));
+        build.CreateCondBr(build.CreateICmpNE(status, build.getInt64(native_ok)), bail, blocks[n + 1]);
+        break;
+      }
+      case ret_insn: {
+        llvm::Value* v = load(i.a);
+        leave();
+        build.CreateRet(v);
+        break;
+      }
+      case trap_insn:
+        fail(native_trap);
+        break;
+      case yield_insn:
+      case fin_insn:
+        // Coroutines are not compiled.
+        throw Uncompilable();
+    }
+  }
+}
+
+
+// Define the entry point for a call to `code`. This unpacks the
+// arguments from an array.
+llvm::Function*
+Translator::entry(Bytecode const& code)
+{
+  llvm::Type* i64 = build.getInt64Ty();
+  llvm::Type* parms[] = {state->getPointerTo(), i64->getPointerTo()};
+  llvm::FunctionType* type = llvm::FunctionType::get(i64, parms, false);
+  llvm::Function* fn = llvm::Function::Create(
+    type,
+    llvm::Function::ExternalLinkage,
+    "entry",
+    &mod);
+
+  build.SetInsertPoint(llvm::BasicBlock::Create(cxt, "entry", fn));
+  auto ai = fn->arg_begin();
+  llvm::Value* st = &*ai++;
+  llvm::Value* argv = &*ai++;
+  std::vector<llvm::Value*> args {st};
+  for (int n = 0; n < code.parms; ++n)
+    args.push_back(build.CreateLoad(build.CreateConstGEP1_32(argv, n)));
+  build.CreateRet(build.CreateCall(declare(code), args));
+  return fn;
+}
+
+
+} // namespace
+
+
+// Compile the function `code` and every function it may call to
+// native code. Returns nullptr if compilation fails, in which case
+// the bytecode continues to be interpreted.
+Native_function
+compile_native(Bytecode const& code)
+{
+  initialize_native_target();
+
+  std::unique_ptr<llvm::LLVMContext> cxt(new llvm::LLVMContext());
+  std::unique_ptr<llvm::Module> mod(new llvm::Module("jit", *cxt));
+
+  // Translate the function and, transitively, its callees.
+  Translator tr(*cxt, *mod);
+  try {
+    tr.entry(code);
+    while (!tr.work.empty()) {
+      Bytecode const* next = tr.work.back();
+      tr.work.pop_back();
+      tr.define(*next, tr.fns[next]);
+    }
+  } catch (Uncompilable&) {
+    return nullptr;
+  }
+  if (llvm::verifyModule(*mod))
+    return nullptr;
+
+  // Promote registers to SSA values and simplify.
+  llvm::legacy::FunctionPassManager fpm(mod.get());
+  fpm.add(llvm::createPromoteMemoryToRegisterPass());
+  fpm.add(llvm::createInstructionCombiningPass());
+  fpm.add(llvm::createCFGSimplificationPass());
+  fpm.doInitialization();
+  for (llvm::Function& f : *mod)
+    fpm.run(f);
+  fpm.doFinalization();
+
+  std::string err;
+  std::unique_ptr<llvm::ExecutionEngine> engine(
+    llvm::EngineBuilder(std::move(mod))
+      .setEngineKind(llvm::EngineKind::JIT)
+      .setErrorStr(&err)
+      .setMCJITMemoryManager(
+        std::unique_ptr<llvm::RTDyldMemoryManager>(new llvm::SectionMemoryManager()))
+      .create());
+  if (!engine)
+    return nullptr;
+  engine->finalizeObject();
+  std::uint64_t addr = engine->getFunctionAddress("entry");
+  if (!addr)
+    return nullptr;
+
+  jit_modules().push_back({std::move(cxt), std::move(engine)});
+  return reinterpret_cast<Native_function>(addr);
+}
+
+
+} // namespace ll
+
+} // namespace banjo
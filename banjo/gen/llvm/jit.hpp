@@ -0,0 +1,26 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_JIT_HPP
+#define BANJO_JIT_HPP
+
+// Just-in-time compilation of bytecode to native code using LLVM.
+
+#include <banjo/vm.hpp>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+Native_function compile_native(Bytecode const&);
+
+
+} // namespace ll
+
+} // namespace banjo
+
+
+#endif
@@ -0,0 +1,164 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "parallel.hpp"
+#include "generator.hpp"
+
+#include <llvm/IR/Module.h>
+#include <llvm/Support/Timer.h>
+#include <llvm/Support/raw_ostream.h>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <thread>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+namespace
+{
+
+// Partition the top-level declarations of the translation unit `s`
+// into `n` sets. Functions are assigned to partitions in round-robin
+// order. All other declarations belong to the first partition.
+// Declarations that are not in `owned` belong to no partition.
+//
+// TODO: Balance partitions by the size of function bodies.
+std::vector<Decl_set>
+partition(Translation_stmt const& s, int n, Decl_set const* owned)
+{
+  std::vector<Decl_set> parts(n);
+  int next = 0;
+  for (Stmt const& s1 : s.statements()) {
+    Declaration_stmt const* ds = as<Declaration_stmt>(&s1);
+    if (!ds)
+      continue;
+    Decl const& d = ds->declaration();
+    if (owned && !owned->count(&d))
+      continue;
+    if (is<Function_decl>(d)) {
+      parts[next].insert(&d);
+      next = (next + 1) % n;
+    } else {
+      parts[0].insert(&d);
+    }
+  }
+  return parts;
+}
+
+
+// Returns the number of function definitions in `s`.
+int
+count_functions(Translation_stmt const& s)
+{
+  int n = 0;
+  for (Stmt const& s1 : s.statements())
+    if (Declaration_stmt const* ds = as<Declaration_stmt>(&s1))
+      n += is<Function_decl>(ds->declaration());
+  return n;
+}
+
+} // namespace
+
+
+// Returns the output path of the nth partition. The partition number
+// is inserted before the extension of `path`, so that "a.o" becomes
+// "a.1.o". The standard output is shared by all partitions.
+String
+get_partition_path(String const& path, int n)
+{
+  if (path == "-")
+    return path;
+  String num = "." + std::to_string(n);
+  std::size_t base = path.rfind('/');
+  std::size_t dot = path.rfind('.');
+  if (dot == String::npos || (base != String::npos && dot < base))
+    return path + num;
+  return path.substr(0, dot) + num + path.substr(dot);
+}
+
+
+// Generate, optimize, and emit the partitions of the translation unit
+// `s` in parallel.
+//
+// Each partition is written to its own file. When the output is the
+// standard output, the partitions are generated in parallel and then
+// written in order. Only textual output can be written that way, since
+// a sequence of objects or bitcode files is not a valid file. Returns
+// the bounds checks counted over all partitions.
+Bounds_check_stats
+generate_partitions(Stmt const& s, Partition_options const& opts)
+{
+  bool shared = opts.path == "-";
+  if (shared && (opts.kind == bc_output || opts.kind == obj_output))
+    throw Translation_error("partitioned binary output cannot be written to the standard output");
+
+  Translation_stmt const& tu = cast<Translation_stmt>(s);
+  int n = std::max(1, std::min(opts.jobs, count_functions(tu)));
+  std::vector<Decl_set> parts = partition(tu, n, opts.owned);
+  std::vector<std::unique_ptr<Generator>> gens(n);
+  std::vector<std::exception_ptr> excepts(n);
+
+  // Pass timers are global. Enable them once for all threads, and
+  // report them after all threads have finished.
+  llvm::TimePassesIsEnabled = opts.time_passes;
+
+  // Register targets before any worker creates a target machine.
+  initialize_targets();
+
+  std::atomic<int> next(0);
+  auto work = [&]() {
+    int i;
+    while ((i = next++) < n) {
+      try {
+        gens[i].reset(new Generator());
+        Generator& gen = *gens[i];
+        gen.owned = &parts[i];
+        gen.opt = opts.opt;
+        gen.bounds_check = opts.bounds_check;
+        llvm::Module* mod = gen(tu);
+        mod->setModuleIdentifier(get_partition_path("a.ll", i));
+        if (!shared)
+          emit(*mod, opts.kind, get_partition_path(opts.path, i), opts.opt);
+      } catch (...) {
+        excepts[i] = std::current_exception();
+      }
+    }
+  };
+
+  // The calling thread is also a worker.
+  std::vector<std::thread> pool;
+  for (int i = 1; i < n; ++i)
+    pool.emplace_back(work);
+  work();
+  for (std::thread& t : pool)
+    t.join();
+
+  for (int i = 0; i < n; ++i)
+    if (excepts[i])
+      std::rethrow_exception(excepts[i]);
+
+  if (shared) {
+    for (int i = 0; i < n; ++i)
+      emit(*gens[i]->mod, opts.kind, opts.path, opts.opt);
+  }
+
+  if (opts.time_passes)
+    llvm::TimerGroup::printAll(llvm::errs());
+
+  Bounds_check_stats stats;
+  for (int i = 0; i < n; ++i)
+    stats += gens[i]->bounds_stats;
+  return stats;
+}
+
+
+} // namespace ll
+
+} // namespace banjo
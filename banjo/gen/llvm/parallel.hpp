@@ -0,0 +1,52 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_PARALLEL_HPP
+#define BANJO_PARALLEL_HPP
+
+// Parallel code generation.
+//
+// The functions of a translation unit are partitioned across a number
+// of modules, each of which is generated, optimized, and emitted by its
+// own thread with its own LLVM context. A module contains definitions
+// of only the functions in its partition; every other function is
+// declared, so references across partitions are resolved by the linker.
+// Global variables are defined in the first partition.
+
+#include <banjo/gen/llvm/emitter.hpp>
+#include <banjo/gen/llvm/bounds.hpp>
+#include <banjo/gen/llvm/generator.hpp>
+
+#include <banjo/ast.hpp>
+
+
+namespace banjo
+{
+
+namespace ll
+{
+
+// Configures the generation of partitioned modules.
+struct Partition_options
+{
+  int             jobs;         // The number of partitions
+  int             opt;          // Optimization level (0-3)
+  bool            time_passes;  // Report the time spent in each pass
+  bool            bounds_check; // Check subscripts against array lengths
+  Output_kind     kind;         // The kind of output to emit
+  String          path;         // The output path
+  Decl_set const* owned;        // Definitions to generate, or null for all
+};
+
+
+String get_partition_path(String const&, int);
+
+Bounds_check_stats generate_partitions(Stmt const&, Partition_options const&);
+
+
+} // namespace ll
+
+} // namespace banjo
+
+
+#endif
@@ -0,0 +1,296 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "incremental.hpp"
+#include "cache.hpp"
+#include "memo.hpp"
+#include "parser.hpp"
+#include "vm.hpp"
+
+#include <algorithm>
+#include <memory>
+
+
+namespace banjo
+{
+
+namespace
+{
+
+// Returns the number of tokens in the unparsed definition of `d`. The
+// definitions of other kinds of declarations (e.g., classes) are part
+// of their signatures.
+std::size_t
+body_size(Decl& d)
+{
+  struct fn
+  {
+    std::size_t operator()(Def& d) { return 0; }
+
+    std::size_t operator()(Expression_def& d)
+    {
+      if (Unparsed_expr* e = as<Unparsed_expr>(&d.expression()))
+        return e->tokens().size();
+      return 0;
+    }
+
+    std::size_t operator()(Function_def& d)
+    {
+      if (Unparsed_stmt* s = as<Unparsed_stmt>(&d.statement()))
+        return s->tokens().size();
+      return 0;
+    }
+  };
+  if (Variable_decl* var = as<Variable_decl>(&d))
+    return apply(var->initializer(), fn{});
+  if (Function_decl* f = as<Function_decl>(&d))
+    return apply(f->definition(), fn{});
+  if (Coroutine_decl* co = as<Coroutine_decl>(&d))
+    return apply(co->definition(), fn{});
+  return 0;
+}
+
+
+// Replace the definition of the elaborated declaration `d` with the
+// unparsed definition of `src`, a newer parse of the same declaration.
+void
+replace_definition(Decl& d, Decl& src)
+{
+  if (Variable_decl* var = as<Variable_decl>(&d))
+    var->def_ = &cast<Variable_decl>(src).initializer();
+  else if (Function_decl* f = as<Function_decl>(&d))
+    f->def_ = &cast<Function_decl>(src).definition();
+  else if (Coroutine_decl* co = as<Coroutine_decl>(&d))
+    co->def_ = &cast<Coroutine_decl>(src).definition();
+  else
+    banjo_unhandled_case(d);
+}
+
+
+// Returns the symbol naming `d`, or null if it is not named by an
+// identifier.
+Symbol const*
+declared_symbol(Decl const& d)
+{
+  if (Simple_id const* id = as<Simple_id>(&d.name()))
+    return &id->symbol();
+  return nullptr;
+}
+
+
+// Add the identifiers in the range [first, last) of `toks` to `syms`,
+// except for `self`.
+void
+collect_names(Token_buffer const& toks, std::size_t first, std::size_t last,
+              Symbol const* self, Incremental_decl::Symbol_seq& syms)
+{
+  for (std::size_t i = first; i < last; ++i) {
+    if (toks.kind(i) == identifier_tok && toks.symbol(i) != self)
+      syms.push_back(toks.symbol(i));
+  }
+}
+
+
+void
+sort_names(Incremental_decl::Symbol_seq& syms)
+{
+  std::sort(syms.begin(), syms.end());
+  syms.erase(std::unique(syms.begin(), syms.end()), syms.end());
+}
+
+
+bool
+mentions(Incremental_decl::Symbol_seq const& syms, Symbol const* sym)
+{
+  return std::binary_search(syms.begin(), syms.end(), sym);
+}
+
+
+// Returns the fingerprint of the statement `s`, whose tokens are the
+// range [first, last) of `toks`. The definition of a declaration is
+// the last of its tokens, except for a terminating semicolon. A
+// statement that is not a declaration has no fingerprint.
+Incremental_decl
+fingerprint(Stmt& s, Token_buffer const& toks, std::size_t first, std::size_t last)
+{
+  Incremental_decl fp {nullptr, {}, {}, {}, {}};
+  Declaration_stmt* ds = as<Declaration_stmt>(&s);
+  if (!ds)
+    return fp;
+  Decl& d = ds->declaration();
+
+  std::size_t end = last;
+  if (end > first && toks.kind(end - 1) == semicolon_tok)
+    --end;
+  std::size_t n = body_size(d);
+  lingo_assert(n <= end - first);
+  std::size_t begin = end - n;
+
+  Content_hash sig;
+  hash_tokens(sig, toks, first, begin);
+  hash_tokens(sig, toks, end, last);
+  Content_hash body;
+  hash_tokens(body, toks, begin, end);
+
+  // The name of a declaration appears in its own signature, and is
+  // not a dependency of it.
+  Symbol const* self = declared_symbol(d);
+  collect_names(toks, first, begin, self, fp.sig_names);
+  collect_names(toks, end, last, self, fp.sig_names);
+  collect_names(toks, begin, end, nullptr, fp.body_names);
+  sort_names(fp.sig_names);
+  sort_names(fp.body_names);
+
+  fp.decl = &d;
+  fp.signature = sig;
+  fp.body = body;
+  return fp;
+}
+
+
+// Discard the results of evaluation that may depend on definitions
+// that are about to change.
+void
+discard_evaluations()
+{
+  memo_cache().clear();
+  discard_purity();
+  discard_bytecode();
+}
+
+} // namespace
+
+
+Incremental_unit::~Incremental_unit()
+{
+  delete scope;
+}
+
+
+// Discard the elaborated translation unit. The next compilation
+// elaborates every declaration.
+void
+Incremental_unit::reset()
+{
+  delete scope;
+  scope = nullptr;
+  unit = nullptr;
+  decls.clear();
+}
+
+
+// Compile the program in `toks`, returning the elaborated translation
+// unit. This is the unit returned by the previous compilation when its
+// declarations can be reused.
+Stmt&
+Incremental_unit::operator()(Token_buffer const& toks)
+{
+  stats_ = Incremental_stats();
+
+  // Parse the top-level declarations in a new scope, leaving their
+  // types and definitions unparsed.
+  std::unique_ptr<Scope> top(&cxt.make_scope());
+  Parser parse(cxt, toks);
+  Stmt_list ss;
+  Incremental_decl_seq fresh;
+  {
+    Enter_scope s(cxt, *top);
+    while (!parse.is_eof()) {
+      std::size_t first = parse.tokens.position();
+      Stmt& s1 = parse.statement();
+      ss.push_back(s1);
+      fresh.push_back(fingerprint(s1, toks, first, parse.tokens.position()));
+    }
+  }
+
+  // If a definition fails to elaborate, the unit is left in an unknown
+  // state. Start over on the next compilation.
+  try {
+    if (reelaborate(parse, fresh))
+      return *unit;
+  } catch (...) {
+    reset();
+    throw;
+  }
+
+  // Otherwise, elaborate the new declarations.
+  if (unit)
+    discard_evaluations();
+  {
+    Enter_scope s(cxt, *top);
+    parse.on_statement_seq(ss);
+  }
+  Stmt& tu = parse.on_translation_statement(std::move(ss));
+  reset();
+  scope = top.release();
+  unit = &tu;
+  decls = std::move(fresh);
+  stats_.full = true;
+  stats_.elaborated = decls.size();
+  return tu;
+}
+
+
+// Try to update the previous translation unit with the declarations in
+// `fresh`. Returns false if the unit must be elaborated again.
+bool
+Incremental_unit::reelaborate(Parser& parse, Incremental_decl_seq& fresh)
+{
+  if (!unit || fresh.size() != decls.size())
+    return false;
+
+  // Find the definitions that changed.
+  std::size_t n = decls.size();
+  std::vector<bool> changed(n);
+  std::vector<std::size_t> work;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (!fresh[i].decl || fresh[i].signature != decls[i].signature)
+      return false;
+    if (fresh[i].body != decls[i].body) {
+      changed[i] = true;
+      work.push_back(i);
+    }
+  }
+
+  // A definition that names a changed declaration is also changed,
+  // since its elaboration may have evaluated that declaration. If a
+  // signature names one, its type may change, and so may the meaning
+  // of every declaration that uses it.
+  while (!work.empty()) {
+    std::size_t i = work.back();
+    work.pop_back();
+    Symbol const* sym = declared_symbol(*decls[i].decl);
+    if (!sym)
+      return false;
+    for (std::size_t j = 0; j < n; ++j) {
+      if (mentions(fresh[j].sig_names, sym))
+        return false;
+      if (!changed[j] && mentions(fresh[j].body_names, sym)) {
+        changed[j] = true;
+        work.push_back(j);
+      }
+    }
+  }
+
+  // Elaborate the changed definitions in place. References to these
+  // declarations from other definitions remain valid.
+  if (std::find(changed.begin(), changed.end(), true) != changed.end())
+    discard_evaluations();
+  Enter_scope s(cxt, *scope);
+  for (std::size_t i = 0; i < n; ++i) {
+    Decl& d = *decls[i].decl;
+    if (changed[i]) {
+      replace_definition(d, *fresh[i].decl);
+      parse.elaborate_definition(d);
+      ++stats_.elaborated;
+    } else {
+      ++stats_.reused;
+    }
+    fresh[i].decl = &d;
+  }
+  decls = std::move(fresh);
+  return true;
+}
+
+
+} // namespace banjo
@@ -0,0 +1,103 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_INCREMENTAL_HPP
+#define BANJO_INCREMENTAL_HPP
+
+// This module provides incremental elaboration of a translation unit
+// that is compiled repeatedly by a long-running process.
+//
+// Each compilation parses the top-level declarations of the program,
+// leaving their types and definitions unparsed, and fingerprints the
+// tokens of each declaration. The signature of a declaration is its
+// tokens excluding its definition; the body is the tokens of its
+// definition (a function body or variable initializer).
+//
+// When every signature is unchanged from the previous compilation, the
+// elaborated declarations of that compilation are kept. Only the bodies
+// that changed, and the bodies that refer to them by name, are
+// elaborated again, in place. Any other change, including the addition,
+// removal, or reordering of declarations, elaborates the whole
+// translation unit again.
+//
+// Dependencies are found by name: a body depends on every top-level
+// declaration whose name appears among its tokens. This over-approximates
+// the actual dependencies, which is safe.
+//
+// The compiler elaborates incrementally in watch mode (-fwatch), which
+// compiles the program again each time one of its inputs changes.
+
+#include "prelude.hpp"
+#include "ast.hpp"
+#include "cache.hpp"
+
+#include <vector>
+
+
+namespace banjo
+{
+
+struct Context;
+struct Parser;
+struct Scope;
+struct Token_buffer;
+
+
+// Statistics about the most recent incremental compilation.
+struct Incremental_stats
+{
+  bool        full       = false; // True if everything was elaborated
+  std::size_t reused     = 0;     // Declarations kept as they were
+  std::size_t elaborated = 0;     // Definitions elaborated again
+};
+
+
+// The fingerprint of a top-level declaration.
+struct Incremental_decl
+{
+  using Symbol_seq = std::vector<Symbol const*>;
+
+  Decl*        decl;
+  Content_hash signature;  // Hash of the tokens outside the definition
+  Content_hash body;       // Hash of the tokens of the definition
+  Symbol_seq   sig_names;  // Identifiers in the signature
+  Symbol_seq   body_names; // Identifiers in the definition
+};
+
+
+using Incremental_decl_seq = std::vector<Incremental_decl>;
+
+
+// A translation unit that is elaborated incrementally.
+//
+// The elaborated declarations of one compilation are reused by the
+// next, so the token buffers (and the inputs) of every compilation
+// must outlive the unit, since diagnostics refer to their locations.
+struct Incremental_unit
+{
+  Incremental_unit(Context& cxt)
+    : cxt(cxt), scope(nullptr), unit(nullptr)
+  { }
+
+  ~Incremental_unit();
+
+  Stmt& operator()(Token_buffer const&);
+
+  Incremental_stats const& stats() const { return stats_; }
+
+  void reset();
+
+  bool reelaborate(Parser&, Incremental_decl_seq&);
+
+  Context&             cxt;
+  Scope*               scope; // The scope of top-level declarations
+  Stmt*                unit;  // The elaborated translation unit
+  Incremental_decl_seq decls;
+  Incremental_stats    stats_;
+};
+
+
+} // namespace banjo
+
+
+#endif
@@ -22,6 +22,66 @@ Lexer::symbols()
 }
 
 
+// Returns the symbol with the given spelling, or nullptr if there is no
+// such symbol. The shared symbol table is consulted only on a cache miss.
+Symbol const*
+Lexer::lookup(String const& str)
+{
+  auto iter = cache_.find(str);
+  if (iter != cache_.end())
+    return iter->second;
+
+  Symbol const* sym;
+  {
+    std::lock_guard<std::mutex> lock(cxt_.symbols_lock());
+    sym = symbols().get(str);
+  }
+  if (sym)
+    cache_.emplace(str, sym);
+  return sym;
+}
+
+
+// Returns the symbol with the given spelling, creating an identifier
+// if there is no such symbol.
+Symbol const*
+Lexer::lookup_identifier(String const& str)
+{
+  auto iter = cache_.find(str);
+  if (iter != cache_.end())
+    return iter->second;
+
+  Symbol const* sym;
+  {
+    std::lock_guard<std::mutex> lock(cxt_.symbols_lock());
+    sym = symbols().get(str);
+    if (!sym)
+      sym = symbols().put_identifier(identifier_tok, str);
+  }
+  cache_.emplace(str, sym);
+  return sym;
+}
+
+
+// Returns the integer symbol with the given spelling.
+Symbol const*
+Lexer::lookup_integer(String const& str)
+{
+  auto iter = cache_.find(str);
+  if (iter != cache_.end())
+    return iter->second;
+
+  int n = string_to_int<int>(str, 10);
+  Symbol const* sym;
+  {
+    std::lock_guard<std::mutex> lock(cxt_.symbols_lock());
+    sym = symbols().put_integer(integer_tok, str, n);
+  }
+  cache_.emplace(str, sym);
+  return sym;
+}
+
+
 // Copy the current character into the save buffer.
 void
 Lexer::get()
@@ -155,10 +215,25 @@ Lexer::scan()
 }
 
 
+// Diagnose an unrecognized character. If diagnostics are deferred, the
+// message is saved for later.
 void
 Lexer::error()
 {
-  lingo::error(loc_, "unrecognized character '{}'", cs_.get());
+  char c = cs_.get();
+  if (diags_)
+    diags_->push_back({loc_, format("unrecognized character '{}'", c)});
+  else
+    lingo::error(loc_, "unrecognized character '{}'", c);
+}
+
+
+// Emit a sequence of deferred diagnostics.
+void
+emit_diagnostics(Lexer::Diagnostic_seq const& ds)
+{
+  for (Lexer::Diagnostic const& d : ds)
+    lingo::error(d.loc, "{}", d.msg);
 }
 
 
@@ -245,10 +320,11 @@ Lexer::integer()
 }
 
 
+// Punctuators and operators are always in the symbol table.
 Token
 Lexer::on_symbol()
 {
-  Symbol const* sym = symbols().get(buf_.take());
+  Symbol const* sym = lookup(buf_.take());
   return Token(loc_, sym);
 }
 
@@ -258,10 +334,7 @@ Lexer::on_symbol()
 Token
 Lexer::on_word()
 {
-  String str = buf_.take();
-  Symbol const* sym = symbols().get(str);
-  if (!sym)
-    sym = symbols().put_identifier(identifier_tok, str);
+  Symbol const* sym = lookup_identifier(buf_.take());
   return Token(loc_, sym);
 }
 
@@ -269,9 +342,7 @@ Lexer::on_word()
 Token
 Lexer::on_integer()
 {
-  String str = buf_.take();
-  int n = string_to_int<int>(str, 10);
-  Symbol* sym = symbols().put_integer(integer_tok, str, n);
+  Symbol const* sym = lookup_integer(buf_.take());
   return Token(loc_, sym);
 }
 
@@ -5,11 +5,15 @@
 #define BANJO_LEXER_HPP
 
 #include "prelude.hpp"
+#include "token.hpp"
 
 #include <lingo/symbol.hpp>
 #include <lingo/token.hpp>
 #include <lingo/character.hpp>
 
+#include <unordered_map>
+#include <vector>
+
 
 namespace banjo
 {
@@ -21,13 +25,32 @@ struct Context;
 // characters into tokens. This is primarily a callback
 // interface for the lexing function for the language.
 //
-// TODO: Make this take a context instead of just the symbol
-// table? That would allow us to pass configuration information
-// and diagnostics into the lexer.
+// Multiple lexers may run concurrently over different inputs, sharing
+// the symbol table of the context. Each lexer caches the symbols it has
+// seen, so that the shared table (and its lock) is only consulted the
+// first time a spelling occurs in an input.
+//
+// A lexer can defer its diagnostics. Deferred diagnostics are saved in
+// the order they occur, and can be emitted later. This allows inputs
+// lexed in parallel to report errors in input order.
 struct Lexer
 {
-  Lexer(Context& cxt, Character_stream& cs, Token_stream& ts)
-    : cxt_(cxt), cs_(cs), ts_(ts)
+  // A deferred lexical error.
+  struct Diagnostic
+  {
+    Location loc;
+    String   msg;
+  };
+
+  using Diagnostic_seq = std::vector<Diagnostic>;
+  using Symbol_cache = std::unordered_map<String, Symbol const*>;
+
+  Lexer(Context& cxt, Character_stream& cs, Token_buffer& ts)
+    : cxt_(cxt), cs_(cs), ts_(ts), diags_(nullptr)
+  { }
+
+  Lexer(Context& cxt, Character_stream& cs, Token_buffer& ts, Diagnostic_seq& ds)
+    : cxt_(cxt), cs_(cs), ts_(ts), diags_(&ds)
   { }
 
   void operator()();
@@ -55,15 +78,23 @@ struct Lexer
   void get();
 
   Symbol_table& symbols();
+  Symbol const* lookup(String const&);
+  Symbol const* lookup_identifier(String const&);
+  Symbol const* lookup_integer(String const&);
 
   Context&          cxt_;
   Character_stream& cs_;
-  Token_stream&     ts_;
+  Token_buffer&     ts_;
   String_builder    buf_;
   Location          loc_;
+  Symbol_cache      cache_; // Symbols seen by this lexer
+  Diagnostic_seq*   diags_; // Deferred diagnostics, if any
 };
 
 
+void emit_diagnostics(Lexer::Diagnostic_seq const&);
+
+
 } // namespace banjo
 
 
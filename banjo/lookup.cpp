@@ -5,6 +5,7 @@
 #include "ast.hpp"
 #include "context.hpp"
 #include "scope.hpp"
+#include "module.hpp"
 #include "printer.hpp"
 
 #include <iostream>
@@ -42,6 +43,11 @@ unqualified_lookup(Context& cxt, Name const& name)
     p = p->enclosing_scope();
   }
 
+  // A name that is not declared in the program may be declared in an
+  // imported module. Its declarations are loaded on first use.
+  if (Overload_set* ovl = import_lookup(cxt, name))
+    return *ovl;
+
   error(cxt, "no matching declaration for '{}'", name);
   throw Lookup_error("no matching declaration");
 }
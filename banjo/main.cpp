@@ -1,41 +1,92 @@
 // Copyright (c) 2015-2016 Andrew Sutton
 // All rights reserved
 
+#include "budget.hpp"
+#include "cache.hpp"
 #include "context.hpp"
+#include "file.hpp"
+#include "incremental.hpp"
 #include "lexer.hpp"
+#include "memo.hpp"
+#include "module.hpp"
 #include "parser.hpp"
 #include "printer.hpp"
+#include "report.hpp"
+#include "server.hpp"
+#include "vm.hpp"
 
+#include "gen/cxx/generator.hpp"
+#include "gen/llvm/emitter.hpp"
 #include "gen/llvm/generator.hpp"
+#include "gen/llvm/parallel.hpp"
 
 #include <lingo/file.hpp>
 #include <lingo/io.hpp>
 #include <lingo/error.hpp>
 
+#include <llvm/IR/Module.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <fstream>
 #include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
 
 
 using namespace lingo;
 using namespace banjo;
 
 
-using File_seq = std::vector<File*>;
+using Path_seq = std::vector<String>;
+using Buffer_seq = std::vector<Buffer*>;
 
 
 struct Options
 {
   ~Options();
 
-  String   emit    = "bano";
-  File_seq inputs  = {};
+  String            emit         = "bano";
+  bool              rss          = false;
+  int               jobs         = 1;
+  std::size_t       memo         = 0;
+  bool              memo_stats   = false;
+  Evaluation_limits limits       = {};
+  bool              profile      = false;
+  Jit_options       jit          = {};
+  int               opt          = 0;
+  bool              time_passes  = false;
+  bool              split        = false;
+  bool              bounds       = false;
+  bool              bounds_stats = false;
+  String            cache_dir    = {};
+  std::uintmax_t    cache_size   = 256 << 20;
+  bool              cache_stats  = false;
+  bool              time_report  = false;
+  bool              mem_report   = false;
+  Report_format     report_form  = table_report;
+  bool              watch        = false;
+  bool              incr_stats   = false;
+  String            output       = {};
+  Path_seq          paths        = {};
+  Path_seq          imports      = {};
+  Buffer_seq        inputs       = {};
+  Module_list       modules      = {};
 };
 
 
 
 Options::~Options()
 {
-  for (File* f : inputs)
-    delete f;
+  for (Buffer* b : inputs)
+    delete b;
+  for (Module* m : modules)
+    delete m;
 }
 
 
@@ -48,17 +99,340 @@ void
 parse_emit(int& argn, int argc, char* argv[], Options& opts)
 {
   if (argn == argc) {
-    error("expected one of 'banjo|cxx|llvm' after '-emit'");
+    error("expected one of 'banjo|cxx|module|llvm|bc|asm|obj' after '-emit'");
     exit(1);
   }
   opts.emit = argv[++argn];
 }
 
 
+// Returns the kind of LLVM output requested by '-emit', or null
+// if the requested output is not generated by LLVM.
+ll::Output_kind const*
+get_output_kind(String const& emit)
+{
+  static std::unordered_map<String, ll::Output_kind> kinds {
+    {"llvm", ll::llvm_output},
+    {"bc", ll::bc_output},
+    {"asm", ll::asm_output},
+    {"obj", ll::obj_output},
+  };
+  auto iter = kinds.find(emit);
+  if (iter == kinds.end())
+    return nullptr;
+  return &iter->second;
+}
+
+
+// Returns the output path used when '-o' is not given. Textual IR
+// is written to the standard output.
+String
+default_output(ll::Output_kind k)
+{
+  switch (k) {
+    case ll::llvm_output: return "-";
+    case ll::bc_output: return "a.bc";
+    case ll::asm_output: return "a.s";
+    case ll::obj_output: return "a.o";
+  }
+  return "-";
+}
+
+
+// Returns the path of the output file for LLVM output of kind `k`.
+String
+get_output_path(Options const& opts, ll::Output_kind k)
+{
+  if (opts.output.empty())
+    return default_output(k);
+  return opts.output;
+}
+
+
+// Set the path of the output file. A path of '-' denotes the
+// standard output.
+void
+parse_output(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (argn + 1 == argc) {
+    error("expected a path after '-o'");
+    exit(1);
+  }
+  opts.output = argv[++argn];
+}
+
+
+// Import the declarations of a module written by '-emit module'.
+void
+parse_import(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (argn + 1 == argc) {
+    error("expected a path after '-import'");
+    exit(1);
+  }
+  opts.imports.push_back(argv[++argn]);
+}
+
+
+// Set the optimization level from an option of the form -On.
+void
+parse_opt_level(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.opt = argv[argn][2] - '0';
+}
+
+
+// Report the time spent in each optimization pass.
+void
+parse_time_passes(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.time_passes = true;
+}
+
+
+// Partition code generation across the number of threads given
+// by '-j', emitting one output per partition.
+void
+parse_parallel_codegen(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.split = true;
+}
+
+
+// Check subscripts against the lengths of arrays, dynamic arrays,
+// and slices.
+void
+parse_bounds_check(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.bounds = true;
+}
+
+
+// Report the number of bounds checks inserted and eliminated.
+void
+parse_bounds_check_stats(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.bounds = true;
+  opts.bounds_stats = true;
+}
+
+
+// Report the peak resident set size on exit.
+void
+parse_report_rss(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.rss = true;
+}
+
+
+// Set the number of worker threads.
+void
+parse_jobs(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (argn + 1 == argc) {
+    error("expected a number of threads after '-j'");
+    exit(1);
+  }
+  opts.jobs = std::atoi(argv[++argn]);
+  if (opts.jobs < 1) {
+    error("invalid number of threads '{}'", argv[argn]);
+    exit(1);
+  }
+}
+
+
+// Memoize calls to pure functions during constant evaluation.
+void
+parse_memoize(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (opts.memo == 0)
+    opts.memo = 4096;
+}
+
+
+// Set the maximum number of memoized calls.
+void
+parse_memo_size(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (argn + 1 == argc) {
+    error("expected a number of entries after '-fmemo-size'");
+    exit(1);
+  }
+  int n = std::atoi(argv[++argn]);
+  if (n < 1) {
+    error("invalid memo size '{}'", argv[argn]);
+    exit(1);
+  }
+  opts.memo = n;
+}
+
+
+// Report memoization statistics on exit.
+void
+parse_memo_stats(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.memo_stats = true;
+}
+
+
+// Cache compiler output in the given directory.
+void
+parse_cache_dir(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (argn + 1 == argc) {
+    error("expected a directory after '-fcache-dir'");
+    exit(1);
+  }
+  opts.cache_dir = argv[++argn];
+}
+
+
+// Report compile cache statistics on exit.
+void
+parse_cache_stats(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.cache_stats = true;
+}
+
+
+// Report the time spent in each phase of compilation.
+void
+parse_time_report(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.time_report = true;
+}
+
+
+// Report the allocations made in each phase of compilation.
+void
+parse_mem_report(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.mem_report = true;
+}
+
+
+// Set the format of the phase report.
+void
+parse_report_format(int& argn, int argc, char* argv[], Options& opts)
+{
+  if (argn + 1 == argc) {
+    error("expected one of 'table|json' after '-freport-format'");
+    exit(1);
+  }
+  String fmt = argv[++argn];
+  if (fmt == "table")
+    opts.report_form = table_report;
+  else if (fmt == "json")
+    opts.report_form = json_report;
+  else {
+    error("invalid argument '{}' to '-freport-format'", fmt);
+    exit(1);
+  }
+}
+
+
+// Recompile whenever an input file changes.
+void
+parse_watch(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.watch = true;
+}
+
+
+// Report the declarations reused by each incremental compilation.
+void
+parse_incremental_stats(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.incr_stats = true;
+}
+
+
+// Returns the numeric argument of the option at argn.
+std::size_t
+parse_count(int& argn, int argc, char* argv[])
+{
+  char const* opt = argv[argn];
+  if (argn + 1 == argc) {
+    error("expected a number after '{}'", opt);
+    exit(1);
+  }
+  char* end;
+  char const* arg = argv[++argn];
+  unsigned long long n = std::strtoull(arg, &end, 10);
+  if (*arg == 0 || *end != 0) {
+    error("invalid argument '{}' to '{}'", arg, opt);
+    exit(1);
+  }
+  return n;
+}
+
+
+// Set the maximum size of the compile cache in MiB.
+void
+parse_cache_size(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.cache_size = std::uintmax_t(parse_count(argn, argc, argv)) << 20;
+}
+
+
+// Limit the number of steps in a constant evaluation.
+void
+parse_constexpr_steps(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.limits.steps = parse_count(argn, argc, argv);
+}
+
+
+// Limit the depth of calls in a constant evaluation.
+void
+parse_constexpr_depth(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.limits.depth = parse_count(argn, argc, argv);
+}
+
+
+// Limit the memory allocated by a constant evaluation.
+void
+parse_constexpr_bytes(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.limits.bytes = parse_count(argn, argc, argv);
+}
+
+
+// Report the cost of functions called during constant evaluation.
+void
+parse_constexpr_profile(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.profile = true;
+}
+
+
+// Compile frequently evaluated functions to native code.
+void
+parse_jit(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.jit.enabled = true;
+}
+
+
+// Set the number of calls after which a function is compiled.
+void
+parse_jit_threshold(int& argn, int argc, char* argv[], Options& opts)
+{
+  opts.jit.threshold = parse_count(argn, argc, argv);
+  if (opts.jit.threshold == 0) {
+    error("invalid argument '0' to '-fjit-threshold'");
+    exit(1);
+  }
+}
+
+
+// Input files are opened after all options have been parsed since
+// options may determine how they are opened.
 void
 parse_positional(int& argn, int argc, char* argv[], Options& opts)
 {
-  opts.inputs.push_back(new File(argv[argn]));
+  opts.paths.push_back(argv[argn]);
 }
 
 
@@ -66,7 +440,36 @@ void
 parse_args(int argc, char* argv[], Options& opts)
 {
   static Options_map all {
-    {"-emit", parse_emit}
+    {"-emit", parse_emit},
+    {"-o", parse_output},
+    {"-import", parse_import},
+    {"-O0", parse_opt_level},
+    {"-O1", parse_opt_level},
+    {"-O2", parse_opt_level},
+    {"-O3", parse_opt_level},
+    {"-ftime-passes", parse_time_passes},
+    {"-fparallel-codegen", parse_parallel_codegen},
+    {"-fbounds-check", parse_bounds_check},
+    {"-fbounds-check-stats", parse_bounds_check_stats},
+    {"-freport-rss", parse_report_rss},
+    {"-j", parse_jobs},
+    {"-fmemoize", parse_memoize},
+    {"-fmemo-size", parse_memo_size},
+    {"-fmemo-stats", parse_memo_stats},
+    {"-fcache-dir", parse_cache_dir},
+    {"-fcache-size", parse_cache_size},
+    {"-fcache-stats", parse_cache_stats},
+    {"-ftime-report", parse_time_report},
+    {"-fmem-report", parse_mem_report},
+    {"-freport-format", parse_report_format},
+    {"-fwatch", parse_watch},
+    {"-fincremental-stats", parse_incremental_stats},
+    {"-fconstexpr-steps", parse_constexpr_steps},
+    {"-fconstexpr-depth", parse_constexpr_depth},
+    {"-fconstexpr-bytes", parse_constexpr_bytes},
+    {"-fconstexpr-profile", parse_constexpr_profile},
+    {"-fjit", parse_jit},
+    {"-fjit-threshold", parse_jit_threshold},
   };
 
 
@@ -87,47 +490,467 @@ parse_args(int argc, char* argv[], Options& opts)
 
 
 
+// Lex each input file into its own token buffer using a pool of worker
+// threads. Workers take the next unlexed input until none remain. The
+// buffers are then concatenated in input order into `toks`.
+//
+// Diagnostics are deferred during lexing and emitted afterwards, in
+// input order, so that output does not depend on scheduling. Returns
+// false if any errors were diagnosed.
+bool
+lex_inputs(Context& cxt, Options& opts, Buffer_seq const& inputs, Token_buffer& toks)
+{
+  int errs = error_count();
+  std::size_t n = inputs.size();
+  std::vector<Token_buffer> bufs(n);
+  std::vector<Lexer::Diagnostic_seq> diags(n);
+  std::vector<std::exception_ptr> excepts(n);
+
+  std::atomic<std::size_t> next(0);
+  auto work = [&]() {
+    std::size_t i;
+    while ((i = next++) < n) {
+      try {
+        Character_stream cs(*inputs[i]);
+        Lexer lex(cxt, cs, bufs[i], diags[i]);
+        lex();
+      } catch (...) {
+        excepts[i] = std::current_exception();
+      }
+    }
+  };
+
+  // The calling thread is also a worker.
+  std::size_t nthreads = std::min<std::size_t>(opts.jobs, n);
+  std::vector<std::thread> pool;
+  for (std::size_t i = 1; i < nthreads; ++i)
+    pool.emplace_back(work);
+  work();
+  for (std::thread& t : pool)
+    t.join();
+
+  for (std::size_t i = 0; i < n; ++i) {
+    emit_diagnostics(diags[i]);
+    if (excepts[i])
+      std::rethrow_exception(excepts[i]);
+  }
+  if (error_count() > errs)
+    return false;
+
+  std::size_t total = 0;
+  for (Token_buffer const& buf : bufs)
+    total += buf.size();
+  toks.reserve(total);
+  for (Token_buffer const& buf : bufs)
+    toks.append(buf);
+  return true;
+}
+
+
+// Perform character and lexical analysis. Tokens from all inputs are
+// lexed into a single buffer. Returns false if any errors were
+// diagnosed.
+bool
+lex_program(Context& cxt, Options& opts, Buffer_seq const& inputs, Token_buffer& toks)
+{
+  Phase_timer timer(lexing_phase);
+  if (opts.jobs > 1 && inputs.size() > 1)
+    return lex_inputs(cxt, opts, inputs, toks);
+  int errs = error_count();
+  for (Buffer* b : inputs) {
+    Character_stream cs(*b);
+    Lexer lex(cxt, cs, toks);
+    lex();
+    if (error_count() > errs)
+      return false;
+  }
+  return true;
+}
+
+
+// Returns the key of the output of this compilation in the compile
+// cache. Options that do not affect the output are not hashed.
+//
+// The evaluation limits, memoization and just-in-time compilation
+// change the steps taken by constant evaluation, and so whether it
+// succeeds. They are hashed with the options that affect generation.
+String
+get_cache_key(Context const& cxt, Options const& opts, Token_buffer const& toks)
+{
+  Content_hash h;
+  hash_compiler(h);
+  h.put(opts.emit);
+  h.put(std::uint64_t(opts.opt));
+  h.put(std::uint64_t(opts.bounds));
+  h.put(std::uint64_t(opts.limits.steps));
+  h.put(std::uint64_t(opts.limits.depth));
+  h.put(std::uint64_t(opts.limits.bytes));
+  h.put(std::uint64_t(opts.memo));
+  h.put(std::uint64_t(opts.jit.enabled));
+  h.put(std::uint64_t(opts.jit.threshold));
+  hash_tokens(h, toks);
+  for (Module const* m : cxt.imports)
+    h.put(m->data(), m->size());
+  return h.str();
+}
+
+
+void
+print_cache_stats(Compile_cache const& cache)
+{
+  Cache_stats const& st = cache.stats();
+  Cache_stats total = cache.totals();
+  std::cerr << "cache: " << st.hits << " hits, "
+            << st.misses << " misses, "
+            << st.inserts << " inserts, "
+            << st.evictions << " evictions ("
+            << total.hits << " hits, "
+            << total.misses << " misses in total)\n";
+}
+
+
+// Returns a translation unit that declares the declarations loaded from
+// imported modules, followed by the statements of `s`. The declarations
+// of `s` are added to `owned`; the generators define only those.
+Stmt&
+link_imports(Context& cxt, Stmt& s, ll::Decl_set& owned)
+{
+  Stmt_list ss;
+  for (Module* m : cxt.imports)
+    for (Decl& d : m->loaded())
+      ss.push_back(cxt.make_declaration_statement(d));
+  for (Stmt& s1 : cast<Translation_stmt>(s).statements()) {
+    if (Declaration_stmt* ds = as<Declaration_stmt>(&s1))
+      owned.insert(&ds->declaration());
+    ss.push_back(s1);
+  }
+  return cxt.make_translation_statement(std::move(ss));
+}
+
+
+// Print the time and memory used by each phase, if requested.
+void
+print_phase_report(Options const& opts)
+{
+  Phase_report& rep = phase_report();
+  if (!rep.enabled())
+    return;
+  rep.stop();
+  rep.print(std::cerr, opts.report_form);
+}
+
+
+// Generate the output requested by '-emit' for the program `prog`.
+// LLVM output written to a file is added to the cache, if given.
+// Returns the exit status of the compiler.
 int
-main(int argc, char* argv[])
+generate(Context& cxt, Options const& opts, Stmt& prog, Compile_cache* cache, String const& key)
 {
-  Context cxt;
+  // Declarations used from imported modules are declared, but not
+  // defined, by the generated code. Their definitions are in the
+  // object code compiled from the module's source.
+  ll::Decl_set imported;
+  ll::Decl_set const* owned = nullptr;
+  Stmt* tu = &prog;
+  if (!cxt.imports.empty()) {
+    tu = &link_imports(cxt, prog, imported);
+    owned = &imported;
+  }
+  Stmt& stmt = *tu;
+
+  if (opts.emit == "banjo") {
+    std::cout << prog << '\n';
+  }
+  else if (opts.emit == "module") {
+    String path = opts.output;
+    if (path.empty())
+      path = "a.bmod";
+    try {
+      Phase_timer timer(output_phase);
+      write_module(prog, path);
+    } catch (Translation_error& err) {
+      error("{}", err.what());
+      return 1;
+    }
+  }
+  else if (opts.emit == "cxx") {
+    // C++ is written to the standard output by default.
+    String path = opts.output;
+    if (path.empty())
+      path = "-";
+    try {
+      std::ofstream file;
+      if (path != "-") {
+        file.open(path);
+        if (!file)
+          throw Translation_error("cannot open '{}'", path);
+      }
+      std::ostream& os = path == "-" ? std::cout : file;
+      cxx::Generator gen(cxt, os);
+      gen.owned = owned;
+      {
+        Phase_timer timer(codegen_phase);
+        gen.translation_unit(stmt);
+      }
+      Phase_timer timer(output_phase);
+      os.flush();
+    } catch (Translation_error& err) {
+      error("{}", err.what());
+      return 1;
+    }
+  }
+  else if (ll::Output_kind const* k = get_output_kind(opts.emit)) {
+    String path = get_output_path(opts, *k);
+    try {
+      ll::Bounds_check_stats bounds;
+      if (opts.split && opts.jobs > 1) {
+        ll::Partition_options part {
+          opts.jobs, opts.opt, opts.time_passes, opts.bounds, *k, path,
+          owned
+        };
+        Phase_timer timer(codegen_phase);
+        bounds = ll::generate_partitions(stmt, part);
+      } else {
+        ll::Generator gen;
+        gen.owned = owned;
+        gen.opt = opts.opt;
+        gen.time_passes = opts.time_passes;
+        gen.bounds_check = opts.bounds;
+        llvm::Module* mod;
+        {
+          Phase_timer timer(codegen_phase);
+          mod = gen(stmt);
+        }
+        Phase_timer timer(output_phase);
+        ll::emit(*mod, *k, path, opts.opt);
+        bounds = gen.bounds_stats;
+        if (cache)
+          cache->insert(key, path);
+      }
+      if (opts.bounds_stats) {
+        std::cerr << "bounds checks: " << bounds.inserted << " inserted, "
+                  << bounds.eliminated << " eliminated\n";
+      }
+    } catch (Translation_error& err) {
+      error("{}", err.what());
+      return 1;
+    }
+  }
+  return 0;
+}
+
+
+// The inputs and tokens of one compilation in watch mode. Elaborated
+// declarations refer to the locations of their tokens, so a revision
+// is kept as long as a declaration of the incremental unit was parsed
+// from it.
+struct Revision
+{
+  ~Revision()
+  {
+    for (Buffer* b : inputs)
+      delete b;
+  }
+
+  Buffer_seq   inputs;
+  Token_buffer toks;
+};
+
+
+using Revision_list = std::vector<std::unique_ptr<Revision>>;
+
+
+// Returns the modification times of the input files.
+std::vector<std::int64_t>
+get_input_times(Options const& opts)
+{
+  std::vector<std::int64_t> times;
+  for (String const& path : opts.paths)
+    times.push_back(modification_time(path));
+  return times;
+}
+
+
+// Compile the program each time one of its input files changes, until
+// the compiler is interrupted. After the first compilation, only the
+// definitions that changed, and those that depend on them, are
+// elaborated again; see incremental.hpp.
+int
+watch(Context& cxt, Options& opts)
+{
+  Revision_list revs;
+  Incremental_unit unit(cxt);
+  while (true) {
+    std::vector<std::int64_t> times = get_input_times(opts);
+    std::unique_ptr<Revision> rev(new Revision);
+    try {
+      for (String const& path : opts.paths)
+        rev->inputs.push_back(open_input(path));
+      int errs = error_count();
+      if (lex_program(cxt, opts, rev->inputs, rev->toks)) {
+        Stmt& prog = unit(rev->toks);
+        if (error_count() == errs)
+          generate(cxt, opts, prog, nullptr, {});
+      }
+    } catch (Translation_error& err) {
+      error("{}", err.what());
+    }
+
+    // No declaration refers to an earlier revision when the unit was
+    // elaborated from scratch, or discarded.
+    if (unit.stats().full || !unit.unit)
+      revs.clear();
+    revs.push_back(std::move(rev));
+
+    if (opts.incr_stats) {
+      Incremental_stats const& st = unit.stats();
+      std::cerr << "incremental: " << (st.full ? "full, " : "")
+                << st.reused << " reused, "
+                << st.elaborated << " elaborated\n";
+    }
+
+    while (get_input_times(opts) == times)
+      std::this_thread::sleep_for(std::chrono::milliseconds(200));
+  }
+}
+
 
+// Compile the program described by the command line arguments. The
+// context may already hold declarations imported by a compile server.
+int
+compile(Context& cxt, int argc, char* argv[])
+{
   Options opts;
   parse_args(argc, argv, opts);
 
   // Check post-configuration options.
-  if (opts.inputs.empty()) {
+  if (opts.paths.empty()) {
     error("no input files given");
     return -1;
   }
 
-  // Initial file processing.
+  memo_cache().resize(opts.memo);
+  evaluation_budget().configure(opts.limits);
+  evaluation_budget().profiling = opts.profile;
+  jit_options() = opts.jit;
+  phase_report().start(opts.time_report, opts.mem_report);
+
+  // Initial file processing. Imported modules are mapped, but their
+  // declarations are loaded only when the program refers to them.
+  try {
+    for (String const& path : opts.imports)
+      opts.modules.push_back(new Module(cxt, path));
+    cxt.imports.insert(cxt.imports.end(), opts.modules.begin(), opts.modules.end());
+    if (opts.watch)
+      return watch(cxt, opts);
+    for (String const& path : opts.paths)
+      opts.inputs.push_back(open_input(path));
+  } catch (Translation_error& err) {
+    error("{}", err.what());
+    return 1;
+  }
 
   // Perform character and lexical analysis.
-  Token_seq toks;
-  for (File* f : opts.inputs) {
-    Character_stream cs(*f);
-    Token_stream ts;
-    Lexer lex(cxt, cs, ts);
-
-    // Lex tokens.
-    lex();
-    if (error_count())
-      return 1;
-    toks.splice(toks.end(), ts.buf_);
+  Token_buffer toks;
+  if (!lex_program(cxt, opts, opts.inputs, toks))
+    return 1;
+
+  // Consult the compile cache. Only a single LLVM module written to a
+  // file is cached. On a hit, the cached output is copied to the output
+  // file, and parsing, elaboration, and code generation are skipped.
+  std::unique_ptr<Compile_cache> cache;
+  String key;
+  ll::Output_kind const* kind = get_output_kind(opts.emit);
+  if (!opts.cache_dir.empty() && kind && !(opts.split && opts.jobs > 1)) {
+    String path = get_output_path(opts, *kind);
+    if (path != "-") {
+      try {
+        cache.reset(new Compile_cache(opts.cache_dir, opts.cache_size));
+        key = get_cache_key(cxt, opts, toks);
+        if (cache->find(key, path)) {
+          if (opts.cache_stats)
+            print_cache_stats(*cache);
+          print_phase_report(opts);
+          return 0;
+        }
+      } catch (Translation_error& err) {
+        error("{}", err.what());
+        return 1;
+      }
+    }
   }
 
   // Perform syntactic analysis.
-  Token_stream ts(toks);
-  Parser parse(cxt, ts);
-  Stmt& stmt = parse();
+  Parser parse(cxt, toks);
+  Stmt& prog = parse();
 
-  if (opts.emit == "banjo") {
-    std::cout << stmt << '\n';
+  if (generate(cxt, opts, prog, cache.get(), key) != 0)
+    return 1;
+
+  if (opts.profile)
+    print_evaluation_profile(std::cerr);
+
+  if (opts.memo_stats) {
+    Memo_stats const& st = memo_cache().stats();
+    std::cerr << "memo: " << st.hits << " hits, "
+              << st.misses << " misses, "
+              << st.inserts << " inserts, "
+              << st.evictions << " evictions\n";
   }
-  else if (opts.emit == "llvm") {
-    ll::Generator gen;
-    gen(stmt);
+
+  if (opts.cache_stats && cache)
+    print_cache_stats(*cache);
+
+  // Report memory usage.
+  if (opts.rss) {
+    std::cerr << "peak resident set size: "
+              << peak_resident_set_size() << " KiB\n";
   }
 
+  print_phase_report(opts);
+  return 0;
+}
+
+
+// Run a compile server on the socket named by the first argument.
+//
+//    banjo-compile --server <socket> [-import <path>]...
+//
+// The declarations of every imported module are loaded before the
+// first request, and are available to every compilation.
+int
+run_server(int argc, char* argv[])
+{
+  if (argc < 3) {
+    error("expected a socket path after '--server'");
+    return 1;
+  }
+  Context cxt;
+  std::vector<std::unique_ptr<Module>> modules;
+  try {
+    for (int i = 3; i < argc; ++i) {
+      if (std::strcmp(argv[i], "-import") != 0 || i + 1 == argc) {
+        error("invalid server option '{}'", argv[i]);
+        return 1;
+      }
+      modules.emplace_back(new Module(cxt, argv[++i]));
+      modules.back()->preload();
+      cxt.imports.push_back(modules.back().get());
+    }
+    ll::initialize_targets();
+    return serve(cxt, argv[2], compile);
+  } catch (Translation_error& err) {
+    error("{}", err.what());
+    return 1;
+  }
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  if (argc > 1 && std::strcmp(argv[1], "--server") == 0)
+    return run_server(argc, argv);
+  Context cxt;
+  return compile(cxt, argc, argv);
 }
@@ -0,0 +1,232 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "memo.hpp"
+#include "vm.hpp"
+
+#include <unordered_set>
+
+
+namespace banjo
+{
+
+// -------------------------------------------------------------------------- //
+// Keys
+
+namespace
+{
+
+// Returns the hash of a memoizable value.
+inline std::size_t
+hash_value(Value const& v)
+{
+  std::size_t h = v.kind();
+  switch (v.kind()) {
+    case integer_value:
+      return h ^ std::hash<Integer_value>()(v.get_integer());
+    case float_value:
+      return h ^ std::hash<Float_value>()(v.get_float());
+    case function_value:
+      return h ^ std::hash<Function_value>()(v.get_function());
+    default:
+      lingo_unreachable();
+  }
+}
+
+
+// Returns true when memoizable values are equal.
+inline bool
+equal_values(Value const& a, Value const& b)
+{
+  if (a.kind() != b.kind())
+    return false;
+  switch (a.kind()) {
+    case integer_value:
+      return a.get_integer() == b.get_integer();
+    case float_value:
+      return a.get_float() == b.get_float();
+    case function_value:
+      return a.get_function() == b.get_function();
+    default:
+      lingo_unreachable();
+  }
+}
+
+} // namespace
+
+
+std::size_t
+Memo_cache::Key_hash::operator()(Key const& k) const
+{
+  std::size_t h = std::hash<Function_decl const*>()(k.first);
+  for (Value const& v : k.second)
+    h = h * 31 + hash_value(v);
+  return h;
+}
+
+
+bool
+Memo_cache::Key_eq::operator()(Key const& a, Key const& b) const
+{
+  if (a.first != b.first || a.second.size() != b.second.size())
+    return false;
+  for (std::size_t i = 0; i < a.second.size(); ++i)
+    if (!equal_values(a.second[i], b.second[i]))
+      return false;
+  return true;
+}
+
+
+// Returns true if `v` can be part of a memo key or be stored as
+// a memoized result. Only scalar values that do not refer to storage
+// are memoizable.
+bool
+is_memoizable(Value const& v)
+{
+  return v.is_integer() || v.is_float() || v.is_function();
+}
+
+
+// -------------------------------------------------------------------------- //
+// Memo cache
+
+// Set the maximum number of entries, evicting the least recently
+// used entries if the cache is too large.
+void
+Memo_cache::resize(std::size_t n)
+{
+  cap = n;
+  while (map.size() > cap) {
+    map.erase(order.back());
+    order.pop_back();
+    ++stats_.evictions;
+  }
+}
+
+
+void
+Memo_cache::clear()
+{
+  map.clear();
+  order.clear();
+}
+
+
+// Returns the memoized result of calling `f` with `args`, or nullptr
+// if there is none.
+Value const*
+Memo_cache::find(Function_decl const& f, Value_list const& args)
+{
+  auto iter = map.find(Key(&f, args));
+  if (iter == map.end()) {
+    ++stats_.misses;
+    return nullptr;
+  }
+  ++stats_.hits;
+  Slot& slot = iter->second;
+  order.splice(order.begin(), order, slot.pos);
+  return &slot.value;
+}
+
+
+// Record the result of calling `f` with `args`. The least recently
+// used entry is evicted only when a new entry exceeds the capacity, so
+// recording a result that is already cached evicts nothing.
+void
+Memo_cache::insert(Function_decl const& f, Value_list const& args, Value const& v)
+{
+  if (!enabled())
+    return;
+  Key key(&f, args);
+  order.push_front(key);
+  auto ins = map.emplace(std::move(key), Slot{v, order.begin()});
+  if (!ins.second) {
+    order.pop_front();
+    return;
+  }
+  ++stats_.inserts;
+  if (map.size() > cap) {
+    map.erase(order.back());
+    order.pop_back();
+    ++stats_.evictions;
+  }
+}
+
+
+// Returns the memo cache used by the evaluator.
+Memo_cache&
+memo_cache()
+{
+  static Memo_cache cache;
+  return cache;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Purity
+
+namespace
+{
+
+// Memoized results of purity analysis.
+using Purity_map = std::unordered_map<Function_decl const*, bool>;
+
+
+Purity_map&
+purity_map()
+{
+  static Purity_map map;
+  return map;
+}
+
+
+} // namespace
+
+
+// Returns true if calls to `f` have no side effects and depend only
+// on their arguments.
+//
+// Lowered functions can only read and write the registers of their
+// own frame, so a function is pure when it and every function that it
+// may call can be lowered. Calls to functions that cannot be lowered
+// are evaluated by the tree walker, which can touch other objects.
+bool
+is_pure(Function_decl const& f)
+{
+  Purity_map& pure = purity_map();
+  auto iter = pure.find(&f);
+  if (iter != pure.end())
+    return iter->second;
+
+  // Search every function reachable from f.
+  bool result = true;
+  std::unordered_set<Function_decl const*> seen {&f};
+  std::vector<Function_decl const*> work {&f};
+  while (!work.empty()) {
+    Function_decl const* g = work.back();
+    work.pop_back();
+    Bytecode const* code = lower(*g);
+    if (!code) {
+      result = false;
+      break;
+    }
+    for (Function_decl const* h : code->callees)
+      if (seen.insert(h).second)
+        work.push_back(h);
+  }
+  pure.emplace(&f, result);
+  return result;
+}
+
+
+// Discard the results of purity analysis. This must be done when a
+// definition changes, since a function is pure only if its callees
+// are.
+void
+discard_purity()
+{
+  purity_map().clear();
+}
+
+
+} // namespace banjo
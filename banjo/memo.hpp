@@ -0,0 +1,99 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_MEMO_HPP
+#define BANJO_MEMO_HPP
+
+// This module provides memoization of constant-evaluated function
+// calls.
+//
+// The results of calls to pure functions are cached, keyed by the
+// function and its arguments, so that recursive definitions such as
+// the naive Fibonacci function are evaluated in time linear in their
+// argument. The cache is disabled by default and has a bounded size;
+// the least recently used entry is evicted when it is full.
+
+#include "prelude.hpp"
+#include "value.hpp"
+
+#include <list>
+#include <unordered_map>
+
+
+namespace banjo
+{
+
+struct Function_decl;
+
+
+// Statistics about the use of the memo cache.
+struct Memo_stats
+{
+  std::size_t hits      = 0;
+  std::size_t misses    = 0;
+  std::size_t inserts   = 0;
+  std::size_t evictions = 0;
+};
+
+
+// A bounded cache mapping function calls to their results. A capacity
+// of 0 disables the cache.
+struct Memo_cache
+{
+  using Key = std::pair<Function_decl const*, Value_list>;
+
+  struct Key_hash
+  {
+    std::size_t operator()(Key const&) const;
+  };
+
+  struct Key_eq
+  {
+    bool operator()(Key const&, Key const&) const;
+  };
+
+  // The entries are ordered from most to least recently used.
+  using Key_list = std::list<Key>;
+
+  struct Slot
+  {
+    Value              value;
+    Key_list::iterator pos;
+  };
+
+  using Slot_map = std::unordered_map<Key, Slot, Key_hash, Key_eq>;
+
+  Memo_cache()
+    : cap(0)
+  { }
+
+  bool        enabled() const  { return cap != 0; }
+  std::size_t capacity() const { return cap; }
+  std::size_t size() const     { return map.size(); }
+
+  void resize(std::size_t);
+  void clear();
+
+  Value const* find(Function_decl const&, Value_list const&);
+  void         insert(Function_decl const&, Value_list const&, Value const&);
+
+  Memo_stats const& stats() const { return stats_; }
+
+  std::size_t cap;
+  Key_list    order;
+  Slot_map    map;
+  Memo_stats  stats_;
+};
+
+
+Memo_cache& memo_cache();
+
+bool is_memoizable(Value const&);
+bool is_pure(Function_decl const&);
+void discard_purity();
+
+
+} // namespace banjo
+
+
+#endif
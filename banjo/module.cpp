@@ -0,0 +1,1357 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "module.hpp"
+#include "context.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+
+namespace banjo
+{
+
+// -------------------------------------------------------------------------- //
+// Encoding
+//
+// Every record is a sequence of words whose first word is the kind of
+// the encoded term. The values of these kinds are part of the format,
+// so new kinds are only ever appended.
+
+namespace
+{
+
+// Identifies a module file ("BNJM"), and its version.
+constexpr Module_word module_magic = 0x4d4a4e42;
+constexpr Module_word module_version = 1;
+
+
+// Written in place of a type index when the type is encoded in its
+// use. A type whose extent is computed at runtime may refer to local
+// variables, so it is not shared between declarations.
+constexpr Module_word inline_type = 0xffffffff;
+
+
+enum Type_kind : Module_word
+{
+  void_type,
+  bool_type,
+  byte_type,
+  int_type,
+  float_type,
+  function_type,
+  qualified_type,
+  pointer_type,
+  reference_type,
+  array_type,
+  dynarray_type,
+  slice_type,
+  tuple_type,
+};
+
+
+enum Expr_kind : Module_word
+{
+  bool_expr,
+  int_expr,
+  object_expr,
+  function_expr,
+  tuple_expr,
+  add_expr,
+  sub_expr,
+  mul_expr,
+  div_expr,
+  rem_expr,
+  neg_expr,
+  pos_expr,
+  bit_and_expr,
+  bit_or_expr,
+  bit_xor_expr,
+  bit_lsh_expr,
+  bit_rsh_expr,
+  bit_not_expr,
+  eq_expr,
+  ne_expr,
+  lt_expr,
+  gt_expr,
+  le_expr,
+  ge_expr,
+  cmp_expr,
+  and_expr,
+  or_expr,
+  not_expr,
+  assign_expr,
+  call_expr,
+  index_expr,
+  value_conv,
+  qualification_conv,
+  boolean_conv,
+  integer_conv,
+  float_conv,
+  numeric_conv,
+  trivial_init,
+  copy_init,
+  bind_init,
+  aggregate_init,
+  slice_conv,
+};
+
+
+enum Stmt_kind : Module_word
+{
+  empty_stmt,
+  compound_stmt,
+  expression_stmt,
+  declaration_stmt,
+  return_stmt,
+  yield_stmt,
+  if_then_stmt,
+  if_else_stmt,
+  while_stmt,
+  break_stmt,
+  continue_stmt,
+};
+
+
+enum Decl_kind : Module_word
+{
+  variable_decl,
+  function_decl,
+  coroutine_decl,
+};
+
+
+enum Def_kind : Module_word
+{
+  empty_def,
+  expression_def,
+  function_def,
+};
+
+
+// Declarations are referred to by their index in the module, or, in
+// a definition, by their index among the parameters and local
+// variables of the enclosing function.
+enum Ref_kind : Module_word
+{
+  global_ref,
+  local_ref,
+};
+
+
+// Throws an error for a term that cannot be stored in a module.
+template<typename T>
+[[noreturn]] void
+unsupported(T const& x)
+{
+  throw Translation_error("cannot store '{}' in a module", type_str(x));
+}
+
+
+// Returns true if `t` has an array extent that is not a literal.
+bool
+has_runtime_extent(Type const& t)
+{
+  struct fn
+  {
+    bool operator()(Type const& t)           { return false; }
+    bool operator()(Unary_type const& t)     { return has_runtime_extent(t.type()); }
+    bool operator()(Dynarray_type const& t)  { return true; }
+
+    bool operator()(Array_type const& t)
+    {
+      return !is<Integer_expr>(&t.extent()) || has_runtime_extent(t.type());
+    }
+
+    bool operator()(Function_type const& t)
+    {
+      for (Type const& p : t.parameter_types())
+        if (has_runtime_extent(p))
+          return true;
+      return has_runtime_extent(t.return_type());
+    }
+
+    bool operator()(Tuple_type const& t)
+    {
+      for (Type const& t1 : t.type_list())
+        if (has_runtime_extent(t1))
+          return true;
+      return false;
+    }
+  };
+  return apply(t, fn{});
+}
+
+} // namespace
+
+
+// -------------------------------------------------------------------------- //
+// Writing modules
+
+namespace
+{
+
+using Words = std::vector<Module_word>;
+
+
+struct Writer
+{
+  Module_word string(String const&);
+  Module_word global(Decl const&);
+  Module_word type(Type const&);
+
+  void type_ref(Words&, Type const&);
+  void type_record(Words&, Type const&);
+  void name(Words&, Name const&);
+  void decl_ref(Words&, Decl const&);
+  void expression(Words&, Expr const&);
+  void expressions(Words&, Expr_list const&);
+  void statement(Words&, Stmt const&);
+  void definition(Words&, Def const&);
+  void declaration(Decl const&);
+  void parameters(Words&, Decl_list const&);
+  void variable(Words&, Variable_decl const&);
+  void local(Decl const&);
+  void write(Stmt const&, String const&);
+
+  // Strings
+  std::unordered_map<String, Module_word> string_ids;
+  std::vector<String>                     strings;
+
+  // Types
+  std::unordered_map<Type const*, Module_word, Type_hash, Type_eq> type_ids;
+  Words                                                            type_words;
+  Words                                                            type_offsets;
+
+  // Declarations
+  std::unordered_map<Decl const*, Module_word> decl_ids;
+  std::vector<Decl const*>                     pending;
+  Words                                        decl_words;
+  Words                                        decl_offsets;
+
+  // Parameters and local variables of the current function.
+  std::unordered_map<Decl const*, Module_word> locals;
+};
+
+
+Module_word
+Writer::string(String const& s)
+{
+  auto ins = string_ids.insert({s, strings.size()});
+  if (ins.second)
+    strings.push_back(s);
+  return ins.first->second;
+}
+
+
+// Returns the index of the declaration `d`, scheduling it to be
+// written.
+Module_word
+Writer::global(Decl const& d)
+{
+  auto ins = decl_ids.insert({&d, pending.size()});
+  if (ins.second)
+    pending.push_back(&d);
+  return ins.first->second;
+}
+
+
+// Returns the index of the type `t`. Equivalent types share a single
+// record. The records of the component types of `t` precede its own.
+Module_word
+Writer::type(Type const& t)
+{
+  auto iter = type_ids.find(&t);
+  if (iter != type_ids.end())
+    return iter->second;
+  Words rec;
+  type_record(rec, t);
+  Module_word id = type_offsets.size();
+  type_offsets.push_back(type_words.size());
+  type_words.insert(type_words.end(), rec.begin(), rec.end());
+  type_ids.emplace(&t, id);
+  return id;
+}
+
+
+void
+Writer::type_ref(Words& out, Type const& t)
+{
+  if (has_runtime_extent(t)) {
+    out.push_back(inline_type);
+    type_record(out, t);
+  } else {
+    out.push_back(type(t));
+  }
+}
+
+
+void
+Writer::type_record(Words& out, Type const& t)
+{
+  struct fn
+  {
+    Writer& w;
+    Words&  out;
+    void operator()(Type const& t)         { unsupported(t); }
+    void operator()(Void_type const& t)    { out.push_back(void_type); }
+    void operator()(Boolean_type const& t) { out.push_back(bool_type); }
+    void operator()(Byte_type const& t)    { out.push_back(byte_type); }
+    void operator()(Float_type const& t)   { out.push_back(float_type); }
+
+    void operator()(Integer_type const& t)
+    {
+      out.insert(out.end(), {int_type, t.is_signed(), Module_word(t.precision())});
+    }
+
+    void operator()(Function_type const& t)
+    {
+      out.push_back(function_type);
+      out.push_back(t.parameter_types().size());
+      for (Type const& p : t.parameter_types())
+        w.type_ref(out, p);
+      w.type_ref(out, t.return_type());
+    }
+
+    void operator()(Qualified_type const& t)
+    {
+      out.push_back(qualified_type);
+      out.push_back(t.qualifiers());
+      w.type_ref(out, t.type());
+    }
+
+    void operator()(Pointer_type const& t)
+    {
+      out.push_back(pointer_type);
+      w.type_ref(out, t.type());
+    }
+
+    void operator()(Reference_type const& t)
+    {
+      out.push_back(reference_type);
+      w.type_ref(out, t.type());
+    }
+
+    void operator()(Slice_type const& t)
+    {
+      out.push_back(slice_type);
+      w.type_ref(out, t.type());
+    }
+
+    void operator()(Array_type const& t)
+    {
+      out.push_back(array_type);
+      w.type_ref(out, t.type());
+      w.expression(out, t.extent());
+    }
+
+    void operator()(Dynarray_type const& t)
+    {
+      out.push_back(dynarray_type);
+      w.type_ref(out, t.type());
+      w.expression(out, t.extent());
+    }
+
+    void operator()(Tuple_type const& t)
+    {
+      out.push_back(tuple_type);
+      out.push_back(t.type_list().size());
+      for (Type const& t1 : t.type_list())
+        w.type_ref(out, t1);
+    }
+  };
+  apply(t, fn{*this, out});
+}
+
+
+void
+Writer::name(Words& out, Name const& n)
+{
+  if (Simple_id const* id = as<Simple_id>(&n))
+    return out.push_back(string(id->symbol().spelling()));
+  unsupported(n);
+}
+
+
+void
+Writer::decl_ref(Words& out, Decl const& d)
+{
+  auto iter = locals.find(&d);
+  if (iter != locals.end())
+    out.insert(out.end(), {local_ref, iter->second});
+  else
+    out.insert(out.end(), {global_ref, global(d)});
+}
+
+
+void
+Writer::expression(Words& out, Expr const& e)
+{
+  struct fn
+  {
+    Writer& w;
+    Words&  out;
+
+    void unary(Expr_kind k, Unary_expr const& e)
+    {
+      out.push_back(k);
+      w.type_ref(out, e.type());
+      w.expression(out, e.operand());
+    }
+
+    void binary(Expr_kind k, Binary_expr const& e)
+    {
+      out.push_back(k);
+      w.type_ref(out, e.type());
+      w.expression(out, e.left());
+      w.expression(out, e.right());
+    }
+
+    void conversion(Expr_kind k, Conv const& e)
+    {
+      out.push_back(k);
+      w.type_ref(out, e.type());
+      w.expression(out, e.source());
+    }
+
+    void operator()(Expr const& e)               { unsupported(e); }
+    void operator()(Add_expr const& e)           { binary(add_expr, e); }
+    void operator()(Sub_expr const& e)           { binary(sub_expr, e); }
+    void operator()(Mul_expr const& e)           { binary(mul_expr, e); }
+    void operator()(Div_expr const& e)           { binary(div_expr, e); }
+    void operator()(Rem_expr const& e)           { binary(rem_expr, e); }
+    void operator()(Neg_expr const& e)           { unary(neg_expr, e); }
+    void operator()(Pos_expr const& e)           { unary(pos_expr, e); }
+    void operator()(Bit_and_expr const& e)       { binary(bit_and_expr, e); }
+    void operator()(Bit_or_expr const& e)        { binary(bit_or_expr, e); }
+    void operator()(Bit_xor_expr const& e)       { binary(bit_xor_expr, e); }
+    void operator()(Bit_lsh_expr const& e)       { binary(bit_lsh_expr, e); }
+    void operator()(Bit_rsh_expr const& e)       { binary(bit_rsh_expr, e); }
+    void operator()(Bit_not_expr const& e)       { unary(bit_not_expr, e); }
+    void operator()(Eq_expr const& e)            { binary(eq_expr, e); }
+    void operator()(Ne_expr const& e)            { binary(ne_expr, e); }
+    void operator()(Lt_expr const& e)            { binary(lt_expr, e); }
+    void operator()(Gt_expr const& e)            { binary(gt_expr, e); }
+    void operator()(Le_expr const& e)            { binary(le_expr, e); }
+    void operator()(Ge_expr const& e)            { binary(ge_expr, e); }
+    void operator()(Cmp_expr const& e)           { binary(cmp_expr, e); }
+    void operator()(And_expr const& e)           { binary(and_expr, e); }
+    void operator()(Or_expr const& e)            { binary(or_expr, e); }
+    void operator()(Not_expr const& e)           { unary(not_expr, e); }
+    void operator()(Assign_expr const& e)        { binary(assign_expr, e); }
+    void operator()(Index_expr const& e)         { binary(index_expr, e); }
+    void operator()(Value_conv const& e)         { conversion(value_conv, e); }
+    void operator()(Qualification_conv const& e) { conversion(qualification_conv, e); }
+    void operator()(Boolean_conv const& e)       { conversion(boolean_conv, e); }
+    void operator()(Integer_conv const& e)       { conversion(integer_conv, e); }
+    void operator()(Float_conv const& e)         { conversion(float_conv, e); }
+    void operator()(Numeric_conv const& e)       { conversion(numeric_conv, e); }
+    void operator()(Slice_conv const& e)         { conversion(slice_conv, e); }
+
+    void operator()(Boolean_expr const& e)
+    {
+      out.push_back(bool_expr);
+      w.type_ref(out, e.type());
+      out.push_back(e.value());
+    }
+
+    // Literals are stored as decimal strings.
+    void operator()(Integer_expr const& e)
+    {
+      Integer_type const& t = cast<Integer_type>(e.type());
+      out.push_back(int_expr);
+      w.type_ref(out, e.type());
+      out.push_back(w.string(e.value().impl().toString(10, t.is_signed())));
+    }
+
+    void operator()(Object_expr const& e)
+    {
+      out.push_back(object_expr);
+      w.type_ref(out, e.type());
+      w.decl_ref(out, e.declaration());
+    }
+
+    void operator()(Function_expr const& e)
+    {
+      out.push_back(function_expr);
+      w.type_ref(out, e.type());
+      w.decl_ref(out, e.declaration());
+    }
+
+    void operator()(Tuple_expr const& e)
+    {
+      out.push_back(tuple_expr);
+      w.type_ref(out, e.type());
+      w.expressions(out, e.elements());
+    }
+
+    void operator()(Call_expr const& e)
+    {
+      out.push_back(call_expr);
+      w.type_ref(out, e.type());
+      w.expression(out, e.function());
+      w.expressions(out, e.arguments());
+    }
+
+    void operator()(Trivial_init const& e)
+    {
+      out.push_back(trivial_init);
+      w.type_ref(out, e.type());
+    }
+
+    void operator()(Copy_init const& e)
+    {
+      out.push_back(copy_init);
+      w.type_ref(out, e.type());
+      w.expression(out, e.expression());
+    }
+
+    void operator()(Bind_init const& e)
+    {
+      out.push_back(bind_init);
+      w.type_ref(out, e.type());
+      w.expression(out, e.expression());
+    }
+
+    void operator()(Aggregate_init const& e)
+    {
+      out.push_back(aggregate_init);
+      w.type_ref(out, e.type());
+      w.expressions(out, e.initializers());
+    }
+  };
+  apply(e, fn{*this, out});
+}
+
+
+void
+Writer::expressions(Words& out, Expr_list const& es)
+{
+  out.push_back(es.size());
+  for (Expr const& e : es)
+    expression(out, e);
+}
+
+
+void
+Writer::statement(Words& out, Stmt const& s)
+{
+  struct fn
+  {
+    Writer& w;
+    Words&  out;
+    void operator()(Stmt const& s)          { unsupported(s); }
+    void operator()(Empty_stmt const& s)    { out.push_back(empty_stmt); }
+    void operator()(Break_stmt const& s)    { out.push_back(break_stmt); }
+    void operator()(Continue_stmt const& s) { out.push_back(continue_stmt); }
+
+    void operator()(Compound_stmt const& s)
+    {
+      out.push_back(compound_stmt);
+      out.push_back(s.statements().size());
+      for (Stmt const& s1 : s.statements())
+        w.statement(out, s1);
+    }
+
+    void operator()(Expression_stmt const& s)
+    {
+      out.push_back(expression_stmt);
+      w.expression(out, s.expression());
+    }
+
+    void operator()(Declaration_stmt const& s)
+    {
+      Variable_decl const* var = as<Variable_decl>(&s.declaration());
+      if (!var)
+        unsupported(s.declaration());
+      out.push_back(declaration_stmt);
+      w.local(*var);
+      w.variable(out, *var);
+    }
+
+    void operator()(Return_stmt const& s)
+    {
+      out.push_back(return_stmt);
+      w.expression(out, s.expression());
+    }
+
+    void operator()(Yield_stmt const& s)
+    {
+      out.push_back(yield_stmt);
+      w.expression(out, s.expression());
+    }
+
+    void operator()(If_then_stmt const& s)
+    {
+      out.push_back(if_then_stmt);
+      w.expression(out, s.condition());
+      w.statement(out, s.true_branch());
+    }
+
+    void operator()(If_else_stmt const& s)
+    {
+      out.push_back(if_else_stmt);
+      w.expression(out, s.condition());
+      w.statement(out, s.true_branch());
+      w.statement(out, s.false_branch());
+    }
+
+    void operator()(While_stmt const& s)
+    {
+      out.push_back(while_stmt);
+      w.expression(out, s.condition());
+      w.statement(out, s.body());
+    }
+  };
+  apply(s, fn{*this, out});
+}
+
+
+void
+Writer::definition(Words& out, Def const& d)
+{
+  struct fn
+  {
+    Writer& w;
+    Words&  out;
+    void operator()(Def const& d)       { unsupported(d); }
+    void operator()(Empty_def const& d) { out.push_back(empty_def); }
+
+    void operator()(Expression_def const& d)
+    {
+      out.push_back(expression_def);
+      w.expression(out, d.expression());
+    }
+
+    void operator()(Function_def const& d)
+    {
+      out.push_back(function_def);
+      w.statement(out, d.statement());
+    }
+  };
+  apply(d, fn{*this, out});
+}
+
+
+// Number a parameter or local variable of the current function.
+void
+Writer::local(Decl const& d)
+{
+  locals.emplace(&d, locals.size());
+}
+
+
+// A variable is written as its name, type, slot, and initializer.
+void
+Writer::variable(Words& out, Variable_decl const& d)
+{
+  name(out, d.name());
+  type_ref(out, d.type());
+  out.push_back(d.slot());
+  definition(out, d.initializer());
+}
+
+
+void
+Writer::parameters(Words& out, Decl_list const& ps)
+{
+  out.push_back(ps.size());
+  for (Decl const& p : ps) {
+    Object_parm const* parm = as<Object_parm>(&p);
+    if (!parm)
+      unsupported(p);
+    local(*parm);
+    name(out, parm->name());
+    type_ref(out, parm->type());
+    out.push_back(parm->slot());
+  }
+}
+
+
+// Write the record of a declaration. The parameters of a function are
+// written before its type, which may refer to them.
+void
+Writer::declaration(Decl const& d)
+{
+  struct fn
+  {
+    Writer& w;
+    Words&  out;
+    void operator()(Decl const& d) { unsupported(d); }
+
+    void operator()(Variable_decl const& d)
+    {
+      out.push_back(variable_decl);
+      w.variable(out, d);
+    }
+
+    void operator()(Function_decl const& d)
+    {
+      out.push_back(function_decl);
+      w.name(out, d.name());
+      w.parameters(out, d.parameters());
+      w.type_ref(out, d.type());
+      out.push_back(d.frame_size());
+      w.definition(out, d.definition());
+    }
+
+    void operator()(Coroutine_decl const& d)
+    {
+      out.push_back(coroutine_decl);
+      w.name(out, d.name());
+      w.parameters(out, d.parameters());
+      w.type_ref(out, d.return_type());
+      w.definition(out, d.definition());
+    }
+  };
+  decl_offsets.push_back(decl_words.size());
+  apply(d, fn{*this, decl_words});
+  locals.clear();
+}
+
+
+// Serialize the declarations of the translation unit `s` to the file
+// at `path`. Every declaration of the translation unit is exported.
+void
+Writer::write(Stmt const& s, String const& path)
+{
+  std::vector<std::pair<Module_word, Module_word>> exports;
+  for (Stmt const& s1 : cast<Translation_stmt>(s).statements()) {
+    if (is<Empty_stmt>(&s1))
+      continue;
+    Declaration_stmt const* ds = as<Declaration_stmt>(&s1);
+    if (!ds)
+      unsupported(s1);
+    Decl const& d = ds->declaration();
+    Simple_id const* id = as<Simple_id>(&d.name());
+    if (!id)
+      unsupported(d.name());
+    exports.emplace_back(string(id->symbol().spelling()), global(d));
+  }
+
+  // Writing a declaration may schedule those that it refers to.
+  for (std::size_t i = 0; i < pending.size(); ++i)
+    declaration(*pending[i]);
+
+  // Exports are sorted by name so that they can be searched in place.
+  std::stable_sort(exports.begin(), exports.end(), [this](auto const& a, auto const& b) {
+    return strings[a.first] < strings[b.first];
+  });
+
+  // Lay out the sections.
+  Module_header h;
+  h.magic = module_magic;
+  h.version = module_version;
+  h.strings = strings.size();
+  h.types = type_offsets.size();
+  h.decls = decl_offsets.size();
+  h.exports = exports.size();
+
+  std::size_t text = 0;
+  for (String const& str : strings)
+    text += str.size();
+  std::size_t header_words = sizeof(Module_header) / sizeof(Module_word);
+  std::size_t text_words = (text + sizeof(Module_word) - 1) / sizeof(Module_word);
+  h.string_offset = header_words;
+  h.type_offset = h.string_offset + 2 * h.strings + text_words;
+  h.decl_offset = h.type_offset + h.types + type_words.size();
+  h.export_offset = h.decl_offset + h.decls + decl_words.size();
+
+  Words file(reinterpret_cast<Module_word*>(&h),
+             reinterpret_cast<Module_word*>(&h) + header_words);
+
+  // Strings are located by their offset in bytes.
+  Module_word pos = (h.string_offset + 2 * h.strings) * sizeof(Module_word);
+  for (String const& str : strings) {
+    file.insert(file.end(), {pos, Module_word(str.size())});
+    pos += str.size();
+  }
+  std::size_t first = file.size();
+  file.resize(first + text_words);
+  char* p = reinterpret_cast<char*>(file.data() + first);
+  for (String const& str : strings)
+    p = std::copy(str.begin(), str.end(), p);
+
+  // Record offsets are relative to the start of the file.
+  Module_word base = h.type_offset + h.types;
+  for (Module_word off : type_offsets)
+    file.push_back(base + off);
+  file.insert(file.end(), type_words.begin(), type_words.end());
+  base = h.decl_offset + h.decls;
+  for (Module_word off : decl_offsets)
+    file.push_back(base + off);
+  file.insert(file.end(), decl_words.begin(), decl_words.end());
+  for (auto const& x : exports)
+    file.insert(file.end(), {x.first, x.second});
+
+  std::ofstream os(path, std::ios::binary);
+  os.write(reinterpret_cast<char const*>(file.data()), file.size() * sizeof(Module_word));
+  if (!os)
+    throw Translation_error("cannot write '{}'", path);
+}
+
+} // namespace
+
+
+void
+write_module(Stmt const& s, String const& path)
+{
+  Writer w;
+  w.write(s, path);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Reading modules
+
+namespace
+{
+
+// Reads the records of a module, starting from a given offset.
+struct Reader
+{
+  Reader(Module& m, std::size_t p, std::vector<Decl*>& l)
+    : mod(m), cxt(m.cxt), pos(p), locals(l)
+  { }
+
+  Module_word next() { return mod.word(pos++); }
+
+  Name& name();
+  Type& type();
+  Type& type_record();
+  Decl& decl_ref();
+  Expr& expression();
+  Expr_list expressions();
+  Stmt& statement();
+  Def& definition();
+  Decl_list parameters();
+  Variable_decl& variable();
+  Decl& declaration(Module_word);
+
+  template<typename T> Expr& unary(Type&);
+  template<typename T> Expr& binary(Type&);
+  template<typename T> Expr& conversion(Type&);
+
+  Module&             mod;
+  Context&            cxt;
+  std::size_t         pos;
+  std::vector<Decl*>& locals; // Parameters and local variables
+};
+
+
+Name&
+Reader::name()
+{
+  return cxt.get_id(mod.string(next()));
+}
+
+
+Type&
+Reader::type()
+{
+  Module_word id = next();
+  if (id == inline_type)
+    return type_record();
+  return mod.type(id);
+}
+
+
+Type&
+Reader::type_record()
+{
+  switch (next()) {
+    case void_type:
+      return cxt.get_void_type();
+    case bool_type:
+      return cxt.get_bool_type();
+    case byte_type:
+      return cxt.get_byte_type();
+    case float_type:
+      return cxt.get_float_type();
+    case int_type: {
+      bool sign = next();
+      int prec = next();
+      return cxt.get_integer_type(sign, prec);
+    }
+    case function_type: {
+      Type_list ps;
+      for (Module_word n = next(); n != 0; --n)
+        ps.push_back(type());
+      Type& r = type();
+      return cxt.get_function_type(ps, r);
+    }
+    case qualified_type: {
+      Qualifier_set q = Qualifier_set(next());
+      return cxt.get_qualified_type(type(), q);
+    }
+    case pointer_type:
+      return cxt.get_pointer_type(type());
+    case reference_type:
+      return cxt.get_reference_type(type());
+    case slice_type:
+      return cxt.get_slice_type(type());
+    case array_type: {
+      Type& t = type();
+      return cxt.get_array_type(t, expression());
+    }
+    case dynarray_type: {
+      Type& t = type();
+      return cxt.get_dynarray_type(t, expression());
+    }
+    case tuple_type: {
+      Type_list ts;
+      for (Module_word n = next(); n != 0; --n)
+        ts.push_back(type());
+      return cxt.get_tuple_type(ts);
+    }
+  }
+  mod.malformed();
+}
+
+
+Decl&
+Reader::decl_ref()
+{
+  Module_word k = next();
+  Module_word n = next();
+  if (k == global_ref)
+    return mod.declaration(n);
+  if (k != local_ref || n >= locals.size())
+    mod.malformed();
+  return *locals[n];
+}
+
+
+template<typename T>
+inline Expr&
+Reader::unary(Type& t)
+{
+  Expr& e = expression();
+  return cxt.make<T>(t, e);
+}
+
+
+template<typename T>
+inline Expr&
+Reader::binary(Type& t)
+{
+  Expr& l = expression();
+  Expr& r = expression();
+  return cxt.make<T>(t, l, r);
+}
+
+
+template<typename T>
+inline Expr&
+Reader::conversion(Type& t)
+{
+  Expr& e = expression();
+  return cxt.make<T>(t, e);
+}
+
+
+Expr&
+Reader::expression()
+{
+  Module_word k = next();
+  Type& t = type();
+  switch (k) {
+    case bool_expr:
+      return cxt.make<Boolean_expr>(t, next() != 0);
+    case int_expr: {
+      Integer n = mod.string(next());
+      return cxt.make<Integer_expr>(t, n);
+    }
+    case object_expr: {
+      Decl& d = decl_ref();
+      if (!is<Object_decl>(&d))
+        mod.malformed();
+      return cxt.make<Object_expr>(t, d.name(), d);
+    }
+    case function_expr: {
+      Decl& d = decl_ref();
+      if (!is<Function_decl>(&d))
+        mod.malformed();
+      return cxt.make<Function_expr>(t, d.name(), d);
+    }
+    case tuple_expr:
+      return cxt.make<Tuple_expr>(t, expressions());
+    case add_expr: return binary<Add_expr>(t);
+    case sub_expr: return binary<Sub_expr>(t);
+    case mul_expr: return binary<Mul_expr>(t);
+    case div_expr: return binary<Div_expr>(t);
+    case rem_expr: return binary<Rem_expr>(t);
+    case neg_expr: return unary<Neg_expr>(t);
+    case pos_expr: return unary<Pos_expr>(t);
+    case bit_and_expr: return binary<Bit_and_expr>(t);
+    case bit_or_expr: return binary<Bit_or_expr>(t);
+    case bit_xor_expr: return binary<Bit_xor_expr>(t);
+    case bit_lsh_expr: return binary<Bit_lsh_expr>(t);
+    case bit_rsh_expr: return binary<Bit_rsh_expr>(t);
+    case bit_not_expr: return unary<Bit_not_expr>(t);
+    case eq_expr: return binary<Eq_expr>(t);
+    case ne_expr: return binary<Ne_expr>(t);
+    case lt_expr: return binary<Lt_expr>(t);
+    case gt_expr: return binary<Gt_expr>(t);
+    case le_expr: return binary<Le_expr>(t);
+    case ge_expr: return binary<Ge_expr>(t);
+    case cmp_expr: return binary<Cmp_expr>(t);
+    case and_expr: return binary<And_expr>(t);
+    case or_expr: return binary<Or_expr>(t);
+    case not_expr: return unary<Not_expr>(t);
+    case assign_expr: return binary<Assign_expr>(t);
+    case index_expr: return binary<Index_expr>(t);
+    case call_expr: {
+      Expr& f = expression();
+      return cxt.make<Call_expr>(t, f, expressions());
+    }
+    case value_conv: return conversion<Value_conv>(t);
+    case qualification_conv: return conversion<Qualification_conv>(t);
+    case boolean_conv: return conversion<Boolean_conv>(t);
+    case integer_conv: return conversion<Integer_conv>(t);
+    case float_conv: return conversion<Float_conv>(t);
+    case numeric_conv: return conversion<Numeric_conv>(t);
+    case slice_conv: return conversion<Slice_conv>(t);
+    case trivial_init:
+      return cxt.make_trivial_init(t);
+    case copy_init:
+      return cxt.make_copy_init(t, expression());
+    case bind_init:
+      return cxt.make_bind_init(t, expression());
+    case aggregate_init:
+      return cxt.make_aggregate_init(t, expressions());
+  }
+  mod.malformed();
+}
+
+
+Expr_list
+Reader::expressions()
+{
+  Expr_list es;
+  for (Module_word n = next(); n != 0; --n)
+    es.push_back(expression());
+  return es;
+}
+
+
+Stmt&
+Reader::statement()
+{
+  switch (next()) {
+    case empty_stmt:
+      return cxt.make_empty_statement();
+    case break_stmt:
+      return cxt.make_break_statement();
+    case continue_stmt:
+      return cxt.make_continue_statement();
+    case compound_stmt: {
+      Stmt_list ss;
+      for (Module_word n = next(); n != 0; --n)
+        ss.push_back(statement());
+      return cxt.make_compound_statement(std::move(ss));
+    }
+    case expression_stmt:
+      return cxt.make_expression_statement(expression());
+    case declaration_stmt:
+      return cxt.make_declaration_statement(variable());
+    case return_stmt:
+      return cxt.make_return_statement(expression());
+    case yield_stmt:
+      return cxt.make_yield_statement(expression());
+    case if_then_stmt: {
+      Expr& c = expression();
+      Stmt& s = statement();
+      return cxt.make_if_statement(c, s);
+    }
+    case if_else_stmt: {
+      Expr& c = expression();
+      Stmt& s1 = statement();
+      Stmt& s2 = statement();
+      return cxt.make_if_statement(c, s1, s2);
+    }
+    case while_stmt: {
+      Expr& c = expression();
+      Stmt& s = statement();
+      return cxt.make_while_statement(c, s);
+    }
+  }
+  mod.malformed();
+}
+
+
+Def&
+Reader::definition()
+{
+  switch (next()) {
+    case empty_def:
+      return cxt.make_empty_definition();
+    case expression_def:
+      return cxt.make_expression_definition(expression());
+    case function_def:
+      return cxt.make_function_definition(statement());
+  }
+  mod.malformed();
+}
+
+
+// The variable is numbered before its initializer is read.
+Variable_decl&
+Reader::variable()
+{
+  Name& n = name();
+  Type& t = type();
+  Variable_decl& var = cxt.make<Variable_decl>(n, t, cxt.make_empty_definition());
+  var.slot_ = int(next());
+  locals.push_back(&var);
+  var.def_ = &definition();
+  return var;
+}
+
+
+Decl_list
+Reader::parameters()
+{
+  Decl_list ps;
+  for (Module_word n = next(); n != 0; --n) {
+    Name& id = name();
+    Type& t = type();
+    Object_parm& p = cxt.make_object_parm(id, t);
+    p.slot_ = int(next());
+    locals.push_back(&p);
+    ps.push_back(p);
+  }
+  return ps;
+}
+
+
+// Read the declaration whose index is `id`. The declaration is
+// recorded in the module before its definition is read, so that
+// recursive references find it.
+Decl&
+Reader::declaration(Module_word id)
+{
+  switch (next()) {
+    case variable_decl: {
+      Name& n = name();
+      Type& t = type();
+      Variable_decl& var = cxt.make<Variable_decl>(n, t, cxt.make_empty_definition());
+      var.slot_ = int(next());
+      mod.decls[id] = &var;
+      var.def_ = &definition();
+      return var;
+    }
+    case function_decl: {
+      Name& n = name();
+      Decl_list ps = parameters();
+      Type& t = type();
+      Function_decl& fn = cxt.make<Function_decl>(n, t, ps, cxt.make_empty_definition());
+      fn.constr_ = nullptr;
+      fn.frame_ = next();
+      mod.decls[id] = &fn;
+      fn.def_ = &definition();
+      return fn;
+    }
+    case coroutine_decl: {
+      Name& n = name();
+      Decl_list ps = parameters();
+      Type& t = type();
+      Coroutine_decl& co = cxt.make<Coroutine_decl>(n, t, ps, cxt.make_empty_definition());
+      mod.decls[id] = &co;
+      co.def_ = &definition();
+      return co;
+    }
+  }
+  mod.malformed();
+}
+
+} // namespace
+
+
+// Map the module at `path`. Only its header is read.
+Module::Module(Context& c, String const& path)
+  : Mapped_region(path, random_access), cxt(c)
+{
+  std::size_t n = size() / sizeof(Module_word);
+  std::size_t header_words = sizeof(Module_header) / sizeof(Module_word);
+  if (n < header_words)
+    malformed();
+  Module_header const& h = header();
+  if (h.magic != module_magic)
+    throw Translation_error("'{}' is not a module", path);
+  if (h.version != module_version)
+    throw Translation_error("'{}' has an unsupported module version", path);
+
+  // Check that every table lies within the file.
+  if (h.string_offset + 2 * std::size_t(h.strings) > n ||
+      h.type_offset + std::size_t(h.types) > n ||
+      h.decl_offset + std::size_t(h.decls) > n ||
+      h.export_offset + 2 * std::size_t(h.exports) > n)
+    malformed();
+
+  decls.resize(h.decls);
+  types.resize(h.types);
+}
+
+
+Module_header const&
+Module::header() const
+{
+  return *reinterpret_cast<Module_header const*>(data());
+}
+
+
+// Returns the word at offset `n`.
+Module_word
+Module::word(std::size_t n) const
+{
+  if (n >= size() / sizeof(Module_word))
+    malformed();
+  return reinterpret_cast<Module_word const*>(data())[n];
+}
+
+
+void
+Module::malformed() const
+{
+  throw Translation_error("malformed module '{}'", path());
+}
+
+
+String
+Module::string(Module_word id)
+{
+  char const* p;
+  std::size_t n;
+  text(id, p, n);
+  return String(p, n);
+}
+
+
+// Locate the text of the string `id` in the mapped file.
+void
+Module::text(Module_word id, char const*& p, std::size_t& n) const
+{
+  Module_header const& h = header();
+  if (id >= h.strings)
+    malformed();
+  Module_word pos = word(h.string_offset + 2 * id);
+  Module_word len = word(h.string_offset + 2 * id + 1);
+  if (std::size_t(pos) + len > size())
+    malformed();
+  p = data() + pos;
+  n = len;
+}
+
+
+// Compares the string `id` with `s`, returning a negative value, zero,
+// or a positive value if it orders before, equal to, or after `s`.
+int
+Module::compare(Module_word id, String const& s) const
+{
+  char const* p;
+  std::size_t n;
+  text(id, p, n);
+  int c = std::memcmp(p, s.data(), std::min(n, s.size()));
+  if (c != 0)
+    return c;
+  return n < s.size() ? -1 : n > s.size();
+}
+
+
+Type&
+Module::type(Module_word id)
+{
+  if (id >= types.size())
+    malformed();
+  if (!types[id]) {
+    std::vector<Decl*> none;
+    Reader r(*this, word(header().type_offset + id), none);
+    types[id] = &r.type_record();
+  }
+  return *types[id];
+}
+
+
+// Returns the declaration whose index is `id`, reading it if needed.
+// Each declaration has its own parameters and locals.
+Decl&
+Module::declaration(Module_word id)
+{
+  if (id >= decls.size())
+    malformed();
+  if (!decls[id]) {
+    std::vector<Decl*> locals;
+    Reader r(*this, word(header().decl_offset + id), locals);
+    order.push_back(r.declaration(id));
+  }
+  return *decls[id];
+}
+
+
+// Read every exported declaration, so that no lookup in this module
+// reads the file. A compile server preloads the modules imported by
+// all of its compilations.
+void
+Module::preload()
+{
+  Module_header const& h = header();
+  for (std::size_t i = 0; i < h.exports; ++i)
+    lookup(string(word(h.export_offset + 2 * i)));
+}
+
+
+// Returns the overload set of declarations named `n` exported by this
+// module, or null if there are none. The declarations are read on the
+// first lookup of their name.
+Overload_set*
+Module::lookup(String const& n)
+{
+  auto iter = sets.find(n);
+  if (iter != sets.end())
+    return &iter->second;
+
+  // Binary search the export table, whose entries are sorted by name.
+  // Names are compared in place.
+  Module_header const& h = header();
+  std::size_t lo = 0;
+  std::size_t hi = h.exports;
+  while (lo < hi) {
+    std::size_t mid = lo + (hi - lo) / 2;
+    if (compare(word(h.export_offset + 2 * mid), n) < 0)
+      lo = mid + 1;
+    else
+      hi = mid;
+  }
+
+  Overload_set* ovl = nullptr;
+  for (; lo < h.exports; ++lo) {
+    if (compare(word(h.export_offset + 2 * lo), n) != 0)
+      break;
+    Decl& d = declaration(word(h.export_offset + 2 * lo + 1));
+    if (ovl)
+      ovl->push_back(d);
+    else
+      ovl = &sets.emplace(n, Overload_set(d)).first->second;
+  }
+  return ovl;
+}
+
+
+// Search the modules imported into the context for a declaration of
+// `n`. The search stops at the first module that declares the name.
+Overload_set*
+import_lookup(Context& cxt, Name const& n)
+{
+  Simple_id const* id = as<Simple_id>(&n);
+  if (!id)
+    return nullptr;
+  for (Module* m : cxt.imports)
+    if (Overload_set* ovl = m->lookup(id->symbol().spelling()))
+      return ovl;
+  return nullptr;
+}
+
+
+} // namespace banjo
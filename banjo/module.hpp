@@ -0,0 +1,108 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_MODULE_HPP
+#define BANJO_MODULE_HPP
+
+// This module provides a binary format for precompiled declarations.
+//
+// A module file holds the elaborated declarations of a translation
+// unit: their names, types, and definitions. A program that imports a
+// module can refer to those declarations without lexing or elaborating
+// their source.
+//
+// An imported module is memory mapped, and its declarations are loaded
+// lazily. Opening a module reads only its header. When lookup fails to
+// find a name declared in the program, the module's export table is
+// searched, and only the declarations of that name are deserialized,
+// together with the declarations that their types and definitions
+// refer to.
+
+#include "prelude.hpp"
+#include "ast.hpp"
+#include "file.hpp"
+#include "overload.hpp"
+
+#include <unordered_map>
+#include <vector>
+
+
+namespace banjo
+{
+
+struct Context;
+
+
+// The words of a serialized module.
+using Module_word = std::uint32_t;
+
+
+// The header of a module file. Each section is an array of words,
+// located by its offset (in words) from the start of the file.
+//
+// The string section holds a pair of words (the offset in bytes and
+// the length of its text) for each string, followed by the text. The
+// type and declaration sections hold the offset of each record. The
+// export section holds a pair of words (a name and a declaration) for
+// each exported declaration, sorted by name.
+struct Module_header
+{
+  Module_word magic;
+  Module_word version;
+  Module_word strings;
+  Module_word types;
+  Module_word decls;
+  Module_word exports;
+  Module_word string_offset;
+  Module_word type_offset;
+  Module_word decl_offset;
+  Module_word export_offset;
+};
+
+
+void write_module(Stmt const&, String const&);
+
+
+// An imported module.
+//
+// The declarations and types of a module are identified by their
+// index in the module. Each is deserialized at most once, on first
+// use.
+struct Module : Mapped_region
+{
+  Module(Context&, String const&);
+
+  Overload_set* lookup(String const&);
+  void          preload();
+
+  Decl& declaration(Module_word);
+  Type& type(Module_word);
+  String string(Module_word);
+  void text(Module_word, char const*&, std::size_t&) const;
+  int compare(Module_word, String const&) const;
+
+  // Returns the declarations loaded so far, in the order in which
+  // they were loaded.
+  Decl_list const& loaded() const { return order; }
+
+  Module_header const& header() const;
+  Module_word word(std::size_t) const;
+  [[noreturn]] void malformed() const;
+
+  Context&             cxt;
+  std::vector<Decl*>   decls;  // Loaded declarations, by index
+  std::vector<Type*>   types;  // Loaded types, by index
+  Decl_list            order;  // Loaded declarations, in order
+
+  // The overload sets of names looked up in this module.
+  std::unordered_map<String, Overload_set> sets;
+};
+
+
+Overload_set* import_lookup(Context&, Name const&);
+
+
+} // namespace banjo
+
+
+#endif
@@ -248,14 +248,14 @@ Parser::variable_declaration()
 Type&
 Parser::unparsed_variable_type()
 {
-  Token_seq toks;
+  Token_cursor::Position first = tokens.position();
   Brace_matching_sentinel is_non_nested(*this);
   while (!is_eof()) {
     if (next_token_is_one_of(semicolon_tok, eq_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  return on_unparsed_type(std::move(toks));
+  return on_unparsed_type(tokens_since(first));
 }
 
 
@@ -263,14 +263,14 @@ Parser::unparsed_variable_type()
 Expr&
 Parser::unparsed_variable_initializer()
 {
-  Token_seq toks;
+  Token_cursor::Position first = tokens.position();
   Brace_matching_sentinel is_non_nested(*this);
   while (!is_eof()) {
     if (next_token_is(semicolon_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  return on_unparsed_expression(std::move(toks));
+  return on_unparsed_expression(tokens_since(first));
 }
 
 
@@ -519,14 +519,14 @@ Parser::parameter_declaration()
 Type&
 Parser::unparsed_parameter_type()
 {
-  Token_seq toks;
+  Token_cursor::Position first = tokens.position();
   Brace_matching_sentinel is_non_nested(*this);
   while (true) {
     if (next_token_is_one_of(comma_tok, rparen_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  return on_unparsed_type(std::move(toks));
+  return on_unparsed_type(tokens_since(first));
 }
 
 
@@ -534,14 +534,14 @@ Parser::unparsed_parameter_type()
 Type&
 Parser::unparsed_return_type()
 {
-  Token_seq toks;
+  Token_cursor::Position first = tokens.position();
   Brace_matching_sentinel is_non_nested(*this);
   while (!is_eof()) {
     if (next_token_is_one_of(lbrace_tok, eq_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  return on_unparsed_type(std::move(toks));
+  return on_unparsed_type(tokens_since(first));
 }
 
 
@@ -549,14 +549,14 @@ Parser::unparsed_return_type()
 Expr&
 Parser::unparsed_expression_body()
 {
-  Token_seq toks;
+  Token_cursor::Position first = tokens.position();
   Brace_matching_sentinel is_non_nested(*this);
   while (!is_eof()) {
     if (next_token_is(semicolon_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  return on_unparsed_expression(std::move(toks));
+  return on_unparsed_expression(tokens_since(first));
 }
 
 
@@ -568,16 +568,16 @@ Parser::unparsed_expression_body()
 Stmt&
 Parser::unparsed_function_body()
 {
-  Token_seq toks;
-  toks.push_back(match(lbrace_tok));
+  Token_cursor::Position first = tokens.position();
+  match(lbrace_tok);
   Brace_matching_sentinel is_non_nested(*this);
   while (!is_eof()) {
     if (next_token_is(rbrace_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  toks.push_back(match(rbrace_tok));
-  return on_unparsed_statement(std::move(toks));
+  match(rbrace_tok);
+  return on_unparsed_statement(tokens_since(first));
 }
 
 
@@ -647,13 +647,13 @@ Parser::class_declaration()
 Type&
 Parser::unparsed_class_kind()
 {
-  Token_seq toks;
+  Token_cursor::Position first = tokens.position();
   while (!is_eof()) {
     if (next_token_is_one_of(lbrace_tok) && !in_braces())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  return on_unparsed_type(std::move(toks));
+  return on_unparsed_type(tokens_since(first));
 }
 
 
@@ -665,16 +665,16 @@ Parser::unparsed_class_kind()
 Stmt&
 Parser::unparsed_class_body()
 {
-  Token_seq toks;
-  toks.push_back(match(lbrace_tok));
+  Token_cursor::Position first = tokens.position();
+  match(lbrace_tok);
   Brace_matching_sentinel is_non_nested(*this);
   while (!is_eof()) {
     if (next_token_is(rbrace_tok) && is_non_nested())
       break;
-    toks.push_back(accept());
+    accept();
   }
-  toks.push_back(match(rbrace_tok));
-  return on_unparsed_statement(std::move(toks));
+  match(rbrace_tok);
+  return on_unparsed_statement(tokens_since(first));
 }
 
 
@@ -21,254 +21,180 @@ Parser::expression()
 }
 
 
-// Parse a logical-or expression.
+// -------------------------------------------------------------------------- //
+// Binary expressions
+//
+// The binary expressions are parsed by precedence climbing, driven by a
+// table that maps each binary operator token to its precedence and
+// the semantic action that builds the expression. All of the binary
+// operators are left-associative. This replaces a chain of one function per precedence level, so that
+// parsing an operand does not descend through every level of the
+// grammar, and each token is classified by a single table lookup.
+//
+// The grammar is, from lowest to highest precedence:
 //
 //    logical-or-expression:
 //      logical-and-expression
 //      logical-or-expression '||' logical-and-expression
-Expr&
-Parser::logical_or_expression()
-{
-  Expr* e1 = &logical_and_expression();
-  while (true) {
-    if (Token tok = match_if(bar_bar_tok)) {
-      Expr& e2 = logical_and_expression();
-      e1 = &on_logical_or_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
-}
-
-
-// Parse a logical-and expression.
 //
 //    logical-and-expression:
 //      inclusive-or-expression
 //      logical-and-expression '&&' inclusive-or-expression
 //
-Expr&
-Parser::logical_and_expression()
-{
-  Expr* e1 = &inclusive_or_expression();
-  while (true) {
-    if (Token tok = match_if(amp_amp_tok)) {
-      Expr& e2 = inclusive_or_expression();
-      e1 = &on_logical_and_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
-}
-
-
-// Parse a bitwise inclusive-or expression.
-//
 //    inclusive-or-expression:
 //      exclusive-or-expression
 //      inclusive-or-expression '|' exclusive-or-expression
 //
-// FIXME: This skips the bitwise expressions.
-Expr&
-Parser::inclusive_or_expression()
-{
-  Expr* e1 = &exclusive_or_expression();
-  while (true) {
-    if (Token tok = match_if(bar_tok)) {
-      Expr& e2 = exclusive_or_expression();
-      e1 = &on_or_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
-}
-
-
-// Parse a bitwise exclusive-or expression.
-//
 //    exclusive-or-expression:
 //      and-expression
 //      exclusive-or-expression '^' and-expression
 //
-Expr&
-Parser::exclusive_or_expression()
-{
-  Expr* e1 = &and_expression();
-  while (true) {
-    if (Token tok = match_if(caret_tok)) {
-      Expr& e2 = and_expression();
-      e1 = &on_xor_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
-}
-
-
-// Parse a bitwise and expression.
-//
-//    exclusive-or-expression:
+//    and-expression:
 //      equality-expression
-//      exclusive-or-expression '&' equality-expression
-//
-Expr&
-Parser::and_expression()
-{
-  Expr* e1 = &equality_expression();
-  while (true) {
-    if (Token tok = match_if(amp_tok)) {
-      Expr& e2 = equality_expression();
-      e1 = &on_and_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
-}
-
-
-// Parse an equality expression.
+//      and-expression '&' equality-expression
 //
 //    equality-expression:
-//      relational-expression:
+//      relational-expression
 //      equality-expression '==' relational-expression
 //      equality-expression '!=' relational-expression
-Expr&
-Parser::equality_expression()
-{
-  Expr* e1 = &relational_expression();
-  while (true) {
-    if (Token tok = match_if(eq_eq_tok)) {
-      Expr& e2 = relational_expression();
-      e1 = &on_eq_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(bang_eq_tok)) {
-      Expr& e2 = relational_expression();
-      e1 = &on_ne_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
-}
-
-
-// Parse a relational expression.
 //
 //    relational-expression:
-//      shift-expression:
+//      shift-expression
 //      relational-expression '<' shift-expression
 //      relational-expression '>' shift-expression
 //      relational-expression '<=' shift-expression
 //      relational-expression '>=' shift-expression
 //      relational-expression '<=>' shift-expression
-Expr&
-Parser::relational_expression()
+//
+//    shift-expression:
+//      additive-expression
+//      shift-expression '<<' additive-expression
+//      shift-expression '>>' additive-expression
+//
+//    additive-expression:
+//      multiplicative-expression
+//      additive-expression '+' multiplicative-expression
+//      additive-expression '-' multiplicative-expression
+//
+//    multiplicative-expression:
+//      unary-expression
+//      multiplicative-expression '*' unary-expression
+//      multiplicative-expression '/' unary-expression
+//      multiplicative-expression '%' unary-expression
+
+namespace
 {
-  Expr* e1 = &shift_expression();
-  while (true) {
-    if (Token tok = match_if(lt_tok)) {
-      Expr& e2 = shift_expression();
-      e1 = &on_lt_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(gt_tok)) {
-      Expr& e2 = shift_expression();
-      e1 = &on_gt_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(lt_eq_tok)) {
-      Expr& e2 = shift_expression();
-      e1 = &on_le_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(gt_eq_tok)) {
-      Expr& e2 = shift_expression();
-      e1 = &on_ge_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(lt_eq_gt_tok)) {
-      Expr& e2 = shift_expression();
-      e1 = &on_cmp_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
+
+// Precedence levels of binary operators. A precedence of 0 indicates
+// that a token is not a binary operator.
+enum Precedence
+{
+  no_prec,
+  logical_or_prec,
+  logical_and_prec,
+  inclusive_or_prec,
+  exclusive_or_prec,
+  and_prec,
+  equality_prec,
+  relational_prec,
+  shift_prec,
+  additive_prec,
+  multiplicative_prec,
+};
+
+
+// Describes the parsing of a binary operator.
+struct Binary_operator
+{
+  using Action = Expr& (Parser::*)(Token, Expr&, Expr&);
+
+  int    prec;
+  Action action;
+};
+
+
+// The table of binary operators, indexed by token kind.
+struct Binary_operator_table
+{
+  static constexpr int size = integer_tok + 1;
+
+  Binary_operator_table();
+
+  void put(Token_kind k, int p, Binary_operator::Action a)
+  {
+    ops[k] = {p, a};
   }
-  return *e1;
+
+  Binary_operator const& operator[](Token_kind k) const
+  {
+    static Binary_operator none {no_prec, nullptr};
+    if (0 <= k && k < size)
+      return ops[k];
+    return none;
+  }
+
+  Binary_operator ops[size];
+};
+
+
+Binary_operator_table::Binary_operator_table()
+  : ops()
+{
+  put(bar_bar_tok,  logical_or_prec,     &Parser::on_logical_or_expression);
+  put(amp_amp_tok,  logical_and_prec,    &Parser::on_logical_and_expression);
+  put(bar_tok,      inclusive_or_prec,   &Parser::on_or_expression);
+  put(caret_tok,    exclusive_or_prec,   &Parser::on_xor_expression);
+  put(amp_tok,      and_prec,            &Parser::on_and_expression);
+  put(eq_eq_tok,    equality_prec,       &Parser::on_eq_expression);
+  put(bang_eq_tok,  equality_prec,       &Parser::on_ne_expression);
+  put(lt_tok,       relational_prec,     &Parser::on_lt_expression);
+  put(gt_tok,       relational_prec,     &Parser::on_gt_expression);
+  put(lt_eq_tok,    relational_prec,     &Parser::on_le_expression);
+  put(gt_eq_tok,    relational_prec,     &Parser::on_ge_expression);
+  put(lt_eq_gt_tok, relational_prec,     &Parser::on_cmp_expression);
+  put(lt_lt_tok,    shift_prec,          &Parser::on_lsh_expression);
+  put(gt_gt_tok,    shift_prec,          &Parser::on_rsh_expression);
+  put(plus_tok,     additive_prec,       &Parser::on_add_expression);
+  put(minus_tok,    additive_prec,       &Parser::on_sub_expression);
+  put(star_tok,     multiplicative_prec, &Parser::on_mul_expression);
+  put(slash_tok,    multiplicative_prec, &Parser::on_div_expression);
+  put(percent_tok,  multiplicative_prec, &Parser::on_rem_expression);
 }
 
 
-// Parse a shift expression.
-//
-//    shift-expression:
-//      additive_expression:
-//      shift-expression '<<' additive_expression
-//      shift-expression '>>' additive_expression
-//
-Expr&
-Parser::shift_expression()
+inline Binary_operator const&
+get_binary_operator(Token_kind k)
 {
-  Expr* e1 = &additive_expression();
-  while (true) {
-    if (Token tok = match_if(lt_lt_tok)) {
-      Expr& e2 = additive_expression();
-      e1 = &on_lsh_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(gt_gt_tok)) {
-      Expr& e2 = additive_expression();
-      e1 = &on_rsh_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
+  static Binary_operator_table tab;
+  return tab[k];
 }
 
+} // namespace
 
-// Parse an additive expression.
-//
-//    additive-expression:
-//      multiplicative-expression:
-//      additive-expression '+' multiplicative-expression
-//      additive-expression '-' multiplicative-expression
+
+// Parse a logical-or expression. This is the lowest precedence
+// binary expression.
 Expr&
-Parser::additive_expression()
+Parser::logical_or_expression()
 {
-  Expr* e1 = &multiplicative_expression();
-  while (true) {
-    if (Token tok = match_if(plus_tok)) {
-      Expr& e2 = multiplicative_expression();
-      e1 = &on_add_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(minus_tok)) {
-      Expr& e2 = unary_expression();
-      e1 = &on_sub_expression(tok, *e1, e2);
-    } else {
-      break;
-    }
-  }
-  return *e1;
+  return binary_expression(logical_or_prec);
 }
 
 
-// Parse a multiplicative expression.
-//
-//    multiplicative-expression:
-//      unary-expression:
-//      multiplicative-expression '*' unary-expression
-//      multiplicative-expression '/' unary-expression
-//      multiplicative-expression '%' unary-expression
+// Parse a binary expression whose operators have a precedence of at
+// least `min`. All binary operators are left-associative, so the right
+// operand of an operator is parsed at the next higher precedence.
 Expr&
-Parser::multiplicative_expression()
+Parser::binary_expression(int min)
 {
   Expr* e1 = &unary_expression();
   while (true) {
-    // Use a switch?
-    if (Token tok = match_if(star_tok)) {
-      Expr& e2 = unary_expression();
-      e1 = &on_mul_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(slash_tok)) {
-      Expr& e2 = unary_expression();
-      e1 = &on_div_expression(tok, *e1, e2);
-    } else if (Token tok = match_if(percent_tok)) {
-      Expr& e2 = unary_expression();
-      e1 = &on_rem_expression(tok, *e1, e2);
-    } else {
+    Binary_operator const& op = get_binary_operator(lookahead());
+    if (op.prec < min || op.prec == no_prec)
       break;
-    }
+    Token tok = accept();
+    Expr& e2 = binary_expression(op.prec + 1);
+    e1 = &(this->*op.action)(tok, *e1, e2);
   }
   return *e1;
 }
@@ -357,13 +283,18 @@ Parser::dot_expression(Expr& e)
 }
 
 
+// Parse a subscript expression. This is a subroutine of the postfix
+// expression parser.
+//
+//    postfix-expression:
+//      postfix-expression '[' expression ']'
 Expr&
 Parser::subscript_expression(Expr& e)
 {
   require(lbracket_tok);
-  // Expr& index = expression();
+  Expr& i = expression();
   match(rbracket_tok);
-  lingo_unreachable();
+  return on_index_expression(e, i);
 }
 
 
@@ -3,6 +3,7 @@
 
 #include "parser.hpp"
 #include "ast.hpp"
+#include "report.hpp"
 
 #include <iostream>
 
@@ -17,7 +18,7 @@ namespace
 // stream is at the end of input, then the spelling will
 // reflect that state.
 String const&
-token_spelling(Token_stream& ts)
+token_spelling(Token_cursor const& ts)
 {
   static String end = "end-of-input";
   if (ts.eof())
@@ -53,11 +54,12 @@ Parser::peek() const
 }
 
 
-// Returns the first token of lookahead.
+// Returns the first token of lookahead. Note that this reads only the
+// kind of the token; the full token is not reconstructed.
 Token_kind
 Parser::lookahead() const
 {
-  return Token_kind(peek().kind());
+  return tokens.kind();
 }
 
 
@@ -65,7 +67,7 @@ Parser::lookahead() const
 Token_kind
 Parser::lookahead(int n) const
 {
-  return Token_kind(tokens.peek(n).kind());
+  return tokens.kind(n);
 }
 
 
@@ -199,6 +201,14 @@ Parser::accept()
 }
 
 
+// Returns the tokens accepted since the cursor was at position `p`.
+Token_range
+Parser::tokens_since(Token_cursor::Position p) const
+{
+  return Token_range(*tokens.buf, p, tokens.position());
+}
+
+
 void
 Parser::open_brace(Token tok)
 {
@@ -315,6 +325,7 @@ Parser::translation()
 Stmt&
 Parser::operator()()
 {
+  Phase_timer timer(parsing_phase);
   return translation();
 }
 
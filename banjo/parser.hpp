@@ -30,7 +30,12 @@ struct Parser
 {
   using Specs = Specifier_set; // For brevity
 
-  Parser(Context& cxt, Token_stream& ts)
+  Parser(Context& cxt, Token_buffer const& ts)
+    : cxt(cxt), build(cxt), tokens(ts), state()
+  { }
+
+  // Parse the tokens of an unparsed term.
+  Parser(Context& cxt, Token_range const& ts)
     : cxt(cxt), build(cxt), tokens(ts), state()
   { }
 
@@ -86,15 +91,7 @@ struct Parser
   // Expressions
   Expr& expression();
   Expr& logical_or_expression();
-  Expr& logical_and_expression();
-  Expr& inclusive_or_expression();
-  Expr& exclusive_or_expression();
-  Expr& and_expression();
-  Expr& equality_expression();
-  Expr& relational_expression();
-  Expr& shift_expression();
-  Expr& additive_expression();
-  Expr& multiplicative_expression();
+  Expr& binary_expression(int);
   Expr& unary_expression();
   Expr& postfix_expression();
   Expr& call_expression(Expr&);
@@ -262,7 +259,7 @@ struct Parser
   Type& on_volatile_type(Type&);
   Type& on_reference_type(Type&);
   Type& on_pack_type(Type&);
-  Type& on_unparsed_type(Token_seq&&);
+  Type& on_unparsed_type(Token_range const&);
   Type& on_array_type(Type&, Expr&);
   Type& on_tuple_type(Type_list&);
   Type& on_dynarray_type(Type&, Expr&);
@@ -292,6 +289,7 @@ struct Parser
   Expr& on_neg_expression(Token, Expr&);
   Expr& on_pos_expression(Token, Expr&);
   Expr& on_call_expression(Expr&, Expr_list&);
+  Expr& on_index_expression(Expr&, Expr&);
   Expr& on_tuple_expression(Expr_list&);
   Expr& on_dot_expression(Expr&, Name&);
   Expr& on_id_expression(Name&);
@@ -299,7 +297,7 @@ struct Parser
   Expr& on_integer_literal(Token);
   Expr& on_requires_expression(Token, Decl_list&, Decl_list&, Req_list&);
 
-  Expr& on_unparsed_expression(Token_seq&&);
+  Expr& on_unparsed_expression(Token_range const&);
 
   // Statements
   Stmt& on_translation_statement(Stmt_list&&);
@@ -317,7 +315,7 @@ struct Parser
   Stmt& on_continue_statement();
   Stmt& on_declaration_statement(Decl&);
   Stmt& on_expression_statement(Expr&);
-  Stmt& on_unparsed_statement(Token_seq&&);
+  Stmt& on_unparsed_statement(Token_range const&);
   void on_statement_seq(Stmt_list&);
 
   // Super declarations
@@ -385,6 +383,7 @@ struct Parser
   Token      require(char const*);
   void       expect(Token_kind);
   Token      accept();
+  Token_range tokens_since(Token_cursor::Position) const;
 
   template<typename... Kinds>
   bool next_token_is_one_of(Token_kind, Kinds...);
@@ -433,7 +432,7 @@ struct Parser
 
   Context&      cxt;
   Builder       build;
-  Token_stream& tokens;
+  Token_cursor  tokens;
   State         state;
 };
 
@@ -475,7 +474,7 @@ Parser::take_decl_specs()
 // an explicit indication of failure?
 struct Trial_parser
 {
-  using Position = Token_stream::Position;
+  using Position = Token_cursor::Position;
   using State = Parser::State;
 
   Trial_parser(Parser& p)
@@ -104,11 +104,11 @@ Printer::token(Integer const& n)
 
 
 void
-Printer::tokens(Token_seq const& toks)
+Printer::tokens(Token_range const& toks)
 {
-  for (auto iter = toks.begin(); iter != toks.end(); ++iter) {
-    token(*iter);
-    if (std::next(iter) != toks.end())
+  for (std::size_t i = toks.first; i != toks.last; ++i) {
+    token(toks.buf->token(i));
+    if (i + 1 != toks.last)
       space();
   }
 }
@@ -826,6 +826,7 @@ Printer::postfix_expression(Expr const& e)
     void operator()(Expr const& e)               { p.primary_expression(e); }
     void operator()(Dot_expr const& e)           { p.postfix_expression(e); }
     void operator()(Call_expr const& e)          { p.postfix_expression(e); }
+    void operator()(Index_expr const& e)         { p.postfix_expression(e); }
     void operator()(Tuple_expr const& e)         { p.postfix_expression(e); }
     void operator()(Value_conv const& e)         { p.postfix_expression(e); }
     void operator()(Qualification_conv const& e) { p.postfix_expression(e); }
@@ -833,6 +834,7 @@ Printer::postfix_expression(Expr const& e)
     void operator()(Integer_conv const& e)       { p.postfix_expression(e); }
     void operator()(Float_conv const& e)         { p.postfix_expression(e); }
     void operator()(Numeric_conv const& e)       { p.postfix_expression(e); }
+    void operator()(Slice_conv const& e)         { p.postfix_expression(e); }
     void operator()(Dependent_conv const& e)     { p.postfix_expression(e); }
     void operator()(Ellipsis_conv const& e)      { p.postfix_expression(e); }
   };
@@ -866,6 +868,16 @@ Printer::postfix_expression(Call_expr const& e)
 }
 
 
+void
+Printer::postfix_expression(Index_expr const& e)
+{
+  postfix_expression(e.object());
+  token(lbracket_tok);
+  expression(e.index());
+  token(rbracket_tok);
+}
+
+
 void
 Printer::postfix_expression(Tuple_expr const& e)
 {
@@ -941,6 +953,16 @@ Printer::postfix_expression(Numeric_conv const& e)
 }
 
 
+void
+Printer::postfix_expression(Slice_conv const& e)
+{
+  token("__convert_to_slice");
+  token(lparen_tok);
+  expression(e.source());
+  token(rparen_tok);
+}
+
+
 void
 Printer::postfix_expression(Dependent_conv const& e)
 {
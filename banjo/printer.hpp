@@ -40,7 +40,7 @@ struct Printer
   void token(String const&);
   void token(int);
   void token(Integer const&);
-  void tokens(Token_seq const&);
+  void tokens(Token_range const&);
 
   void binary_operator(Token_kind);
 
@@ -102,7 +102,8 @@ struct Printer
   void multiplicative_expression(Expr const&);
   void unary_expression(Expr const&);
   void postfix_expression(Expr const&);
-  void postfix_expression(Call_expr const&);  
+  void postfix_expression(Call_expr const&);
+  void postfix_expression(Index_expr const&);  
   void postfix_expression(Tuple_expr const&);
   void postfix_expression(Dot_expr const&);
   void postfix_expression(Value_conv const&);
@@ -111,6 +112,7 @@ struct Printer
   void postfix_expression(Integer_conv const&);
   void postfix_expression(Float_conv const&);
   void postfix_expression(Numeric_conv const&);
+  void postfix_expression(Slice_conv const&);
   void postfix_expression(Dependent_conv const&);
   void postfix_expression(Ellipsis_conv const&);
   void subscript_expression(Expr const&);
@@ -0,0 +1,240 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "report.hpp"
+#include "file.hpp"
+
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+
+
+namespace banjo
+{
+
+namespace
+{
+
+// Allocation counters. These are updated by operator new, which may be
+// called by any thread, and before any other static initialization, so
+// they are atomic and constant-initialized.
+std::atomic<bool>        counting(false);
+std::atomic<int>         alloc_phase(driver_phase);
+std::atomic<std::size_t> alloc_count[phase_count];
+std::atomic<std::size_t> alloc_bytes[phase_count];
+
+
+char const* phase_names[] = {
+  "driver",
+  "lexing",
+  "parsing",
+  "declarations",
+  "overloads",
+  "definitions",
+  "constraints",
+  "evaluation",
+  "codegen",
+  "output",
+};
+
+} // namespace
+
+
+char const*
+get_phase_name(Phase p)
+{
+  return phase_names[p];
+}
+
+
+// Start collecting statistics. This must be called before any threads
+// are created.
+void
+Phase_report::start(bool time, bool mem)
+{
+  timing = time;
+  memory = mem;
+  counting.store(mem, std::memory_order_relaxed);
+  mark = Clock::now();
+  ++entries[current];
+}
+
+
+// Charge the remaining time to the current phase, and stop counting
+// allocations.
+void
+Phase_report::stop()
+{
+  charge();
+  counting.store(false, std::memory_order_relaxed);
+}
+
+
+// Enter the phase `p`, returning the phase to be restored when it is
+// left.
+Phase
+Phase_report::enter(Phase p)
+{
+  if (!enabled())
+    return current;
+  charge();
+  Phase prev = current;
+  current = p;
+  ++entries[p];
+  alloc_phase.store(p, std::memory_order_relaxed);
+  return prev;
+}
+
+
+void
+Phase_report::leave(Phase p)
+{
+  if (!enabled())
+    return;
+  charge();
+  current = p;
+  alloc_phase.store(p, std::memory_order_relaxed);
+}
+
+
+// Charge the time elapsed since the last charge to the current phase.
+void
+Phase_report::charge()
+{
+  if (!timing)
+    return;
+  Clock::time_point now = Clock::now();
+  seconds[current] += std::chrono::duration<double>(now - mark).count();
+  mark = now;
+}
+
+
+void
+Phase_report::print(std::ostream& os, Report_format f) const
+{
+  if (f == json_report)
+    print_json(os);
+  else
+    print_table(os);
+}
+
+
+// Print a row for each phase that was entered, followed by the totals.
+void
+Phase_report::print_table(std::ostream& os) const
+{
+  double total_time = 0;
+  std::size_t total_count = 0;
+  std::size_t total_bytes = 0;
+  std::size_t total_entries = 0;
+  for (int i = 0; i < phase_count; ++i) {
+    total_time += seconds[i];
+    total_entries += entries[i];
+    total_count += alloc_count[i];
+    total_bytes += alloc_bytes[i];
+  }
+
+  char line[128];
+  auto row = [&](char const* name, double secs, std::size_t n, std::size_t count, std::size_t bytes) {
+    int k = std::snprintf(line, sizeof(line), "%-14s %8zu", name, n);
+    if (timing) {
+      double pct = total_time > 0 ? 100 * secs / total_time : 0;
+      k += std::snprintf(line + k, sizeof(line) - k, " %10.4f %6.1f%%", secs, pct);
+    }
+    if (memory)
+      std::snprintf(line + k, sizeof(line) - k, " %10zu %14zu", count, bytes);
+    os << line << '\n';
+  };
+
+  int k = std::snprintf(line, sizeof(line), "%-14s %8s", "phase", "entries");
+  if (timing)
+    k += std::snprintf(line + k, sizeof(line) - k, " %10s %7s", "time (s)", "%");
+  if (memory)
+    std::snprintf(line + k, sizeof(line) - k, " %10s %14s", "allocs", "bytes");
+  os << line << '\n';
+  for (int i = 0; i < phase_count; ++i) {
+    if (entries[i])
+      row(phase_names[i], seconds[i], entries[i], alloc_count[i], alloc_bytes[i]);
+  }
+  row("total", total_time, total_entries, total_count, total_bytes);
+  if (memory)
+    os << "peak resident set size: " << peak_resident_set_size() << " KiB\n";
+}
+
+
+// Print the report as a JSON object.
+//
+//    { "phases": [ { "name": ..., "entries": ..., "seconds": ...,
+//                    "allocations": ..., "bytes": ... }, ... ],
+//      "peak_rss_kib": ... }
+//
+// The time and memory fields are present only when requested.
+void
+Phase_report::print_json(std::ostream& os) const
+{
+  os << "{\"phases\": [";
+  bool first = true;
+  for (int i = 0; i < phase_count; ++i) {
+    if (!entries[i])
+      continue;
+    if (!first)
+      os << ", ";
+    first = false;
+    os << "{\"name\": \"" << phase_names[i] << "\", "
+       << "\"entries\": " << entries[i];
+    if (timing)
+      os << ", \"seconds\": " << seconds[i];
+    if (memory)
+      os << ", \"allocations\": " << alloc_count[i]
+         << ", \"bytes\": " << alloc_bytes[i];
+    os << '}';
+  }
+  os << ']';
+  if (memory)
+    os << ", \"peak_rss_kib\": " << peak_resident_set_size();
+  os << "}\n";
+}
+
+
+Phase_report&
+phase_report()
+{
+  static Phase_report report;
+  return report;
+}
+
+
+} // namespace banjo
+
+
+// Count allocations when a memory report is requested. The remaining
+// forms of operator new and delete are implemented in terms of these.
+void*
+operator new(std::size_t n)
+{
+  using namespace banjo;
+  if (counting.load(std::memory_order_relaxed)) {
+    int p = alloc_phase.load(std::memory_order_relaxed);
+    alloc_count[p].fetch_add(1, std::memory_order_relaxed);
+    alloc_bytes[p].fetch_add(n, std::memory_order_relaxed);
+  }
+  if (n == 0)
+    n = 1;
+  while (true) {
+    if (void* p = std::malloc(n))
+      return p;
+    std::new_handler h = std::get_new_handler();
+    if (!h)
+      throw std::bad_alloc();
+    h();
+  }
+}
+
+
+void
+operator delete(void* p) noexcept
+{
+  std::free(p);
+}
@@ -0,0 +1,109 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_REPORT_HPP
+#define BANJO_REPORT_HPP
+
+// This module provides reports of the time and memory used by each
+// phase of compilation.
+//
+// A phase is entered by creating a Phase_timer, and left when the timer
+// is destroyed. Phases nest, and time is charged to the innermost
+// phase: time spent evaluating a constant expression while elaborating
+// a definition is charged to evaluation, not elaboration. Allocations
+// made by any thread are charged to the phase of the main thread.
+//
+// When no report is requested, entering or leaving a phase is a single
+// test, and each allocation is one more.
+
+#include "prelude.hpp"
+
+#include <chrono>
+#include <iosfwd>
+
+
+namespace banjo
+{
+
+// The phases of compilation.
+enum Phase
+{
+  driver_phase,      // Work that is not part of another phase
+  lexing_phase,      // Lexical analysis
+  parsing_phase,     // Syntactic analysis
+  declaration_phase, // Elaboration of declared types
+  overload_phase,    // Elaboration of overload sets
+  definition_phase,  // Elaboration of definitions
+  constraint_phase,  // Checking constraints
+  evaluation_phase,  // Constant evaluation
+  codegen_phase,     // Code generation
+  output_phase,      // Optimization and writing output
+  phase_count
+};
+
+
+char const* get_phase_name(Phase);
+
+
+// The kinds of report output.
+enum Report_format
+{
+  table_report, // A table for people
+  json_report,  // A JSON object for tools
+};
+
+
+// Accumulates the statistics of each phase.
+struct Phase_report
+{
+  using Clock = std::chrono::steady_clock;
+
+  Phase_report()
+    : timing(false), memory(false), current(driver_phase)
+  { }
+
+  bool enabled() const { return timing || memory; }
+
+  void start(bool, bool);
+  void stop();
+
+  Phase enter(Phase);
+  void  leave(Phase);
+  void  charge();
+
+  void print(std::ostream&, Report_format) const;
+  void print_table(std::ostream&) const;
+  void print_json(std::ostream&) const;
+
+  bool              timing;  // Measure time in each phase
+  bool              memory;  // Count allocations in each phase
+  Phase             current; // The innermost phase
+  Clock::time_point mark;    // When time was last charged
+  double            seconds[phase_count] = {};
+  std::size_t       entries[phase_count] = {};
+};
+
+
+Phase_report& phase_report();
+
+
+// An RAII class that enters a phase of compilation.
+struct Phase_timer
+{
+  Phase_timer(Phase p)
+    : prev(phase_report().enter(p))
+  { }
+
+  ~Phase_timer()
+  {
+    phase_report().leave(prev);
+  }
+
+  Phase prev;
+};
+
+
+} // namespace banjo
+
+
+#endif
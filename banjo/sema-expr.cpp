@@ -183,6 +183,13 @@ Parser::on_call_expression(Expr& e, Expr_list& es)
 }
 
 
+Expr&
+Parser::on_index_expression(Expr& e, Expr& i)
+{
+  return make_index(cxt, e, i);
+}
+
+
 // TODO: This is going to be non-trivial.
 Expr&
 Parser::on_tuple_expression(Expr_list& es)
@@ -231,10 +238,10 @@ Parser::on_requires_expression(Token tok, Decl_list& tps, Decl_list& ps, Req_lis
 
 
 Expr&
-Parser::on_unparsed_expression(Token_seq&& toks)
+Parser::on_unparsed_expression(Token_range const& toks)
 {
   // FIXME: Use a factory method.
-  return *new Unparsed_expr(std::move(toks));
+  return *new Unparsed_expr(toks);
 }
 
 
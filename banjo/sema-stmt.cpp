@@ -3,6 +3,7 @@
 
 #include "parser.hpp"
 #include "ast-stmt.hpp"
+#include "report.hpp"
 
 namespace banjo
 {
@@ -100,10 +101,10 @@ Parser::on_expression_statement(Expr& d)
 
 
 Stmt&
-Parser::on_unparsed_statement(Token_seq&& toks)
+Parser::on_unparsed_statement(Token_range const& toks)
 {
   // FIXME: Use the builder.
-  return *new Unparsed_stmt(std::move(toks));
+  return *new Unparsed_stmt(toks);
 }
 
 
@@ -115,12 +116,19 @@ void
 Parser::on_statement_seq(Stmt_list& ss)
 {
   // Second pass: Resolve declared types.
-  elaborate_declarations(ss);
+  {
+    Phase_timer timer(declaration_phase);
+    elaborate_declarations(ss);
+  }
 
-  elaborate_partials(ss);
-  elaborate_overloads(ss);
+  {
+    Phase_timer timer(overload_phase);
+    elaborate_partials(ss);
+    elaborate_overloads(ss);
+  }
 
   // Third pass: Resolve definitions.
+  Phase_timer timer(definition_phase);
   elaborate_definitions(ss);
 }
 
@@ -128,10 +128,10 @@ Parser::on_pack_type(Type& t)
 
 
 Type&
-Parser::on_unparsed_type(Token_seq&& toks)
+Parser::on_unparsed_type(Token_range const& toks)
 {
   // FIXME: Use a factory method.
-  return *new Unparsed_type(std::move(toks));
+  return *new Unparsed_type(toks);
 }
 
 
@@ -0,0 +1,420 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "server.hpp"
+#include "prelude.hpp"
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unordered_map>
+#include <vector>
+
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+
+
+namespace banjo
+{
+
+namespace
+{
+
+// The number of seconds a client has to send its request.
+constexpr int request_timeout = 10;
+
+
+// Set by a signal that stops the server.
+volatile std::sig_atomic_t stopping = 0;
+
+
+// A pipe that is written when a signal arrives, waking the server
+// from poll. The write end is used by signal handlers.
+int wake[2] = {-1, -1};
+
+
+void
+on_signal(int sig)
+{
+  int saved = errno;
+  if (sig != SIGCHLD)
+    stopping = 1;
+  char c = 0;
+  (void)::write(wake[1], &c, 1);
+  errno = saved;
+}
+
+
+[[noreturn]] void
+server_error(char const* what, String const& path)
+{
+  throw Translation_error("cannot {} '{}': {}", what, path, std::strerror(errno));
+}
+
+
+// Read exactly `n` bytes from the socket `fd`.
+bool
+receive_all(int fd, void* p, std::size_t n)
+{
+  char* s = static_cast<char*>(p);
+  while (n) {
+    ssize_t k = ::recv(fd, s, n, 0);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    s += k;
+    n -= k;
+  }
+  return true;
+}
+
+
+// Write exactly `n` bytes to the socket `fd`. A client that has gone
+// away does not raise SIGPIPE.
+bool
+send_all(int fd, void const* p, std::size_t n)
+{
+  char const* s = static_cast<char const*>(p);
+  while (n) {
+    ssize_t k = ::send(fd, s, n, MSG_NOSIGNAL);
+    if (k < 0 && errno == EINTR)
+      continue;
+    if (k <= 0)
+      return false;
+    s += k;
+    n -= k;
+  }
+  return true;
+}
+
+
+// Returns true if the peer of the connection `conn` runs as the same
+// user as the server.
+bool
+same_user(int conn)
+{
+  ucred cred;
+  socklen_t len = sizeof(cred);
+  if (::getsockopt(conn, SOL_SOCKET, SO_PEERCRED, &cred, &len) != 0)
+    return false;
+  return cred.uid == ::geteuid();
+}
+
+
+// A request received from a client.
+struct Request
+{
+  Request()
+  {
+    for (int& fd : fds)
+      fd = -1;
+  }
+
+  ~Request()
+  {
+    close();
+  }
+
+  void close()
+  {
+    for (int& fd : fds) {
+      if (fd >= 0)
+        ::close(fd);
+      fd = -1;
+    }
+  }
+
+  bool receive(int);
+
+  int               fds[request_fds];
+  std::vector<char> payload;
+};
+
+
+// Receive a request from the connection `conn`. The descriptors arrive
+// with the first bytes of the length.
+bool
+Request::receive(int conn)
+{
+  std::uint32_t len;
+  iovec iov {&len, sizeof(len)};
+  union {
+    cmsghdr hdr;
+    char    buf[CMSG_SPACE(sizeof(int) * request_fds)];
+  } ctl;
+  msghdr msg {};
+  msg.msg_iov = &iov;
+  msg.msg_iovlen = 1;
+  msg.msg_control = ctl.buf;
+  msg.msg_controllen = sizeof(ctl.buf);
+  ssize_t n;
+  do
+    n = ::recvmsg(conn, &msg, 0);
+  while (n < 0 && errno == EINTR);
+  if (n <= 0)
+    return false;
+
+  cmsghdr* c = CMSG_FIRSTHDR(&msg);
+  if (!c || c->cmsg_level != SOL_SOCKET || c->cmsg_type != SCM_RIGHTS)
+    return false;
+  std::size_t nfds = (c->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+  std::memcpy(fds, CMSG_DATA(c), std::min<std::size_t>(nfds, request_fds) * sizeof(int));
+  if (nfds != request_fds || (msg.msg_flags & MSG_CTRUNC))
+    return false;
+
+  // The rest of the length may arrive separately.
+  char* rest = reinterpret_cast<char*>(&len) + n;
+  if (n < ssize_t(sizeof(len)) && !receive_all(conn, rest, sizeof(len) - n))
+    return false;
+  if (len == 0 || len > max_request_size)
+    return false;
+  payload.resize(len);
+  if (!receive_all(conn, payload.data(), len))
+    return false;
+  return payload.back() == '\0';
+}
+
+
+// The compile server. Running compilations are indexed by the process
+// id of the child serving them, and map to the connection on which the
+// exit status is sent.
+struct Server
+{
+  using Child_map = std::unordered_map<pid_t, int>;
+
+  Server(Context& c, String const& p, Compile_fn f)
+    : cxt(c), path(p), compile(f), sock(-1)
+  { }
+
+  ~Server();
+
+  void listen();
+  void run();
+  void accept();
+  void reap(bool);
+  void reply(int, int);
+
+  [[noreturn]] void child(int);
+
+  Context&   cxt;
+  String     path;
+  Compile_fn compile;
+  int        sock;
+  Child_map  children;
+};
+
+
+Server::~Server()
+{
+  if (sock >= 0) {
+    ::close(sock);
+    ::unlink(path.c_str());
+  }
+}
+
+
+// Bind the socket. A socket file left by a server that is no longer
+// running is replaced.
+//
+// Requests run with the server's privileges, so the socket is created
+// with mode 0600, and connections from other users are refused (see
+// accept).
+void
+Server::listen()
+{
+  sockaddr_un addr {};
+  addr.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(addr.sun_path))
+    throw Translation_error("socket path '{}' is too long", path);
+  std::strcpy(addr.sun_path, path.c_str());
+  sockaddr* sa = reinterpret_cast<sockaddr*>(&addr);
+
+  int fd = ::socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0)
+    server_error("create socket", path);
+  mode_t mask = ::umask(0177);
+  int bound = ::bind(fd, sa, sizeof(addr));
+  if (bound != 0 && errno == EADDRINUSE) {
+    if (::connect(fd, sa, sizeof(addr)) == 0) {
+      ::umask(mask);
+      ::close(fd);
+      throw Translation_error("a server is already listening on '{}'", path);
+    }
+    ::unlink(path.c_str());
+    bound = ::bind(fd, sa, sizeof(addr));
+  }
+  ::umask(mask);
+  if (bound != 0 || ::chmod(path.c_str(), 0600) != 0) {
+    ::close(fd);
+    server_error("bind", path);
+  }
+  if (::listen(fd, SOMAXCONN) != 0) {
+    ::close(fd);
+    server_error("listen on", path);
+  }
+  sock = fd;
+}
+
+
+// Serve requests until the server is stopped by SIGINT or SIGTERM.
+// Compilations that are running when the server stops are allowed to
+// finish.
+void
+Server::run()
+{
+  while (!stopping) {
+    pollfd fds[2] = {{sock, POLLIN, 0}, {wake[0], POLLIN, 0}};
+    if (::poll(fds, 2, -1) < 0) {
+      if (errno == EINTR)
+        continue;
+      server_error("poll", path);
+    }
+    if (fds[1].revents & POLLIN) {
+      char buf[64];
+      while (::read(wake[0], buf, sizeof(buf)) > 0)
+        ;
+      reap(false);
+    }
+    if (!stopping && (fds[0].revents & POLLIN))
+      accept();
+  }
+  reap(true);
+}
+
+
+// Accept a connection and fork a child to receive and serve its
+// request. The request is not read here, so a client that stalls
+// delays only its own compilation.
+void
+Server::accept()
+{
+  int conn = ::accept4(sock, nullptr, nullptr, SOCK_CLOEXEC);
+  if (conn < 0)
+    return;
+  if (!same_user(conn)) {
+    ::close(conn);
+    return;
+  }
+  pid_t pid = ::fork();
+  if (pid == 0)
+    child(conn);
+  if (pid < 0) {
+    std::cerr << "banjo-compile: cannot fork: " << std::strerror(errno) << '\n';
+    reply(conn, 1);
+    return;
+  }
+  children.emplace(pid, conn);
+}
+
+
+// Send the exit status of each finished child to its client. If `all`
+// is true, wait for every running child.
+void
+Server::reap(bool all)
+{
+  while (!children.empty()) {
+    int st;
+    pid_t pid = ::waitpid(-1, &st, all ? 0 : WNOHANG);
+    if (pid < 0 && errno == EINTR)
+      continue;
+    if (pid <= 0)
+      break;
+    auto iter = children.find(pid);
+    if (iter == children.end())
+      continue;
+    int status = WIFEXITED(st) ? WEXITSTATUS(st) : 128 + WTERMSIG(st);
+    reply(iter->second, status);
+    children.erase(iter);
+  }
+}
+
+
+void
+Server::reply(int conn, int status)
+{
+  std::int32_t n = status;
+  send_all(conn, &n, sizeof(n));
+  ::close(conn);
+}
+
+
+// Receive and compile the request on the connection `conn` in the
+// child process, which inherits the warm context of the server. The
+// client's streams become the standard streams of the child.
+void
+Server::child(int conn)
+{
+  std::signal(SIGCHLD, SIG_DFL);
+  std::signal(SIGINT, SIG_DFL);
+  std::signal(SIGTERM, SIG_DFL);
+  ::close(sock);
+  ::close(wake[0]);
+  ::close(wake[1]);
+  for (auto const& c : children)
+    ::close(c.second);
+
+  // A client that does not send its request in time is abandoned.
+  timeval limit {request_timeout, 0};
+  ::setsockopt(conn, SOL_SOCKET, SO_RCVTIMEO, &limit, sizeof(limit));
+  Request req;
+  if (!req.receive(conn))
+    std::_Exit(1);
+  ::close(conn);
+
+  for (int i = 0; i < request_fds; ++i)
+    ::dup2(req.fds[i], i);
+  req.close();
+
+  // The payload is the directory and the arguments, each terminated
+  // by a null character.
+  std::vector<char*> args {const_cast<char*>("banjo-compile")};
+  char* dir = req.payload.data();
+  char* end = dir + req.payload.size();
+  for (char* p = dir + std::strlen(dir) + 1; p < end; p += std::strlen(p) + 1)
+    args.push_back(p);
+  args.push_back(nullptr);
+  if (::chdir(dir) != 0) {
+    std::cerr << "banjo-compile: cannot enter '" << dir << "': "
+              << std::strerror(errno) << '\n';
+    std::_Exit(1);
+  }
+
+  int status = compile(cxt, int(args.size() - 1), args.data());
+  std::exit(status);
+}
+
+} // namespace
+
+
+// Serve compile requests on the Unix domain socket `path`. Returns the
+// exit status of the server.
+int
+serve(Context& cxt, std::string const& path, Compile_fn compile)
+{
+  if (::pipe2(wake, O_CLOEXEC | O_NONBLOCK) != 0)
+    server_error("create a pipe for", path);
+  struct sigaction sa {};
+  sa.sa_handler = on_signal;
+  sa.sa_flags = SA_RESTART | SA_NOCLDSTOP;
+  ::sigaction(SIGCHLD, &sa, nullptr);
+  ::sigaction(SIGINT, &sa, nullptr);
+  ::sigaction(SIGTERM, &sa, nullptr);
+
+  Server server(cxt, path, compile);
+  server.listen();
+  server.run();
+  return 0;
+}
+
+
+} // namespace banjo
@@ -0,0 +1,70 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_SERVER_HPP
+#define BANJO_SERVER_HPP
+
+// This module provides a compile server.
+//
+// The server is a long-running compiler that accepts requests on a Unix
+// domain socket. It is started with a context that is already warm:
+// LLVM is initialized and the declarations of commonly imported modules
+// are loaded. Each request is served by a child process forked from the
+// server, which begins with that state and compiles the request as if
+// it were a separate invocation of the compiler. A compilation that
+// fails, or exits, does not affect the server or other compilations.
+// Since compilations run with the server's privileges, only the user
+// running the server may connect to it.
+//
+// The client (banjo-client) is deliberately thin; it does not link the
+// compiler. A request is a single message carrying the client's working
+// directory and arguments, and, as ancillary data, the client's standard
+// input, output, and error. The child compiles with those as its own
+// standard streams, so its output goes directly to the client. When
+// the child finishes, the server replies with its exit status.
+//
+// The wire format is as follows. All integers are in host byte order,
+// since both ends of the socket are on the same host.
+//
+//    request:
+//      length:uint32 payload[length]
+//    payload:
+//      directory '\0' [argument '\0']...
+//    reply:
+//      status:int32
+//
+// The three file descriptors are sent with the length.
+//
+// Note that this header does not depend on the rest of the compiler,
+// so that it can be included by the client.
+
+#include <cstdint>
+#include <string>
+
+
+namespace banjo
+{
+
+// The maximum size of a request payload.
+constexpr std::uint32_t max_request_size = 1 << 20;
+
+
+// The number of file descriptors sent with a request.
+constexpr int request_fds = 3;
+
+
+struct Context;
+
+
+// Compiles the program given by a list of arguments, as the compiler's
+// main function does, and returns the exit status.
+using Compile_fn = int (*)(Context&, int, char**);
+
+
+int serve(Context&, std::string const&, Compile_fn);
+
+
+} // namespace banjo
+
+
+#endif
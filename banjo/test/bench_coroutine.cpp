@@ -0,0 +1,191 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include <banjo/context.hpp>
+#include <banjo/evaluation.hpp>
+#include <banjo/budget.hpp>
+#include <banjo/lexer.hpp>
+#include <banjo/parser.hpp>
+#include <banjo/gen/llvm/generator.hpp>
+
+#include <lingo/buffer.hpp>
+#include <lingo/error.hpp>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/DataLayout.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+
+// Compares a coroutine that yields the integers in [0, n) with an
+// equivalent hand-written loop.
+//
+//    bench_coroutine [<count> [<repetitions>]]
+//
+// Both are compiled at -O2 and executed by the JIT. The host sums the
+// values yielded by the coroutine, whose frame lives on the host's
+// stack, so no iteration allocates. The difference in time per element
+// is the cost of suspending and resuming the coroutine.
+//
+// The coroutine is also consumed by the constant evaluator, on a tenth
+// of the elements. Each value is produced by resuming the suspended
+// frame, so the time per element should not grow with the count.
+
+using namespace banjo;
+
+
+char const* source =
+  "codef range : (n : int) -> int {\n"
+  "  var i : int = 0;\n"
+  "  while (i < n) {\n"
+  "    yield i;\n"
+  "    i = i + 1;\n"
+  "  }\n"
+  "}\n"
+  "def sum : (n : int) -> int {\n"
+  "  var s : int = 0;\n"
+  "  var i : int = 0;\n"
+  "  while (i < n) {\n"
+  "    s = s + i;\n"
+  "    i = i + 1;\n"
+  "  }\n"
+  "  return s;\n"
+  "}\n";
+
+
+using Init_fn = void (*)(void*, std::int32_t);
+using Resume_fn = bool (*)(void*);
+using Sum_fn = std::int32_t (*)(std::int32_t);
+
+
+int
+main(int argc, char* argv[])
+{
+  int count = argc > 1 ? std::atoi(argv[1]) : 10000000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  llvm::InitializeNativeTargetAsmParser();
+  LLVMLinkInMCJIT();
+
+  Buffer input(source, source + std::strlen(source));
+  Context cxt;
+  ll::Generator gen;
+  gen.opt = 2;
+  llvm::Module* mod;
+  Coroutine_decl const* range = nullptr;
+  try {
+    Character_stream cs(input);
+    Token_buffer ts;
+    Lexer lex(cxt, cs, ts);
+    lex();
+    Parser parse(cxt, ts);
+    Stmt& tu = parse();
+    if (error_count())
+      return 1;
+    for (Stmt const& s : cast<Translation_stmt>(tu).statements())
+      if (Declaration_stmt const* d = as<Declaration_stmt>(&s))
+        if (Coroutine_decl const* c = as<Coroutine_decl>(&d->declaration()))
+          range = c;
+    mod = gen(tu);
+  } catch (Compiler_error& err) {
+    std::cerr << err.what() << '\n';
+    return 1;
+  }
+
+  std::string err;
+  std::unique_ptr<llvm::ExecutionEngine> engine(
+    llvm::EngineBuilder(std::unique_ptr<llvm::Module>(mod))
+      .setEngineKind(llvm::EngineKind::JIT)
+      .setErrorStr(&err)
+      .setMCJITMemoryManager(
+        std::unique_ptr<llvm::RTDyldMemoryManager>(new llvm::SectionMemoryManager()))
+      .create());
+  if (!engine) {
+    std::cerr << err << '\n';
+    return 1;
+  }
+  gen.mod = nullptr;
+
+  // Find the size of the frame and the offset of the yielded value.
+  llvm::DataLayout const& dl = *engine->getDataLayout();
+  llvm::StructType* frame = mod->getTypeByName("range.frame");
+  std::size_t size = dl.getTypeAllocSize(frame);
+  std::size_t offset = dl.getStructLayout(frame)->getElementOffset(1);
+  alignas(16) char buf[256];
+  if (size > sizeof(buf)) {
+    std::cerr << "frame too large: " << size << " bytes\n";
+    return 1;
+  }
+
+  engine->finalizeObject();
+  Init_fn init = (Init_fn)engine->getFunctionAddress("range.init");
+  Resume_fn resume = (Resume_fn)engine->getFunctionAddress("range.resume");
+  Sum_fn sum = (Sum_fn)engine->getFunctionAddress("sum");
+
+  using Clock = std::chrono::steady_clock;
+  Clock::duration loop {};
+  Clock::duration coro {};
+  std::uint32_t expect = 0;
+  std::uint32_t actual = 0;
+  for (int i = 0; i < reps; ++i) {
+    Clock::time_point start = Clock::now();
+    expect = sum(count);
+    loop += Clock::now() - start;
+
+    start = Clock::now();
+    std::uint32_t s = 0;
+    init(buf, count);
+    while (resume(buf))
+      s += *reinterpret_cast<std::uint32_t*>(buf + offset);
+    actual = s;
+    coro += Clock::now() - start;
+  }
+
+  // Consume the coroutine at compile time.
+  int small = count / 10;
+  Clock::duration eval {};
+  std::uint32_t folded = 0;
+  try {
+    for (int i = 0; i < reps; ++i) {
+      evaluation_budget().reset();
+      Clock::time_point start = Clock::now();
+      Evaluator ev;
+      Coroutine_state* co = ev.start(*range, {Value(small)});
+      std::uint32_t s = 0;
+      Value v;
+      while (ev.resume(*co, v))
+        s += v.get_integer();
+      folded = s;
+      eval += Clock::now() - start;
+    }
+  } catch (Compiler_error& err) {
+    std::cerr << err.what() << '\n';
+    return 1;
+  }
+  std::uint32_t expect_small = std::uint64_t(small) * (small - 1) / 2;
+
+  using Nsec = std::chrono::nanoseconds;
+  double n = double(count) * reps;
+  double loop_ns = std::chrono::duration_cast<Nsec>(loop).count() / n;
+  double coro_ns = std::chrono::duration_cast<Nsec>(coro).count() / n;
+  double eval_ns = std::chrono::duration_cast<Nsec>(eval).count() / (double(small) * reps);
+  bool ok = expect == actual && expect_small == folded;
+  std::cout << "elements: " << count << '\n'
+            << "frame size: " << size << " bytes\n"
+            << "loop: " << loop_ns << " ns/element\n"
+            << "coroutine: " << coro_ns << " ns/element\n"
+            << "evaluator: " << eval_ns << " ns/element\n"
+            << "checksum: " << (ok ? "ok" : "mismatch") << '\n';
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,404 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include <banjo/context.hpp>
+#include <banjo/lexer.hpp>
+#include <banjo/parser.hpp>
+
+#include <lingo/buffer.hpp>
+#include <lingo/error.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <sstream>
+
+
+// Measures the parsing of expression-heavy input.
+//
+//    bench_parse [<expressions> [<repetitions>]]
+//
+// Generates a sequence of long expressions that use every binary
+// operator, and reports the time taken to parse them by precedence
+// climbing and, as a baseline, by recursive descent. Each repetition
+// re-parses the same tokens with a new context.
+//
+// Only the parsing of expressions is timed. The operands are literals,
+// so no names are looked up, and no declarations are elaborated. The
+// semantic actions that build and type each expression are run by both
+// parsers.
+
+using namespace banjo;
+
+
+// The parser's original strategy for binary expressions: recursive
+// descent, with one function per precedence level. The functions below
+// are the ones that precedence climbing replaced, unchanged. They hide
+// the corresponding members of Parser, and bottom out in its
+// unary-expression parser.
+struct Descent_parser : Parser
+{
+  using Parser::Parser;
+
+  Expr& expression();
+  Expr& logical_or_expression();
+  Expr& logical_and_expression();
+  Expr& inclusive_or_expression();
+  Expr& exclusive_or_expression();
+  Expr& and_expression();
+  Expr& equality_expression();
+  Expr& relational_expression();
+  Expr& shift_expression();
+  Expr& additive_expression();
+  Expr& multiplicative_expression();
+};
+
+
+Expr&
+Descent_parser::expression()
+{
+  return logical_or_expression();
+}
+
+
+// Parse a logical-or expression.
+//
+//    logical-or-expression:
+//      logical-and-expression
+//      logical-or-expression '||' logical-and-expression
+Expr&
+Descent_parser::logical_or_expression()
+{
+  Expr* e1 = &logical_and_expression();
+  while (true) {
+    if (Token tok = match_if(bar_bar_tok)) {
+      Expr& e2 = logical_and_expression();
+      e1 = &on_logical_or_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a logical-and expression.
+//
+//    logical-and-expression:
+//      inclusive-or-expression
+//      logical-and-expression '&&' inclusive-or-expression
+//
+Expr&
+Descent_parser::logical_and_expression()
+{
+  Expr* e1 = &inclusive_or_expression();
+  while (true) {
+    if (Token tok = match_if(amp_amp_tok)) {
+      Expr& e2 = inclusive_or_expression();
+      e1 = &on_logical_and_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a bitwise inclusive-or expression.
+//
+//    inclusive-or-expression:
+//      exclusive-or-expression
+//      inclusive-or-expression '|' exclusive-or-expression
+//
+// FIXME: This skips the bitwise expressions.
+Expr&
+Descent_parser::inclusive_or_expression()
+{
+  Expr* e1 = &exclusive_or_expression();
+  while (true) {
+    if (Token tok = match_if(bar_tok)) {
+      Expr& e2 = exclusive_or_expression();
+      e1 = &on_or_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a bitwise exclusive-or expression.
+//
+//    exclusive-or-expression:
+//      and-expression
+//      exclusive-or-expression '^' and-expression
+//
+Expr&
+Descent_parser::exclusive_or_expression()
+{
+  Expr* e1 = &and_expression();
+  while (true) {
+    if (Token tok = match_if(caret_tok)) {
+      Expr& e2 = and_expression();
+      e1 = &on_xor_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a bitwise and expression.
+//
+//    exclusive-or-expression:
+//      equality-expression
+//      exclusive-or-expression '&' equality-expression
+//
+Expr&
+Descent_parser::and_expression()
+{
+  Expr* e1 = &equality_expression();
+  while (true) {
+    if (Token tok = match_if(amp_tok)) {
+      Expr& e2 = equality_expression();
+      e1 = &on_and_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse an equality expression.
+//
+//    equality-expression:
+//      relational-expression:
+//      equality-expression '==' relational-expression
+//      equality-expression '!=' relational-expression
+Expr&
+Descent_parser::equality_expression()
+{
+  Expr* e1 = &relational_expression();
+  while (true) {
+    if (Token tok = match_if(eq_eq_tok)) {
+      Expr& e2 = relational_expression();
+      e1 = &on_eq_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(bang_eq_tok)) {
+      Expr& e2 = relational_expression();
+      e1 = &on_ne_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a relational expression.
+//
+//    relational-expression:
+//      shift-expression:
+//      relational-expression '<' shift-expression
+//      relational-expression '>' shift-expression
+//      relational-expression '<=' shift-expression
+//      relational-expression '>=' shift-expression
+//      relational-expression '<=>' shift-expression
+Expr&
+Descent_parser::relational_expression()
+{
+  Expr* e1 = &shift_expression();
+  while (true) {
+    if (Token tok = match_if(lt_tok)) {
+      Expr& e2 = shift_expression();
+      e1 = &on_lt_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(gt_tok)) {
+      Expr& e2 = shift_expression();
+      e1 = &on_gt_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(lt_eq_tok)) {
+      Expr& e2 = shift_expression();
+      e1 = &on_le_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(gt_eq_tok)) {
+      Expr& e2 = shift_expression();
+      e1 = &on_ge_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(lt_eq_gt_tok)) {
+      Expr& e2 = shift_expression();
+      e1 = &on_cmp_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a shift expression.
+//
+//    shift-expression:
+//      additive_expression:
+//      shift-expression '<<' additive_expression
+//      shift-expression '>>' additive_expression
+//
+Expr&
+Descent_parser::shift_expression()
+{
+  Expr* e1 = &additive_expression();
+  while (true) {
+    if (Token tok = match_if(lt_lt_tok)) {
+      Expr& e2 = additive_expression();
+      e1 = &on_lsh_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(gt_gt_tok)) {
+      Expr& e2 = additive_expression();
+      e1 = &on_rsh_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse an additive expression.
+//
+//    additive-expression:
+//      multiplicative-expression:
+//      additive-expression '+' multiplicative-expression
+//      additive-expression '-' multiplicative-expression
+Expr&
+Descent_parser::additive_expression()
+{
+  Expr* e1 = &multiplicative_expression();
+  while (true) {
+    if (Token tok = match_if(plus_tok)) {
+      Expr& e2 = multiplicative_expression();
+      e1 = &on_add_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(minus_tok)) {
+      Expr& e2 = unary_expression();
+      e1 = &on_sub_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// Parse a multiplicative expression.
+//
+//    multiplicative-expression:
+//      unary-expression:
+//      multiplicative-expression '*' unary-expression
+//      multiplicative-expression '/' unary-expression
+//      multiplicative-expression '%' unary-expression
+Expr&
+Descent_parser::multiplicative_expression()
+{
+  Expr* e1 = &unary_expression();
+  while (true) {
+    // Use a switch?
+    if (Token tok = match_if(star_tok)) {
+      Expr& e2 = unary_expression();
+      e1 = &on_mul_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(slash_tok)) {
+      Expr& e2 = unary_expression();
+      e1 = &on_div_expression(tok, *e1, e2);
+    } else if (Token tok = match_if(percent_tok)) {
+      Expr& e2 = unary_expression();
+      e1 = &on_rem_expression(tok, *e1, e2);
+    } else {
+      break;
+    }
+  }
+  return *e1;
+}
+
+
+// The operators used to build expressions, cycling through every
+// precedence level.
+char const* ops[] = {
+  "+", "*", "-", "/", "%", "<<", ">>", "<", "==", "&", "^", "|", ">=",
+  "!=", "&&", "||", "<=", ">", "+", "*",
+};
+
+
+// Generates `n` expression statements. The expressions have no
+// parentheses, since a grouped expression would be parsed by Parser's
+// expression parser in either case.
+std::string
+generate(int n)
+{
+  std::stringstream ss;
+  for (int i = 0; i < n; ++i) {
+    for (int j = 0; j < 40; ++j)
+      ss << (i + j) % 97 + 1 << ' ' << ops[(i + j) % 20] << ' ';
+    ss << i << ";\n";
+  }
+  return ss.str();
+}
+
+
+// Returns the average time in microseconds taken by a parser of type
+// P to parse the expressions in `input`, and stores the number of
+// tokens in `ntoks`. Returns a negative time if the input has errors.
+template<typename P>
+double
+measure(Buffer const& input, int reps, std::size_t& ntoks)
+{
+  using Clock = std::chrono::steady_clock;
+  Clock::duration total {};
+  for (int i = 0; i < reps; ++i) {
+    Context cxt;
+    Character_stream cs(input);
+    Token_buffer ts;
+    Lexer lex(cxt, cs, ts);
+    lex();
+    ntoks = ts.size();
+
+    Enter_scope scope(cxt);
+    P parse(cxt, ts);
+    Clock::time_point start = Clock::now();
+    while (!parse.is_eof()) {
+      parse.expression();
+      parse.match(semicolon_tok);
+    }
+    total += Clock::now() - start;
+    if (error_count())
+      return -1;
+  }
+  using Usec = std::chrono::microseconds;
+  return std::chrono::duration_cast<Usec>(total).count() / double(reps);
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  int exprs = argc > 1 ? std::atoi(argv[1]) : 2000;
+  int reps = argc > 2 ? std::atoi(argv[2]) : 10;
+
+  std::string text = generate(exprs);
+  Buffer input(text.data(), text.data() + text.size());
+
+  std::size_t ntoks = 0;
+  double climb;
+  double descend;
+  try {
+    descend = measure<Descent_parser>(input, reps, ntoks);
+    climb = measure<Parser>(input, reps, ntoks);
+  } catch (Compiler_error& err) {
+    std::cerr << err.what() << '\n';
+    return 1;
+  }
+  if (descend < 0 || climb < 0)
+    return 1;
+
+  std::cout << "expressions: " << exprs << '\n'
+            << "tokens: " << ntoks << '\n'
+            << "recursive descent: " << descend << " us ("
+            << (ntoks / descend) << " tokens/us)\n"
+            << "precedence climbing: " << climb << " us ("
+            << (ntoks / climb) << " tokens/us)\n"
+            << "speedup: " << (descend / climb) << '\n';
+  return 0;
+}
@@ -0,0 +1,66 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include <banjo/file.hpp>
+#include <banjo/value.hpp>
+
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+
+
+// Measures the construction and folding of large aggregate values.
+//
+//    bench_value [<elements> [<folds>]]
+//
+// Each fold is a complete evaluation that builds an array of tuples,
+// fills it, and reduces it to a single sum. Aggregates are reclaimed
+// at the end of each fold, so the peak resident set size should not
+// depend on the number of folds.
+
+using namespace banjo;
+
+
+Integer_value
+fold(std::size_t n)
+{
+  Enter_evaluation scope;
+  Array_value a(n);
+  for (std::size_t i = 0; i < n; ++i) {
+    Tuple_value t(2);
+    t[0] = Integer_value(i);
+    t[1] = Integer_value(i * 2);
+    a[i] = t;
+  }
+
+  Integer_value sum = 0;
+  for (std::size_t i = 0; i < a.len(); ++i) {
+    Tuple_value t = a[i].get_tuple();
+    sum += t[0].get_integer() + t[1].get_integer();
+  }
+  return scope.result(sum).get_integer();
+}
+
+
+int
+main(int argc, char* argv[])
+{
+  std::size_t elems = argc > 1 ? std::atoi(argv[1]) : 1000000;
+  int folds = argc > 2 ? std::atoi(argv[2]) : 20;
+
+  using Clock = std::chrono::steady_clock;
+  Clock::time_point start = Clock::now();
+  Integer_value check = 0;
+  for (int i = 0; i < folds; ++i)
+    check += fold(elems);
+  Clock::duration total = Clock::now() - start;
+
+  using Usec = std::chrono::microseconds;
+  double us = std::chrono::duration_cast<Usec>(total).count() / double(folds);
+  std::cout << "value size: " << sizeof(Value) << " bytes\n"
+            << "elements: " << elems << '\n'
+            << "fold time: " << us << " us\n"
+            << "checksum: " << check << '\n'
+            << "peak resident set size: " << peak_resident_set_size() << " KiB\n";
+  return 0;
+}
@@ -0,0 +1,38 @@
+# Compiles a Banjo program with both the LLVM and the C++ generators,
+# runs each executable, and checks that they exit with the same status.
+#
+#    cmake -DBANJO=<compiler> -DCXX=<c++ compiler> -DSOURCE=<program>
+#          -DWORK=<directory> -P differential.cmake
+#
+# The main function of each program returns a checksum of its results.
+
+get_filename_component(name ${SOURCE} NAME_WE)
+set(base ${WORK}/${name})
+file(MAKE_DIRECTORY ${WORK})
+
+
+# Run a command, failing the test if it does not succeed.
+macro(check)
+  execute_process(COMMAND ${ARGN} RESULT_VARIABLE status)
+  if(NOT status EQUAL 0)
+    message(FATAL_ERROR "command failed (${status}): ${ARGN}")
+  endif()
+endmacro()
+
+
+# The LLVM generator emits an object file, which is linked by the host
+# compiler.
+check(${BANJO} -emit obj -o ${base}.o ${SOURCE})
+check(${CXX} ${base}.o -o ${base}.llvm)
+
+# The C++ generator emits a translation unit. Signed arithmetic wraps
+# in the LLVM generator, so it must also wrap in C++.
+check(${BANJO} -emit cxx -o ${base}.cpp ${SOURCE})
+check(${CXX} -std=c++11 -fwrapv ${base}.cpp -o ${base}.cxx)
+
+execute_process(COMMAND ${base}.llvm RESULT_VARIABLE expected)
+execute_process(COMMAND ${base}.cxx RESULT_VARIABLE actual)
+if(NOT expected STREQUAL actual)
+  message(FATAL_ERROR "${name}: LLVM returned ${expected}, C++ returned ${actual}")
+endif()
+message(STATUS "${name}: ${actual}")
@@ -0,0 +1,173 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "test.hpp"
+
+#include <banjo/lexer.hpp>
+#include <banjo/parser.hpp>
+#include <banjo/gen/llvm/bounds.hpp>
+
+#include <lingo/buffer.hpp>
+#include <lingo/error.hpp>
+
+#include <cstring>
+#include <vector>
+
+
+// Checks which subscripts the elimination of bounds checks finds to
+// be in range.
+
+
+struct Case
+{
+  char const* text;
+  std::size_t safe; // The number of subscripts known to be in range
+};
+
+
+Case cases[] = {
+  // Literal indexes are safe when they are less than the extent.
+  {
+    "def literal : () -> int {\n"
+    "  var a : int[4];\n"
+    "  a[0] = 1;\n"
+    "  a[3] = 2;\n"
+    "  return a[4];\n"
+    "}\n",
+    2
+  },
+
+  // An index bounded by the condition of its loop is safe, whichever
+  // way the condition is written.
+  {
+    "def bounded : () -> int {\n"
+    "  var a : int[8];\n"
+    "  var i : int = 0;\n"
+    "  while (i < 8) {\n"
+    "    a[i] = i;\n"
+    "    i = i + 1;\n"
+    "  }\n"
+    "  var j : int = 0;\n"
+    "  while (8 > j) {\n"
+    "    a[j] = j;\n"
+    "    j = j + 1;\n"
+    "  }\n"
+    "  return 0;\n"
+    "}\n",
+    2
+  },
+
+  // The limit of the loop exceeds the extent.
+  {
+    "def beyond : () -> int {\n"
+    "  var a : int[8];\n"
+    "  var i : int = 0;\n"
+    "  while (i < 9) {\n"
+    "    a[i] = i;\n"
+    "    i = i + 1;\n"
+    "  }\n"
+    "  return 0;\n"
+    "}\n",
+    0
+  },
+
+  // The increment can carry past the largest int, after which the
+  // index is negative and still less than the limit.
+  {
+    "def wraps : () -> int {\n"
+    "  var a : int[8];\n"
+    "  var i : int = 0;\n"
+    "  while (i < 8) {\n"
+    "    a[i] = i;\n"
+    "    i = i + 2147483647;\n"
+    "  }\n"
+    "  return 0;\n"
+    "}\n",
+    0
+  },
+
+  // The index is incremented after the condition is tested and before
+  // the subscript.
+  {
+    "def assigned : () -> int {\n"
+    "  var a : int[8];\n"
+    "  var i : int = 0;\n"
+    "  while (i < 8) {\n"
+    "    i = i + 1;\n"
+    "    a[i] = i;\n"
+    "  }\n"
+    "  return 0;\n"
+    "}\n",
+    0
+  },
+
+  // The index is assigned a value that may be negative.
+  {
+    "def copied : (n : int) -> int {\n"
+    "  var a : int[8];\n"
+    "  var i : int = 0;\n"
+    "  while (i < 8) {\n"
+    "    a[i] = i;\n"
+    "    i = n;\n"
+    "  }\n"
+    "  return 0;\n"
+    "}\n",
+    0
+  },
+
+  // A reference is bound to the index, through which it may be
+  // assigned.
+  {
+    "def aliased : () -> int {\n"
+    "  var a : int[8];\n"
+    "  var i : int = 0;\n"
+    "  var r : &int = i;\n"
+    "  while (i < 8) {\n"
+    "    a[i] = i;\n"
+    "    r = 9;\n"
+    "    i = i + 1;\n"
+    "  }\n"
+    "  return 0;\n"
+    "}\n",
+    0
+  },
+};
+
+
+int
+main()
+{
+  int failures = 0;
+  for (Case const& c : cases) {
+    Buffer input(c.text, c.text + std::strlen(c.text));
+    Context cxt;
+    try {
+      Character_stream cs(input);
+      Token_buffer ts;
+      Lexer lex(cxt, cs, ts);
+      lex();
+      Parser parse(cxt, ts);
+      Stmt& tu = parse();
+      if (error_count())
+        return 1;
+      for (Stmt const& s : cast<Translation_stmt>(tu).statements()) {
+        Declaration_stmt const* d = as<Declaration_stmt>(&s);
+        if (!d)
+          continue;
+        Function_decl const* f = as<Function_decl>(&d->declaration());
+        if (!f)
+          continue;
+        std::size_t n = ll::find_safe_indexes(*f).size();
+        if (n != c.safe) {
+          std::cerr << c.text << "expected " << c.safe
+                    << " safe subscripts, found " << n << '\n';
+          ++failures;
+        }
+      }
+    } catch (Compiler_error& err) {
+      std::cerr << err.what() << '\n';
+      return 1;
+    }
+  }
+  return failures != 0;
+}
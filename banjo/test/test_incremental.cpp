@@ -0,0 +1,112 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "test.hpp"
+
+#include <banjo/incremental.hpp>
+#include <banjo/lexer.hpp>
+
+#include <lingo/buffer.hpp>
+#include <lingo/error.hpp>
+
+#include <cstring>
+#include <memory>
+#include <vector>
+
+
+// Compiles successive revisions of a program with one incremental
+// unit and checks which definitions are elaborated again.
+
+
+char const* original =
+  "def f : (a : int) -> int { return a + 1; }\n"
+  "def g : (a : int) -> int { return f(a) * 2; }\n"
+  "def h : (a : int) -> int { return a - 3; }\n";
+
+// The body of h changes.
+char const* edit_h =
+  "def f : (a : int) -> int { return a + 1; }\n"
+  "def g : (a : int) -> int { return f(a) * 2; }\n"
+  "def h : (a : int) -> int { return a - 4; }\n";
+
+// The body of f changes, and g calls f.
+char const* edit_f =
+  "def f : (a : int) -> int { return a + 2; }\n"
+  "def g : (a : int) -> int { return f(a) * 2; }\n"
+  "def h : (a : int) -> int { return a - 4; }\n";
+
+// The signature of h changes.
+char const* edit_sig =
+  "def f : (a : int) -> int { return a + 2; }\n"
+  "def g : (a : int) -> int { return f(a) * 2; }\n"
+  "def h : (a : bool) -> int { return 0; }\n";
+
+
+// The text and tokens of one revision, which must outlive the unit.
+struct Revision
+{
+  Revision(Context& cxt, char const* text)
+    : input(text, text + std::strlen(text))
+  {
+    Character_stream cs(input);
+    Lexer lex(cxt, cs, toks);
+    lex();
+  }
+
+  Buffer       input;
+  Token_buffer toks;
+};
+
+
+int failures = 0;
+
+
+void
+check(Incremental_unit& unit, char const* what, bool full, std::size_t reused, std::size_t elaborated)
+{
+  Incremental_stats const& st = unit.stats();
+  if (st.full != full || st.reused != reused || st.elaborated != elaborated) {
+    std::cerr << what << ": expected "
+              << (full ? "full, " : "") << reused << " reused, "
+              << elaborated << " elaborated; got "
+              << (st.full ? "full, " : "") << st.reused << " reused, "
+              << st.elaborated << " elaborated\n";
+    ++failures;
+  }
+}
+
+
+int
+main()
+{
+  Context cxt;
+  std::vector<std::unique_ptr<Revision>> revs;
+  Incremental_unit unit(cxt);
+  auto compile = [&](char const* text) {
+    revs.emplace_back(new Revision(cxt, text));
+    unit(revs.back()->toks);
+  };
+
+  try {
+    compile(original);
+    check(unit, "first compilation", true, 0, 3);
+
+    compile(original);
+    check(unit, "no change", false, 3, 0);
+
+    compile(edit_h);
+    check(unit, "changed body", false, 2, 1);
+
+    compile(edit_f);
+    check(unit, "changed dependency", false, 1, 2);
+
+    compile(edit_sig);
+    check(unit, "changed signature", true, 0, 3);
+  } catch (Compiler_error& err) {
+    std::cerr << err.what() << '\n';
+    return 1;
+  }
+  if (error_count())
+    return 1;
+  return failures != 0;
+}
@@ -52,7 +52,7 @@ main(int argc, char* argv[])
 
   File input(argv[1]);
   Character_stream cs(input);
-  Token_stream ts;
+  Token_buffer ts;
   Lexer lex(cxt, cs, ts);
   Parser parse(cxt, ts);
 
@@ -0,0 +1,202 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "test.hpp"
+
+#include <banjo/budget.hpp>
+#include <banjo/evaluation.hpp>
+#include <banjo/lexer.hpp>
+#include <banjo/parser.hpp>
+#include <banjo/gen/llvm/generator.hpp>
+
+#include <lingo/buffer.hpp>
+#include <lingo/error.hpp>
+
+#include <llvm/ExecutionEngine/ExecutionEngine.h>
+#include <llvm/ExecutionEngine/MCJIT.h>
+#include <llvm/ExecutionEngine/SectionMemoryManager.h>
+#include <llvm/IR/Module.h>
+#include <llvm/Support/TargetSelect.h>
+
+#include <climits>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Evaluates integer operators on the register machine and with the
+// tree walker, and compares their results with those of the compiled
+// functions. Values of type int are 32 bits wide, so arithmetic must
+// wrap at that precision. Operations whose behavior is undefined in
+// the compiled program must fail in both evaluators.
+
+
+char const* source =
+  "def add : (a : int, b : int) -> int { return a + b; }\n"
+  "def sub : (a : int, b : int) -> int { return a - b; }\n"
+  "def mul : (a : int, b : int) -> int { return a * b; }\n"
+  "def quo : (a : int, b : int) -> int { return a / b; }\n"
+  "def rem : (a : int, b : int) -> int { return a % b; }\n"
+  "def neg : (a : int, b : int) -> int { return -a; }\n"
+  "def inv : (a : int, b : int) -> int { return ~a ^ b; }\n"
+  "def shl : (a : int, b : int) -> int { return a << b; }\n"
+  "def shr : (a : int, b : int) -> int { return a >> b; }\n"
+  "def lt : (a : int, b : int) -> bool { return a < b; }\n"
+  "def le : (a : int, b : int) -> bool { return a + 1 <= b; }\n";
+
+
+using Int_fn = std::int32_t (*)(std::int32_t, std::int32_t);
+using Bool_fn = bool (*)(std::int32_t, std::int32_t);
+
+
+std::int32_t operands[] = {
+  0, 1, -1, 2, 7, -7, 31, 32, 1 << 30, INT_MAX, INT_MIN, INT_MIN + 1,
+};
+
+
+int failures = 0;
+
+
+// The result of an evaluation, or the failure to produce one.
+struct Result
+{
+  bool          ok;
+  Integer_value value;
+};
+
+
+Result
+evaluate(Function_decl const& f, std::int32_t a, std::int32_t b, bool bytecode)
+{
+  evaluation_budget().reset();
+  Evaluator ev;
+  ev.bytecode = bytecode;
+  try {
+    return {true, ev.call(f, {Value(Integer_value(a)), Value(Integer_value(b))}).get_integer()};
+  } catch (Evaluation_error&) {
+    return {false, 0};
+  }
+}
+
+
+void
+check(char const* fn, std::int32_t a, std::int32_t b, Result vm, Result tree, Integer_value native)
+{
+  if (vm.ok != tree.ok || (vm.ok && vm.value != tree.value)) {
+    std::cerr << fn << '(' << a << ", " << b << "): machine ";
+    if (vm.ok)
+      std::cerr << vm.value;
+    else
+      std::cerr << "failed";
+    std::cerr << ", tree walker ";
+    if (tree.ok)
+      std::cerr << tree.value;
+    else
+      std::cerr << "failed";
+    std::cerr << '\n';
+    ++failures;
+  } else if (vm.ok && vm.value != native) {
+    std::cerr << fn << '(' << a << ", " << b << "): evaluated "
+              << vm.value << ", compiled " << native << '\n';
+    ++failures;
+  }
+}
+
+
+// Returns true if the compiled program's behavior is defined for
+// the operation `fn` applied to `a` and `b`.
+bool
+is_defined(std::string const& fn, std::int32_t a, std::int32_t b)
+{
+  if (fn == "quo" || fn == "rem")
+    return b != 0 && !(a == INT_MIN && b == -1);
+  if (fn == "shl" || fn == "shr")
+    return b >= 0 && b < 32;
+  return true;
+}
+
+
+int
+main()
+{
+  llvm::InitializeNativeTarget();
+  llvm::InitializeNativeTargetAsmPrinter();
+  llvm::InitializeNativeTargetAsmParser();
+  LLVMLinkInMCJIT();
+
+  Buffer input(source, source + std::strlen(source));
+  Context cxt;
+  ll::Generator gen;
+  llvm::Module* mod;
+  std::vector<Function_decl const*> fns;
+  try {
+    Character_stream cs(input);
+    Token_buffer ts;
+    Lexer lex(cxt, cs, ts);
+    lex();
+    Parser parse(cxt, ts);
+    Stmt& tu = parse();
+    if (error_count())
+      return 1;
+    for (Stmt const& s : cast<Translation_stmt>(tu).statements())
+      if (Declaration_stmt const* d = as<Declaration_stmt>(&s))
+        if (Function_decl const* f = as<Function_decl>(&d->declaration()))
+          fns.push_back(f);
+    mod = gen(tu);
+  } catch (Compiler_error& err) {
+    std::cerr << err.what() << '\n';
+    return 1;
+  }
+
+  std::string err;
+  std::unique_ptr<llvm::ExecutionEngine> engine(
+    llvm::EngineBuilder(std::unique_ptr<llvm::Module>(mod))
+      .setEngineKind(llvm::EngineKind::JIT)
+      .setErrorStr(&err)
+      .setMCJITMemoryManager(
+        std::unique_ptr<llvm::RTDyldMemoryManager>(new llvm::SectionMemoryManager()))
+      .create());
+  if (!engine) {
+    std::cerr << err << '\n';
+    return 1;
+  }
+  gen.mod = nullptr;
+  engine->finalizeObject();
+
+  char const* names[] = {
+    "add", "sub", "mul", "quo", "rem", "neg", "inv", "shl", "shr", "lt", "le",
+  };
+  for (std::size_t n = 0; n < fns.size(); ++n) {
+    Function_decl const& f = *fns[n];
+    std::string name = names[n];
+    if (!lower(f)) {
+      std::cerr << name << ": not lowered\n";
+      ++failures;
+      continue;
+    }
+    std::uint64_t addr = engine->getFunctionAddress(name);
+    bool flag = is_boolean_type(f.return_type());
+    for (std::int32_t a : operands) {
+      for (std::int32_t b : operands) {
+        Result vm = evaluate(f, a, b, true);
+        Result tree = evaluate(f, a, b, false);
+        if (!is_defined(name, a, b)) {
+          if (vm.ok || tree.ok) {
+            std::cerr << name << '(' << a << ", " << b << "): expected failure\n";
+            ++failures;
+          }
+          continue;
+        }
+        Integer_value native;
+        if (flag)
+          native = reinterpret_cast<Bool_fn>(addr)(a, b);
+        else
+          native = reinterpret_cast<Int_fn>(addr)(a, b);
+        check(names[n], a, b, vm, tree, native);
+      }
+    }
+  }
+  return failures != 0;
+}
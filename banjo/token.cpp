@@ -3,6 +3,8 @@
 
 #include "token.hpp"
 
+#include <algorithm>
+
 namespace banjo
 {
 
@@ -162,4 +164,78 @@ init_tokens(Symbol_table& syms)
 }
 
 
+// -------------------------------------------------------------------------- //
+// Token buffers
+
+// Returns the index of the symbol in the buffer's symbol table, adding
+// it if it has not been seen before.
+std::uint32_t
+Token_buffer::intern(Symbol const* sym)
+{
+  auto result = symidx.emplace(sym, symtab.size());
+  if (result.second)
+    symtab.push_back(sym);
+  return result.first->second;
+}
+
+
+// Append a token to the buffer. A new segment is started whenever the
+// token was lexed from a different input than its predecessor.
+void
+Token_buffer::put(Token tok)
+{
+  Location loc = tok.location();
+  Buffer const* input = loc.buffer();
+  if (segments.empty() || segments.back().input != input)
+    segments.push_back({size(), input});
+
+  kinds.push_back(tok.kind());
+  syms.push_back(intern(tok.symbol()));
+  offsets.push_back(input ? loc.offset() : 0);
+}
+
+
+// Append the tokens of another buffer to this one. Symbol indexes are
+// remapped into this buffer's table.
+void
+Token_buffer::append(Token_buffer const& buf)
+{
+  std::size_t base = size();
+  reserve(base + buf.size());
+  kinds.insert(kinds.end(), buf.kinds.begin(), buf.kinds.end());
+  offsets.insert(offsets.end(), buf.offsets.begin(), buf.offsets.end());
+  for (std::uint32_t n : buf.syms)
+    syms.push_back(intern(buf.symtab[n]));
+  for (Segment const& seg : buf.segments) {
+    if (segments.empty() || segments.back().input != seg.input)
+      segments.push_back({base + seg.first, seg.input});
+  }
+}
+
+
+// Returns the location of the nth token. The segment containing the
+// token is found by binary search.
+Location
+Token_buffer::location(std::size_t n) const
+{
+  auto iter = std::upper_bound(segments.begin(), segments.end(), n,
+    [](std::size_t n, Segment const& seg) {
+      return n < seg.first;
+    });
+  lingo_assert(iter != segments.begin());
+  Buffer const* input = std::prev(iter)->input;
+  if (!input)
+    return Location();
+  return Location(input, offsets[n]);
+}
+
+
+// Returns the nth token.
+Token
+Token_buffer::token(std::size_t n) const
+{
+  return Token(location(n), symbol(n));
+}
+
+
 } // namespace banjo
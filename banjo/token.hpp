@@ -7,6 +7,11 @@
 #include "prelude.hpp"
 
 #include <lingo/token.hpp>
+#include <lingo/buffer.hpp>
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
 
 
 namespace banjo
@@ -146,6 +151,175 @@ char const* get_spelling(Token_kind);
 void init_tokens(Symbol_table&);
 
 
+// -------------------------------------------------------------------------- //
+// Token buffers
+
+// A contiguous sequence of tokens stored as a structure of arrays.
+//
+// Each token is represented by its kind, the index of its symbol in a
+// table of the distinct symbols in the buffer, and its offset within
+// the input from which it was lexed. That is 10 bytes per token, as
+// opposed to a full location and symbol pointer in a list node.
+//
+// Locations are not stored. They are reconstructed on demand from the
+// offset and the input in which the token appears; line and column
+// numbers are computed from that location only when a diagnostic
+// needs them. Inputs are recorded as segments: each segment names the
+// input buffer of a run of consecutive tokens.
+struct Token_buffer
+{
+  // A run of tokens lexed from the same input.
+  struct Segment
+  {
+    std::size_t   first; // Index of the first token in the segment
+    Buffer const* input; // The input containing the tokens
+  };
+
+  using Kind_seq    = std::vector<std::int16_t>;
+  using Index_seq   = std::vector<std::uint32_t>;
+  using Offset_seq  = std::vector<std::uint32_t>;
+  using Symbol_seq  = std::vector<Symbol const*>;
+  using Symbol_map  = std::unordered_map<Symbol const*, std::uint32_t>;
+  using Segment_seq = std::vector<Segment>;
+
+  void put(Token);
+  void append(Token_buffer const&);
+  void reserve(std::size_t);
+
+  // Returns the number of tokens in the buffer.
+  std::size_t size() const { return kinds.size(); }
+  bool        empty() const { return kinds.empty(); }
+
+  // Returns the kind of the nth token.
+  Token_kind kind(std::size_t n) const { return Token_kind(kinds[n]); }
+
+  // Returns the symbol of the nth token.
+  Symbol const* symbol(std::size_t n) const { return symtab[syms[n]]; }
+
+  Location location(std::size_t) const;
+  Token    token(std::size_t) const;
+
+  std::uint32_t intern(Symbol const*);
+
+  Kind_seq    kinds;    // The kind of each token
+  Index_seq   syms;     // The symbol index of each token
+  Offset_seq  offsets;  // The input offset of each token
+  Symbol_seq  symtab;   // Distinct symbols in the buffer
+  Symbol_map  symidx;   // Symbol indexes
+  Segment_seq segments; // Inputs of consecutive tokens
+};
+
+
+// Reserve space for at least n tokens.
+inline void
+Token_buffer::reserve(std::size_t n)
+{
+  kinds.reserve(n);
+  syms.reserve(n);
+  offsets.reserve(n);
+}
+
+
+// The tokens [first, last) of a buffer. Unparsed terms refer to their
+// tokens by range, so the buffer must outlive them. Offsets are 32 bits,
+// like those of the buffer.
+struct Token_range
+{
+  Token_range(Token_buffer const& b, std::size_t f, std::size_t l)
+    : buf(&b), first(f), last(l)
+  { }
+
+  // Returns the number of tokens in the range.
+  std::size_t size() const { return last - first; }
+  bool        empty() const { return first == last; }
+
+  Token_buffer const* buf;
+  std::uint32_t       first;
+  std::uint32_t       last;
+};
+
+
+// A position within a token buffer. The parser reads tokens through a
+// cursor, so that lookahead is a plain array index. A cursor reads
+// either a whole buffer or a range of one.
+//
+// When the cursor is at the end of its tokens, peeking yields an
+// invalid token, and the lookahead kind is that of the invalid token.
+struct Token_cursor
+{
+  using Position = std::size_t;
+
+  Token_cursor(Token_buffer const& b)
+    : buf(&b), pos(0), end(b.size())
+  { }
+
+  Token_cursor(Token_range const& r)
+    : buf(r.buf), pos(r.first), end(r.last)
+  { }
+
+  // Returns true when there are no more tokens.
+  bool eof() const { return pos == end; }
+
+  // Returns the kind of the nth token past the current position.
+  Token_kind kind(int n = 0) const;
+
+  Token    peek(int n = 0) const;
+  Token    get();
+  Location location() const;
+
+  // Save and restore positions for backtracking.
+  Position position() const         { return pos; }
+  void     reposition(Position p)   { pos = p; }
+
+  Token_buffer const* buf;
+  Position            pos;
+  Position            end;
+};
+
+
+inline Token_kind
+Token_cursor::kind(int n) const
+{
+  std::size_t k = pos + n;
+  if (k < end)
+    return buf->kind(k);
+  else
+    return Token_kind(Token().kind());
+}
+
+
+// Returns the nth token past the current position, or an invalid token
+// if that is past the end of the cursor's tokens.
+inline Token
+Token_cursor::peek(int n) const
+{
+  std::size_t k = pos + n;
+  if (k < end)
+    return buf->token(k);
+  else
+    return Token();
+}
+
+
+// Returns the current token and advances the cursor.
+inline Token
+Token_cursor::get()
+{
+  lingo_assert(!eof());
+  return buf->token(pos++);
+}
+
+
+// Returns the location of the current token.
+inline Location
+Token_cursor::location() const
+{
+  if (eof())
+    return Location();
+  return buf->location(pos);
+}
+
+
 } // namespace banjo
 
 
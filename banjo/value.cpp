@@ -6,6 +6,7 @@
 #include "printer.hpp"
 
 #include <iostream>
+#include <memory>
 
 
 namespace banjo
@@ -17,13 +18,159 @@ namespace banjo
 std::string
 Array_value::get_as_string() const
 {
-  std::string str(len, '\0');
-  std::transform(data, data + len, str.begin(), [](Value const& v) -> char {
+  std::string str(len(), '\0');
+  std::transform(data(), data() + len(), str.begin(), [](Value const& v) -> char {
     return (v.is_integer() ? v.get_integer() : v.get_float());
   });
   return str;
 }
 
+// -------------------------------------------------------------------------- //
+// Value arenas
+
+Value_arena::~Value_arena()
+{
+  for (Chunk& c : chunks)
+    delete [] c.data;
+}
+
+
+// Allocate `n` bytes of storage suitably aligned for values.
+void*
+Value_arena::allocate(std::size_t n)
+{
+  constexpr std::size_t align = alignof(Value);
+  n = (n + align - 1) & ~(align - 1);
+  if (limit && used + n > limit)
+    throw Limitation_error("constant evaluation exceeded the limit of {} bytes", limit);
+  if (n > avail) {
+    std::size_t size = std::max(chunk_size, n);
+    char* p = new char[size];
+    chunks.push_back({p, size});
+    top = p;
+    avail = size;
+  }
+  void* p = top;
+  top += n;
+  avail -= n;
+  used += n;
+  return p;
+}
+
+
+// Reclaim all storage allocated from the arena. The first chunk is
+// retained for reuse.
+void
+Value_arena::release()
+{
+  if (chunks.empty())
+    return;
+  for (std::size_t i = 1; i < chunks.size(); ++i)
+    delete [] chunks[i].data;
+  chunks.resize(1);
+  top = chunks[0].data;
+  avail = chunks[0].size;
+  used = 0;
+}
+
+
+// Returns the arena for values created during evaluation.
+Value_arena&
+evaluation_arena()
+{
+  static Value_arena arena;
+  return arena;
+}
+
+
+// Returns the arena for the results of evaluation. This is never
+// reclaimed.
+Value_arena&
+result_arena()
+{
+  static Value_arena arena;
+  return arena;
+}
+
+
+// Returns the arena in which new aggregates are allocated.
+Value_arena&
+current_value_arena()
+{
+  if (Enter_evaluation::depth)
+    return evaluation_arena();
+  else
+    return result_arena();
+}
+
+
+// Allocate an aggregate of `n` elements in the arena `a`. Elements
+// are initialized to the error value.
+Aggregate_rep*
+make_aggregate(Value_arena& a, std::size_t n)
+{
+  void* p = a.allocate(sizeof(Aggregate_rep) + n * sizeof(Value));
+  Aggregate_rep* rep = new (p) Aggregate_rep{n};
+  std::uninitialized_fill_n(rep->data(), n, Value());
+  return rep;
+}
+
+
+namespace
+{
+
+// Copy the elements of `v` into a new aggregate in the result arena.
+Aggregate_rep*
+persist_aggregate(Aggregate_value const& v)
+{
+  Aggregate_rep* rep = make_aggregate(result_arena(), v.len());
+  for (std::size_t i = 0; i < v.len(); ++i)
+    rep->data()[i] = persist(v[i]);
+  return rep;
+}
+
+} // namespace
+
+
+// Returns a copy of `v` whose aggregates are allocated in the result
+// arena.
+Value
+persist(Value const& v)
+{
+  if (v.is_array())
+    return Array_value(persist_aggregate(v.get_array()));
+  if (v.is_tuple())
+    return Tuple_value(persist_aggregate(v.get_tuple()));
+  return v;
+}
+
+
+int Enter_evaluation::depth = 0;
+
+
+Enter_evaluation::Enter_evaluation()
+{
+  ++depth;
+}
+
+
+Enter_evaluation::~Enter_evaluation()
+{
+  if (--depth == 0)
+    evaluation_arena().release();
+}
+
+
+// Returns the value `v` in a form that outlives the evaluation.
+Value
+Enter_evaluation::result(Value const& v) const
+{
+  if (outermost())
+    return persist(v);
+  return v;
+}
+
+
 // -------------------------------------------------------------------------- //
 // Printing
 
@@ -34,8 +181,8 @@ inline void
 print(std::ostream& os, Array_value const& v)
 {
   os << '[';
-  Value const* p = v.data;
-  Value const* q = p + v.len;
+  Value const* p = v.data();
+  Value const* q = p + v.len();
   while (p != q) {
     os << *p;
     if (p + 1 != q)
@@ -50,8 +197,8 @@ inline void
 print(std::ostream& os, Tuple_value const& v)
 {
   os << '{';
-  Value const* p = v.data;
-  Value const* q = p + v.len;
+  Value const* p = v.data();
+  Value const* q = p + v.len();
   while (p != q) {
     os << *p;
     if (p + 1 != q)
@@ -106,8 +253,8 @@ zero_initialize(Float_value& v)
 void
 zero_initialize(Aggregate_value& v)
 {
-  for (std::size_t i = 0; i < v.len; ++i)
-    zero_initialize(v.data[i]);
+  for (std::size_t i = 0; i < v.len(); ++i)
+    zero_initialize(v[i]);
 }
 
 
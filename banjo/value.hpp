@@ -42,17 +42,36 @@ using Function_value = Function_decl const*;
 using Reference_value = Value*;
 
 
-// The common structure of array and tuple values.
-//
-// FIXME: Memory allocated to this array is never freed. It probably
-// should be managed a little better.
+// The storage of an aggregate value: its length followed immediately
+// by its elements. Aggregate storage is allocated from a value arena
+// and is never freed individually.
+struct Aggregate_rep
+{
+  Value*       data()       { return reinterpret_cast<Value*>(this + 1); }
+  Value const* data() const { return reinterpret_cast<Value const*>(this + 1); }
+
+  std::size_t len;
+};
+
+
+// The common structure of array and tuple values. This is a handle
+// to storage allocated from the current value arena (see
+// current_value_arena).
 struct Aggregate_value
 {
   Aggregate_value(std::size_t n);
   Aggregate_value(char const*, std::size_t n);
 
-  std::size_t len;
-  Value*      data;
+  explicit Aggregate_value(Aggregate_rep* r)
+    : rep(r)
+  { }
+
+  std::size_t len() const  { return rep->len; }
+  Value*      data() const { return rep->data(); }
+
+  Value& operator[](std::size_t n) const { return data()[n]; }
+
+  Aggregate_rep* rep;
 };
 
 
@@ -168,6 +187,11 @@ struct Value
 };
 
 
+// Every value is a tag and a single word. Aggregates are stored
+// out of line.
+static_assert(sizeof(Value) <= 16, "unexpected value size");
+
+
 // The non-modifying visitor.
 struct Value::Visitor
 {
@@ -416,12 +440,76 @@ apply(Value& v, F fn)
 
 
 
+// -------------------------------------------------------------------------- //
+// Value arenas
+
+// A region from which aggregate values are allocated. Allocation is
+// a pointer increment, and storage is reclaimed all at once.
+struct Value_arena
+{
+  static constexpr std::size_t chunk_size = 64 * 1024;
+
+  struct Chunk
+  {
+    char*       data;
+    std::size_t size;
+  };
+
+  Value_arena()
+    : top(nullptr), avail(0), used(0), limit(0)
+  { }
+
+  ~Value_arena();
+
+  // Non-copyable
+  Value_arena(Value_arena const&) = delete;
+  Value_arena& operator=(Value_arena const&) = delete;
+
+  void* allocate(std::size_t);
+  void  release();
+
+  // Returns the number of bytes allocated since the last release.
+  std::size_t bytes() const { return used; }
+
+  std::vector<Chunk> chunks;
+  char*              top;
+  std::size_t        avail;
+  std::size_t        used;
+  std::size_t        limit; // 0 for no limit
+};
+
+
+Value_arena& evaluation_arena();
+Value_arena& result_arena();
+Value_arena& current_value_arena();
+
+Aggregate_rep* make_aggregate(Value_arena&, std::size_t);
+Value          persist(Value const&);
+
+
+// Marks the extent of an evaluation. Aggregates created during an
+// evaluation are allocated in the evaluation arena, which is
+// reclaimed when the outermost evaluation ends. The result of the
+// outermost evaluation must be passed through result() so that its
+// aggregates are copied into the result arena.
+struct Enter_evaluation
+{
+  Enter_evaluation();
+  ~Enter_evaluation();
+
+  bool  outermost() const { return depth == 1; }
+  Value result(Value const&) const;
+
+  static int depth;
+};
+
+
 // -------------------------------------------------------------------------- //
 // Aggregate values
 
 inline
 Aggregate_value::Aggregate_value(std::size_t n)
-  : len(n), data(new Value[n])
+  : rep(make_aggregate(current_value_arena(), n))
 { }
 
 
@@ -429,7 +517,7 @@ inline
 Aggregate_value::Aggregate_value(char const* s, std::size_t n)
   : Aggregate_value(n)
 {
-  std::copy(s, s + n, data);
+  std::copy(s, s + n, data());
 }
 
 
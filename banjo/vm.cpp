@@ -0,0 +1,1021 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#include "vm.hpp"
+#include "ast.hpp"
+#include "budget.hpp"
+#include "memo.hpp"
+#include "gen/llvm/jit.hpp"
+
+#include <unordered_map>
+
+
+namespace banjo
+{
+
+// -------------------------------------------------------------------------- //
+// Lowering
+
+namespace
+{
+
+// Thrown during lowering when a function uses a construct that the
+// machine does not support.
+struct Unsupported { };
+
+
+// Thrown during execution when a callee cannot be lowered.
+struct Unlowered { };
+
+
+// The maximum number of registers in a frame. This is limited by the
+// width of an instruction's operands.
+constexpr int max_registers = 0xffff;
+
+
+// Returns the integer type of `t`, or nullptr if `t` is not an
+// integer type.
+inline Integer_type const*
+integer_type(Type const& t)
+{
+  return as<Integer_type>(&t.unqualified_type());
+}
+
+
+// Returns true if values of type `t` can be held in a register.
+inline bool
+is_register_type(Type const& t)
+{
+  if (Integer_type const* z = integer_type(t))
+    return z->precision() <= 64;
+  return is_boolean_type(t.unqualified_type());
+}
+
+
+// Lowers the body of a function to bytecode.
+//
+// Registers are allocated in stack order. Each parameter and local
+// variable is assigned a register when it is declared and keeps that
+// register for the duration of the call. Temporaries are allocated
+// above the locals and are released at the end of each statement.
+struct Lowering
+{
+  // The jumps that exit or restart an enclosing loop.
+  struct Loop
+  {
+    std::size_t              start;
+    std::vector<std::size_t> breaks;
+  };
+
+  Lowering(Bytecode& b)
+    : code(b), top(0), co(false)
+  { }
+
+  void function(Function_decl const&);
+  void coroutine(Coroutine_decl const&);
+  void parameters(Decl_list const&);
+
+  // Statements
+  void statement(Stmt const&);
+  void block(Compound_stmt const&);
+  void declaration(Declaration_stmt const&);
+  void expression(Expression_stmt const&);
+  void return_(Return_stmt const&);
+  void if_then(If_then_stmt const&);
+  void if_else(If_else_stmt const&);
+  void while_(While_stmt const&);
+  void break_(Break_stmt const&);
+  void continue_(Continue_stmt const&);
+  void yield(Yield_stmt const&);
+
+  // Expressions
+  int expression(Expr const&);
+  int constant(Integer_value);
+  int integer(Integer_expr const&);
+  int reference(Decl_expr const&);
+  int conversion(Integer_conv const&);
+  int unary(Opcode, Unary_expr const&);
+  int binary(Opcode, Binary_expr const&);
+  int binary(Opcode, Opcode, Binary_expr const&);
+  int wrap(int, Type const&);
+  int logical(Opcode, Binary_expr const&);
+  int assign(Assign_expr const&);
+  int call(Call_expr const&);
+  int condition(Expr const&);
+
+  // Registers and instructions
+  int local(Decl const&);
+  int temporary();
+  std::size_t emit(Opcode, int = 0, int = 0, int = 0);
+  std::size_t here() const { return code.code.size(); }
+  void patch(std::size_t, std::size_t);
+
+  Bytecode&                                     code;
+  std::unordered_map<Decl const*, int>          slots;
+  std::unordered_map<Integer_value, int>        consts;
+  std::unordered_map<Function_decl const*, int> callees;
+  std::vector<Loop>                             loops;
+  int                                           top;
+  bool                                          co;
+};
+
+
+void
+Lowering::function(Function_decl const& f)
+{
+  if (!is_register_type(f.return_type()))
+    throw Unsupported();
+
+  Function_def const* def = as<Function_def>(&f.definition());
+  if (!def)
+    throw Unsupported();
+
+  parameters(f.parameters());
+  statement(def->statement());
+
+  // Flowing off the end of the function is an error.
+  emit(trap_insn);
+  code.links.resize(code.callees.size());
+}
+
+
+// A coroutine is lowered like a function, except that yield statements
+// suspend it, and returning from it or flowing off the end of its body
+// finishes it.
+void
+Lowering::coroutine(Coroutine_decl const& c)
+{
+  if (!is_register_type(c.return_type()))
+    throw Unsupported();
+
+  Function_def const* def = as<Function_def>(&c.definition());
+  if (!def)
+    throw Unsupported();
+
+  co = true;
+  parameters(c.parameters());
+  statement(def->statement());
+  emit(fin_insn);
+  code.links.resize(code.callees.size());
+}
+
+
+// Assign the first registers of the frame to the parameters.
+void
+Lowering::parameters(Decl_list const& parms)
+{
+  for (Decl const& d : parms) {
+    Object_parm const* p = as<Object_parm>(&d);
+    if (!p || !is_register_type(declared_type(*p)))
+      throw Unsupported();
+    local(*p);
+  }
+  code.parms = top;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Lowering of statements
+
+void
+Lowering::statement(Stmt const& s)
+{
+  struct fn
+  {
+    Lowering& self;
+    void operator()(Stmt const& s)             { throw Unsupported(); }
+    void operator()(Empty_stmt const& s)       { }
+    void operator()(Compound_stmt const& s)    { self.block(s); }
+    void operator()(Declaration_stmt const& s) { self.declaration(s); }
+    void operator()(Expression_stmt const& s)  { self.expression(s); }
+    void operator()(Return_stmt const& s)      { self.return_(s); }
+    void operator()(If_then_stmt const& s)     { self.if_then(s); }
+    void operator()(If_else_stmt const& s)     { self.if_else(s); }
+    void operator()(While_stmt const& s)       { self.while_(s); }
+    void operator()(Break_stmt const& s)       { self.break_(s); }
+    void operator()(Continue_stmt const& s)    { self.continue_(s); }
+    void operator()(Yield_stmt const& s)       { self.yield(s); }
+  };
+  apply(s, fn{*this});
+}
+
+
+void
+Lowering::block(Compound_stmt const& s)
+{
+  for (Stmt const& s1 : s.statements())
+    statement(s1);
+}
+
+
+// Assign a register to a local variable and initialize it. Variables
+// without an initializer are zero-initialized.
+void
+Lowering::declaration(Declaration_stmt const& s)
+{
+  Variable_decl const* var = as<Variable_decl>(&s.declaration());
+  if (!var || !is_register_type(declared_type(*var)))
+    throw Unsupported();
+
+  int mark = top;
+  int r;
+  if (Expression_def const* def = as<Expression_def>(&var->initializer()))
+    r = expression(def->expression());
+  else if (is<Empty_def>(&var->initializer()))
+    r = constant(0);
+  else
+    throw Unsupported();
+  top = mark;
+
+  int v = local(*var);
+  if (v != r)
+    emit(mov_insn, v, r);
+}
+
+
+void
+Lowering::expression(Expression_stmt const& s)
+{
+  int mark = top;
+  expression(s.expression());
+  top = mark;
+}
+
+
+// The value of a return statement in a coroutine is discarded.
+void
+Lowering::return_(Return_stmt const& s)
+{
+  int mark = top;
+  int r = expression(s.expression());
+  if (co)
+    emit(fin_insn);
+  else
+    emit(ret_insn, r);
+  top = mark;
+}
+
+
+void
+Lowering::if_then(If_then_stmt const& s)
+{
+  std::size_t skip = emit(jf_insn, condition(s.condition()));
+  statement(s.true_branch());
+  patch(skip, here());
+}
+
+
+void
+Lowering::if_else(If_else_stmt const& s)
+{
+  std::size_t skip = emit(jf_insn, condition(s.condition()));
+  statement(s.true_branch());
+  std::size_t done = emit(jmp_insn);
+  patch(skip, here());
+  statement(s.false_branch());
+  patch(done, here());
+}
+
+
+void
+Lowering::while_(While_stmt const& s)
+{
+  loops.push_back({here(), {}});
+  std::size_t exit = emit(jf_insn, condition(s.condition()));
+  statement(s.body());
+  emit(jmp_insn, loops.back().start);
+  patch(exit, here());
+  for (std::size_t n : loops.back().breaks)
+    patch(n, here());
+  loops.pop_back();
+}
+
+
+void
+Lowering::break_(Break_stmt const& s)
+{
+  if (loops.empty())
+    throw Unsupported();
+  loops.back().breaks.push_back(emit(jmp_insn));
+}
+
+
+void
+Lowering::continue_(Continue_stmt const& s)
+{
+  if (loops.empty())
+    throw Unsupported();
+  emit(jmp_insn, loops.back().start);
+}
+
+
+void
+Lowering::yield(Yield_stmt const& s)
+{
+  if (!co)
+    throw Unsupported();
+  int mark = top;
+  emit(yield_insn, expression(s.expression()));
+  top = mark;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Lowering of expressions
+
+// Returns the register holding the value of `e`. This is the register
+// of the referenced variable when `e` names a local, and a temporary
+// otherwise.
+int
+Lowering::expression(Expr const& e)
+{
+  struct fn
+  {
+    Lowering& self;
+    int operator()(Expr const& e)               { throw Unsupported(); }
+    int operator()(Boolean_expr const& e)       { return self.constant(e.value()); }
+    int operator()(Integer_expr const& e)       { return self.integer(e); }
+    int operator()(Decl_expr const& e)          { return self.reference(e); }
+    int operator()(Add_expr const& e)           { return self.wrap(self.binary(add_insn, e), e.type()); }
+    int operator()(Sub_expr const& e)           { return self.wrap(self.binary(sub_insn, e), e.type()); }
+    int operator()(Mul_expr const& e)           { return self.wrap(self.binary(mul_insn, e), e.type()); }
+    int operator()(Div_expr const& e)           { return self.binary(div_insn, udiv_insn, e); }
+    int operator()(Rem_expr const& e)           { return self.binary(rem_insn, urem_insn, e); }
+    int operator()(Neg_expr const& e)           { return self.wrap(self.unary(neg_insn, e), e.type()); }
+    int operator()(Pos_expr const& e)           { return self.expression(e.operand()); }
+    int operator()(Bit_and_expr const& e)       { return self.binary(and_insn, e); }
+    int operator()(Bit_or_expr const& e)        { return self.binary(or_insn, e); }
+    int operator()(Bit_xor_expr const& e)       { return self.binary(xor_insn, e); }
+    int operator()(Bit_lsh_expr const& e)       { return self.wrap(self.binary(lsh_insn, e), e.type()); }
+    int operator()(Bit_rsh_expr const& e)       { return self.binary(rsh_insn, ursh_insn, e); }
+    int operator()(Bit_not_expr const& e)       { return self.wrap(self.unary(compl_insn, e), e.type()); }
+    int operator()(Eq_expr const& e)            { return self.binary(eq_insn, e); }
+    int operator()(Ne_expr const& e)            { return self.binary(ne_insn, e); }
+    int operator()(Lt_expr const& e)            { return self.binary(lt_insn, ult_insn, e); }
+    int operator()(Gt_expr const& e)            { return self.binary(gt_insn, ugt_insn, e); }
+    int operator()(Le_expr const& e)            { return self.binary(le_insn, ule_insn, e); }
+    int operator()(Ge_expr const& e)            { return self.binary(ge_insn, uge_insn, e); }
+    int operator()(Cmp_expr const& e)           { return self.binary(cmp_insn, ucmp_insn, e); }
+    int operator()(And_expr const& e)           { return self.logical(jf_insn, e); }
+    int operator()(Or_expr const& e)            { return self.logical(jt_insn, e); }
+    int operator()(Not_expr const& e)           { return self.unary(not_insn, e); }
+    int operator()(Assign_expr const& e)        { return self.assign(e); }
+    int operator()(Call_expr const& e)          { return self.call(e); }
+    int operator()(Value_conv const& e)         { return self.expression(e.source()); }
+    int operator()(Qualification_conv const& e) { return self.expression(e.source()); }
+    int operator()(Integer_conv const& e)       { return self.conversion(e); }
+    int operator()(Copy_init const& e)          { return self.expression(e.expression()); }
+
+    int operator()(Boolean_conv const& e)
+    {
+      int r = self.temporary();
+      self.emit(bool_insn, r, self.expression(e.source()));
+      return r;
+    }
+  };
+  return apply(e, fn{*this});
+}
+
+
+// Load a constant into a new temporary.
+int
+Lowering::constant(Integer_value n)
+{
+  auto iter = consts.find(n);
+  if (iter == consts.end()) {
+    iter = consts.emplace(n, code.consts.size()).first;
+    code.consts.push_back(n);
+  }
+  int r = temporary();
+  emit(ldk_insn, r, iter->second);
+  return r;
+}
+
+
+// Load an integer literal, represented as a value of its type.
+int
+Lowering::integer(Integer_expr const& e)
+{
+  Integer_value n = e.value().getu();
+  if (Integer_type const* t = integer_type(e.type()))
+    n = extend(n, t->precision(), t->is_signed());
+  return constant(n);
+}
+
+
+// Returns the register of a local variable. References to any
+// other declaration are not supported.
+int
+Lowering::reference(Decl_expr const& e)
+{
+  auto iter = slots.find(&e.declaration());
+  if (iter == slots.end())
+    throw Unsupported();
+  return iter->second;
+}
+
+
+// Truncate and extend the value of `e` to the precision of its type.
+// The result is in a new temporary, since the source may be the
+// register of a variable.
+int
+Lowering::conversion(Integer_conv const& e)
+{
+  int r1 = expression(e.source());
+  int r = temporary();
+  Integer_type const* t = integer_type(e.type());
+  if (!t || t->precision() > 64)
+    throw Unsupported();
+  if (t->precision() < 64)
+    emit(t->is_signed() ? sext_insn : zext_insn, r, r1, t->precision());
+  else
+    emit(mov_insn, r, r1);
+  return r;
+}
+
+
+int
+Lowering::unary(Opcode op, Unary_expr const& e)
+{
+  int r1 = expression(e.operand());
+  int r = temporary();
+  emit(op, r, r1);
+  return r;
+}
+
+
+// The instruction records the precision of the operands, which have
+// the same type.
+int
+Lowering::binary(Opcode op, Binary_expr const& e)
+{
+  int r1 = expression(e.left());
+  int r2 = expression(e.right());
+  int r = temporary();
+  Instruction& i = code.code[emit(op, r, r1, r2)];
+  Integer_type const* t = integer_type(e.left().type());
+  i.w = t ? t->precision() : 64;
+  return r;
+}
+
+
+// Lower an operation whose meaning depends on the signedness of its
+// operands, choosing `u` when they are unsigned.
+int
+Lowering::binary(Opcode s, Opcode u, Binary_expr const& e)
+{
+  Integer_type const* t = integer_type(e.left().type());
+  return binary(t && !t->is_signed() ? u : s, e);
+}
+
+
+// Restore the representation of a value of type `t` in the register
+// `r` after an operation that may have carried out of its precision.
+int
+Lowering::wrap(int r, Type const& t)
+{
+  Integer_type const* z = integer_type(t);
+  if (z && z->precision() < 64)
+    emit(z->is_signed() ? sext_insn : zext_insn, r, r, z->precision());
+  return r;
+}
+
+
+// The right operand is evaluated only when the left operand does
+// not determine the result. The `op` is the jump that skips the
+// right operand.
+int
+Lowering::logical(Opcode op, Binary_expr const& e)
+{
+  int r = temporary();
+  emit(mov_insn, r, expression(e.left()));
+  std::size_t skip = emit(op, r);
+  emit(mov_insn, r, expression(e.right()));
+  patch(skip, here());
+  return r;
+}
+
+
+int
+Lowering::assign(Assign_expr const& e)
+{
+  Expr const* lhs = &e.left();
+  Decl_expr const* ref = as<Decl_expr>(lhs);
+  if (!ref)
+    throw Unsupported();
+  int v = reference(*ref);
+  emit(mov_insn, v, expression(e.right()));
+  return v;
+}
+
+
+// Arguments are evaluated and then copied into consecutive registers
+// at the top of the frame, which become the parameters of the
+// callee's frame. The result is returned in the first of those
+// registers.
+int
+Lowering::call(Call_expr const& e)
+{
+  Function_expr const* ref = as<Function_expr>(&e.function());
+  if (!ref)
+    throw Unsupported();
+  Function_decl const& f = ref->declaration();
+  if (f.parameters().size() != e.arguments().size())
+    throw Unsupported();
+
+  std::vector<int> args;
+  for (Expr const& a : e.arguments())
+    args.push_back(expression(a));
+  int base = top;
+  for (int r : args)
+    emit(mov_insn, temporary(), r);
+  if (args.empty())
+    temporary();
+
+  auto iter = callees.find(&f);
+  if (iter == callees.end()) {
+    iter = callees.emplace(&f, code.callees.size()).first;
+    code.callees.push_back(&f);
+  }
+  emit(call_insn, base, iter->second, base);
+  return base;
+}
+
+
+// Evaluate a condition into a register. The register is released
+// immediately since it is consumed by the following jump.
+int
+Lowering::condition(Expr const& e)
+{
+  int mark = top;
+  int r = expression(e);
+  top = mark;
+  return r;
+}
+
+
+// -------------------------------------------------------------------------- //
+// Registers and instructions
+
+int
+Lowering::local(Decl const& d)
+{
+  int r = temporary();
+  slots[&d] = r;
+  return r;
+}
+
+
+int
+Lowering::temporary()
+{
+  if (top == max_registers)
+    throw Unsupported();
+  int r = top++;
+  code.regs = std::max(code.regs, top);
+  return r;
+}
+
+
+std::size_t
+Lowering::emit(Opcode op, int a, int b, int c)
+{
+  if (here() > max_registers)
+    throw Unsupported();
+  code.code.push_back({op, 0, std::uint16_t(a), std::uint16_t(b), std::uint16_t(c)});
+  return here() - 1;
+}
+
+
+// Set the target of the jump at `n`.
+void
+Lowering::patch(std::size_t n, std::size_t target)
+{
+  Instruction& i = code.code[n];
+  if (i.op == jmp_insn)
+    i.a = target;
+  else
+    i.b = target;
+}
+
+
+// Lowered functions and coroutines, indexed by declaration. Those that
+// cannot be lowered are mapped to null.
+using Bytecode_cache = std::unordered_map<Decl const*, std::unique_ptr<Bytecode>>;
+
+
+Bytecode_cache&
+bytecode_cache()
+{
+  static Bytecode_cache cache;
+  return cache;
+}
+
+
+} // namespace
+
+
+// Returns the bytecode for the function `f`, lowering it on first
+// use. Returns nullptr if `f` cannot be lowered.
+Bytecode const*
+lower(Function_decl const& f)
+{
+  Bytecode_cache& cache = bytecode_cache();
+  auto iter = cache.find(&f);
+  if (iter != cache.end())
+    return iter->second.get();
+
+  std::unique_ptr<Bytecode>& code = cache[&f];
+  code.reset(new Bytecode(f));
+  try {
+    Lowering(*code).function(f);
+  } catch (Unsupported&) {
+    code.reset();
+  }
+  return code.get();
+}
+
+
+// Returns the bytecode for the coroutine `c`, lowering it on first
+// use. Returns nullptr if `c` cannot be lowered.
+Bytecode const*
+lower(Coroutine_decl const& c)
+{
+  Bytecode_cache& cache = bytecode_cache();
+  auto iter = cache.find(&c);
+  if (iter != cache.end())
+    return iter->second.get();
+
+  std::unique_ptr<Bytecode>& code = cache[&c];
+  code.reset(new Bytecode(c));
+  try {
+    Lowering(*code).coroutine(c);
+  } catch (Unsupported&) {
+    code.reset();
+  }
+  return code.get();
+}
+
+
+// Discard the bytecode of all lowered functions and coroutines. This
+// must be done when a definition changes, since bytecode is linked to
+// the bytecode of its callees.
+void
+discard_bytecode()
+{
+  bytecode_cache().clear();
+}
+
+
+Function_decl const&
+Bytecode::function() const
+{
+  return cast<Function_decl>(*decl);
+}
+
+
+// -------------------------------------------------------------------------- //
+// Execution
+
+namespace
+{
+
+// Registers are operated on as unsigned words, so that arithmetic
+// wraps rather than overflows.
+using Word = std::uint64_t;
+
+
+// Fail unless `n / d` is defined for operands of precision `w`. The
+// quotient of the least value and -1 cannot be represented, and the
+// compiled program's behavior is undefined for it, as for zero.
+inline void
+check_division(Integer_value n, Integer_value d, int w)
+{
+  if (d == 0)
+    throw Evaluation_error("division by zero");
+  if (d == -1 && n == extend(Word(1) << (w - 1), w, true))
+    throw Evaluation_error("division overflow");
+}
+
+
+// Fail unless `s` is a valid amount by which to shift a value of
+// precision `w`.
+inline void
+check_shift(Integer_value s, int w)
+{
+  if (Word(s) >= Word(w))
+    throw Evaluation_error("shift amount out of range");
+}
+
+
+// Returns the bytecode of the nth callee of `code`.
+inline Bytecode const&
+link(Bytecode const& code, int n)
+{
+  Bytecode const*& target = code.links[n];
+  if (!target) {
+    target = lower(*code.callees[n]);
+    if (!target)
+      throw Unlowered();
+  }
+  return *target;
+}
+
+
+} // namespace
+
+
+// Execute the function `code` with the given arguments, storing its
+// result in `result`. Returns false if the function cannot be executed
+// by the machine, in which case it must be evaluated by other means.
+// The function is marked as failed so that the machine is not tried
+// again, and the steps taken by the machine are not charged.
+bool
+Virtual_machine::execute(Bytecode const& code, Value_list const& args, Value& result)
+{
+  if (regs.size() < args.size())
+    regs.resize(args.size());
+  for (std::size_t i = 0; i < args.size(); ++i) {
+    if (!args[i].is_integer()) {
+      code.failed = true;
+      return false;
+    }
+    regs[i] = args[i].get_integer();
+  }
+
+  Evaluation_budget& budget = evaluation_budget();
+  std::size_t depth = budget.depth();
+  std::size_t steps = budget.steps;
+  try {
+    result = call(code, 0);
+  } catch (Unlowered&) {
+    budget.unwind(depth);
+    budget.steps = steps;
+    code.failed = true;
+    return false;
+  } catch (...) {
+    budget.unwind(depth);
+    throw;
+  }
+  return true;
+}
+
+
+// Call the function `code` with the frame whose first register is at
+// `base`. If memoization is enabled and the function is pure, the
+// result may be taken from, and is recorded in, the memo cache.
+Integer_value
+Virtual_machine::call(Bytecode const& code, std::size_t base)
+{
+  Memo_cache& memo = memo_cache();
+  if (!memo.enabled() || !is_pure(code.function()))
+    return invoke(code, base);
+
+  Value_list args(regs.begin() + base, regs.begin() + base + code.parms);
+  if (Value const* v = memo.find(code.function(), args))
+    return v->get_integer();
+  Integer_value n = invoke(code, base);
+  memo.insert(code.function(), args, n);
+  return n;
+}
+
+
+// Execute the function `code`, compiling it to native code when it
+// becomes hot. Compilation is attempted only once per function, and
+// the bytecode is interpreted if it fails.
+//
+// Native code calls its callees directly, bypassing the memo cache.
+// A function whose results are memoized is therefore never compiled.
+// Every function that can be compiled is pure, since all of its
+// callees can be lowered, so this disables compilation whenever
+// memoization is enabled.
+Integer_value
+Virtual_machine::invoke(Bytecode const& code, std::size_t base)
+{
+  Jit_options const& jit = jit_options();
+  if (jit.enabled && !code.native && ++code.calls == jit.threshold)
+    if (!memo_cache().enabled() || !is_pure(code.function()))
+      code.native = ll::compile_native(code);
+  if (code.native)
+    return run_native(code, base);
+  return run(code, base);
+}
+
+
+// Run the native code of `code` with the arguments in the frame whose
+// first register is at `base`. The budget is shared with the native
+// code, and any failure it reports is raised here.
+Integer_value
+Virtual_machine::run_native(Bytecode const& code, std::size_t base)
+{
+  constexpr std::uint64_t unlimited = std::uint64_t(-1);
+  Evaluation_budget& budget = evaluation_budget();
+  Evaluation_limits const& lim = budget.limits;
+  Native_state st {
+    budget.steps,
+    lim.steps ? lim.steps : unlimited,
+    budget.depth(),
+    lim.depth ? lim.depth : unlimited,
+    native_ok
+  };
+
+  Enter_call call(budget, code.function());
+  Integer_value n = code.native(&st, regs.data() + base);
+  budget.steps = st.steps;
+  switch (st.status) {
+    case native_ok:
+      return n;
+    case native_steps:
+      budget.exceeded_steps();
+    case native_depth:
+      budget.exceeded_depth();
+    case native_division:
+      throw Evaluation_error("division by zero");
+    case native_overflow:
+      throw Evaluation_error("division overflow");
+    case native_shift:
+      throw Evaluation_error("shift amount out of range");
+    default:
+      throw Evaluation_error("function evaluation failed");
+  }
+}
+
+
+// Resume the coroutine `co` on its own registers. Returns true and
+// stores the yielded value in `result` if the coroutine yields, and
+// false if it finishes or has already finished.
+//
+// The coroutine's registers are exchanged with the machine's, so
+// neither suspension nor resumption copies them. Calls made by the
+// coroutine push their frames above its registers.
+bool
+Virtual_machine::resume(Coroutine_state& co, Integer_value& result)
+{
+  if (co.done())
+    return false;
+
+  struct Swap_registers
+  {
+    Swap_registers(Virtual_machine& m, Coroutine_state& c)
+      : vm(m), co(c)
+    {
+      std::swap(vm.regs, co.regs);
+    }
+
+    ~Swap_registers()
+    {
+      std::swap(vm.regs, co.regs);
+    }
+
+    Virtual_machine& vm;
+    Coroutine_state& co;
+  };
+
+  Evaluation_budget& budget = evaluation_budget();
+  std::size_t depth = budget.depth();
+  Swap_registers swap(*this, co);
+  try {
+    budget.enter(co.code->declaration());
+    result = interpret(*co.code, 0, co.pc);
+    budget.leave();
+  } catch (Unlowered&) {
+    // A callee cannot be executed by the machine, and the coroutine
+    // cannot be resumed by other means.
+    budget.unwind(depth);
+    co.pc = Coroutine_state::finished;
+    throw Evaluation_error("coroutine evaluation failed");
+  } catch (...) {
+    budget.unwind(depth);
+    co.pc = Coroutine_state::finished;
+    throw;
+  }
+  return !co.done();
+}
+
+
+// Run the function `code` in the frame whose first register is at
+// `base`, returning the result.
+Integer_value
+Virtual_machine::run(Bytecode const& code, std::size_t base)
+{
+  Evaluation_budget& budget = evaluation_budget();
+  budget.enter(code.function());
+  std::size_t pc = 0;
+  Integer_value n = interpret(code, base, pc);
+  budget.leave();
+  return n;
+}
+
+
+// Execute `code` in the frame whose first register is at `base`,
+// starting from the instruction at position `start`. Execution
+// continues until the code returns, yields or finishes. On return,
+// `start` is the position at which a yielding coroutine resumes, or
+// finished.
+Integer_value
+Virtual_machine::interpret(Bytecode const& code, std::size_t base, std::size_t& start)
+{
+  Evaluation_budget& budget = evaluation_budget();
+  if (regs.size() < base + code.regs)
+    regs.resize(base + code.regs);
+
+  Instruction const* first = code.code.data();
+  Instruction const* pc = first + start;
+  Integer_value const* k = code.consts.data();
+  Integer_value* r = regs.data() + base;
+  while (true) {
+    budget.step();
+    Instruction const& i = *pc++;
+    switch (i.op) {
+      case ldk_insn: r[i.a] = k[i.b]; break;
+      case mov_insn: r[i.a] = r[i.b]; break;
+      case sext_insn: r[i.a] = extend(r[i.b], i.c, true); break;
+      case zext_insn: r[i.a] = extend(r[i.b], i.c, false); break;
+      case add_insn: r[i.a] = Word(r[i.b]) + Word(r[i.c]); break;
+      case sub_insn: r[i.a] = Word(r[i.b]) - Word(r[i.c]); break;
+      case mul_insn: r[i.a] = Word(r[i.b]) * Word(r[i.c]); break;
+      case div_insn:
+        check_division(r[i.b], r[i.c], i.w);
+        r[i.a] = r[i.b] / r[i.c];
+        break;
+      case udiv_insn:
+        if (r[i.c] == 0)
+          throw Evaluation_error("division by zero");
+        r[i.a] = Word(r[i.b]) / Word(r[i.c]);
+        break;
+      case rem_insn:
+        check_division(r[i.b], r[i.c], i.w);
+        r[i.a] = r[i.b] % r[i.c];
+        break;
+      case urem_insn:
+        if (r[i.c] == 0)
+          throw Evaluation_error("division by zero");
+        r[i.a] = Word(r[i.b]) % Word(r[i.c]);
+        break;
+      case neg_insn: r[i.a] = -Word(r[i.b]); break;
+      case and_insn: r[i.a] = r[i.b] & r[i.c]; break;
+      case or_insn: r[i.a] = r[i.b] | r[i.c]; break;
+      case xor_insn: r[i.a] = r[i.b] ^ r[i.c]; break;
+      case lsh_insn:
+        check_shift(r[i.c], i.w);
+        r[i.a] = Word(r[i.b]) << r[i.c];
+        break;
+      case rsh_insn:
+        check_shift(r[i.c], i.w);
+        r[i.a] = r[i.b] >> r[i.c];
+        break;
+      case ursh_insn:
+        check_shift(r[i.c], i.w);
+        r[i.a] = Word(r[i.b]) >> r[i.c];
+        break;
+      case compl_insn: r[i.a] = ~r[i.b]; break;
+      case not_insn: r[i.a] = !r[i.b]; break;
+      case bool_insn: r[i.a] = r[i.b] != 0; break;
+      case eq_insn: r[i.a] = r[i.b] == r[i.c]; break;
+      case ne_insn: r[i.a] = r[i.b] != r[i.c]; break;
+      case lt_insn: r[i.a] = r[i.b] < r[i.c]; break;
+      case ult_insn: r[i.a] = Word(r[i.b]) < Word(r[i.c]); break;
+      case gt_insn: r[i.a] = r[i.b] > r[i.c]; break;
+      case ugt_insn: r[i.a] = Word(r[i.b]) > Word(r[i.c]); break;
+      case le_insn: r[i.a] = r[i.b] <= r[i.c]; break;
+      case ule_insn: r[i.a] = Word(r[i.b]) <= Word(r[i.c]); break;
+      case ge_insn: r[i.a] = r[i.b] >= r[i.c]; break;
+      case uge_insn: r[i.a] = Word(r[i.b]) >= Word(r[i.c]); break;
+      case cmp_insn: r[i.a] = (r[i.b] > r[i.c]) - (r[i.b] < r[i.c]); break;
+      case ucmp_insn: r[i.a] = (Word(r[i.b]) > Word(r[i.c])) - (Word(r[i.b]) < Word(r[i.c])); break;
+      case jmp_insn: pc = first + i.a; break;
+      case jf_insn: if (!r[i.a]) pc = first + i.b; break;
+      case jt_insn: if (r[i.a]) pc = first + i.b; break;
+      case call_insn: {
+        // The callee's frame starts at its first argument. Calls
+        // may grow the register stack, so reload the frame.
+        Integer_value v = call(link(code, i.b), base + i.c);
+        r = regs.data() + base;
+        r[i.a] = v;
+        break;
+      }
+      case ret_insn:
+        start = Coroutine_state::finished;
+        return r[i.a];
+      case trap_insn:
+        throw Evaluation_error("function evaluation failed");
+      case yield_insn:
+        start = pc - first;
+        return r[i.a];
+      case fin_insn:
+        start = Coroutine_state::finished;
+        return 0;
+    }
+  }
+}
+
+
+Jit_options&
+jit_options()
+{
+  static Jit_options opts;
+  return opts;
+}
+
+
+} // namespace banjo
@@ -0,0 +1,248 @@
+// Copyright (c) 2015-2016 Andrew Sutton
+// All rights reserved
+
+#ifndef BANJO_VM_HPP
+#define BANJO_VM_HPP
+
+// This module provides a compact bytecode and a register machine used
+// to execute functions during constant evaluation.
+//
+// A function whose parameters, locals, and result are all boolean or
+// integer scalars is lowered to a sequence of three-address
+// instructions. Each parameter, local variable and temporary is
+// assigned a fixed register in the function's frame, so loads and
+// stores are array indexing operations rather than lookups in the
+// evaluator's store. Functions that use any other construct are not
+// lowered, and are evaluated by the tree walker instead.
+//
+// Coroutines with scalar parameters, locals and results are lowered in
+// the same way. A yield saves the position of the next instruction and
+// returns from the machine, leaving the coroutine's registers intact,
+// so that resuming the coroutine continues from that position.
+
+#include "prelude.hpp"
+#include "value.hpp"
+
+#include <memory>
+
+
+namespace banjo
+{
+
+struct Decl;
+struct Function_decl;
+struct Coroutine_decl;
+
+
+// The operations of the machine. In the descriptions below, r[n] is
+// the nth register of the current frame and k[n] is the nth constant
+// of the current function.
+//
+// A register holding a value of an integer type of precision w holds
+// that value sign- or zero-extended from w bits, according to the
+// type's signedness. Arithmetic is performed on 64 bits and wraps. An
+// extension instruction follows each operation whose result may not
+// be in that form. Division and shifts take the precision of their
+// operands in w, so that they fail on exactly the operands for which
+// the compiled program's behavior is undefined.
+enum Opcode : std::uint8_t
+{
+  ldk_insn,   // r[a] = k[b]
+  mov_insn,   // r[a] = r[b]
+  sext_insn,  // r[a] = r[b], sign-extended from c bits
+  zext_insn,  // r[a] = r[b], zero-extended from c bits
+  add_insn,   // r[a] = r[b] + r[c]
+  sub_insn,   // r[a] = r[b] - r[c]
+  mul_insn,   // r[a] = r[b] * r[c]
+  div_insn,   // r[a] = r[b] / r[c]
+  udiv_insn,  // r[a] = r[b] / r[c], unsigned
+  rem_insn,   // r[a] = r[b] % r[c]
+  urem_insn,  // r[a] = r[b] % r[c], unsigned
+  neg_insn,   // r[a] = -r[b]
+  and_insn,   // r[a] = r[b] & r[c]
+  or_insn,    // r[a] = r[b] | r[c]
+  xor_insn,   // r[a] = r[b] ^ r[c]
+  lsh_insn,   // r[a] = r[b] << r[c]
+  rsh_insn,   // r[a] = r[b] >> r[c]
+  ursh_insn,  // r[a] = r[b] >> r[c], unsigned
+  compl_insn, // r[a] = ~r[b]
+  not_insn,   // r[a] = !r[b]
+  bool_insn,  // r[a] = r[b] != 0
+  eq_insn,    // r[a] = r[b] == r[c]
+  ne_insn,    // r[a] = r[b] != r[c]
+  lt_insn,    // r[a] = r[b] < r[c]
+  ult_insn,   // r[a] = r[b] < r[c], unsigned
+  gt_insn,    // r[a] = r[b] > r[c]
+  ugt_insn,   // r[a] = r[b] > r[c], unsigned
+  le_insn,    // r[a] = r[b] <= r[c]
+  ule_insn,   // r[a] = r[b] <= r[c], unsigned
+  ge_insn,    // r[a] = r[b] >= r[c]
+  uge_insn,   // r[a] = r[b] >= r[c], unsigned
+  cmp_insn,   // r[a] = r[b] <=> r[c]
+  ucmp_insn,  // r[a] = r[b] <=> r[c], unsigned
+  jmp_insn,   // goto a
+  jf_insn,    // if (!r[a]) goto b
+  jt_insn,    // if (r[a]) goto b
+  call_insn,  // r[a] = fn[b](r[c], r[c + 1], ...)
+  ret_insn,   // return r[a]
+  trap_insn,  // fail; control flowed off the end of the function
+  yield_insn, // suspend, yielding r[a]
+  fin_insn,   // finish the coroutine
+};
+
+
+// A single instruction. Operands are register numbers, constant
+// indexes, callee indexes, or instruction offsets, depending on
+// the opcode. The precision `w` is used only by divisions and
+// shifts.
+struct Instruction
+{
+  Opcode        op;
+  std::uint8_t  w;
+  std::uint16_t a;
+  std::uint16_t b;
+  std::uint16_t c;
+};
+
+
+// Returns the low `w` bits of `n`, sign-extended if `sign` is true
+// and zero-extended otherwise. The precision `w` is in [1, 64].
+inline Integer_value
+extend(std::uint64_t n, int w, bool sign)
+{
+  if (w < 64) {
+    std::uint64_t m = std::uint64_t(1) << w;
+    n &= m - 1;
+    if (sign && (n & (m >> 1)))
+      n |= ~(m - 1);
+  }
+  return Integer_value(n);
+}
+
+
+// The state shared with natively compiled functions. This tracks
+// the evaluation budget and reports failures, which native code
+// cannot throw. The layout of this structure is known to the JIT
+// compiler.
+struct Native_state
+{
+  std::uint64_t steps;
+  std::uint64_t max_steps;
+  std::uint64_t depth;
+  std::uint64_t max_depth;
+  std::uint64_t status;
+};
+
+
+// The reasons that native code can stop.
+enum Native_status : std::uint64_t
+{
+  native_ok,       // Returned normally
+  native_steps,    // Exceeded the step limit
+  native_depth,    // Exceeded the call depth limit
+  native_division, // Divided by zero
+  native_trap,     // Flowed off the end of a function
+  native_shift,    // Shifted by a negative amount or by the precision or more
+  native_overflow, // Divided the least value by -1
+};
+
+
+// A natively compiled function. The arguments are passed as an array
+// of integer values.
+using Native_function = Integer_value (*)(Native_state*, Integer_value const*);
+
+
+using Instruction_seq = std::vector<Instruction>;
+using Constant_seq    = std::vector<Integer_value>;
+using Callee_seq      = std::vector<Function_decl const*>;
+
+
+// The lowered form of a function or coroutine.
+//
+// The first `parms` registers of a frame hold the function's
+// arguments. The remaining registers hold local variables and
+// temporaries. Callees are lowered on their first call, and the
+// result is recorded in `links`.
+//
+// When just-in-time compilation is enabled, a function that has been
+// called often enough is compiled to native code.
+struct Bytecode
+{
+  Bytecode(Decl const& d)
+    : decl(&d), parms(0), regs(0), calls(0), native(nullptr), failed(false)
+  { }
+
+  Decl const&          declaration() const { return *decl; }
+  Function_decl const& function() const;
+
+  Decl const*          decl;
+  Instruction_seq      code;
+  Constant_seq         consts;
+  Callee_seq           callees;
+  mutable std::vector<Bytecode const*> links;
+  int                  parms;
+  int                  regs;
+  mutable std::size_t     calls;
+  mutable Native_function native;
+  mutable bool            failed; // Cannot be executed by the machine
+};
+
+
+// Configures just-in-time compilation of bytecode. A function is
+// compiled when it has been called `threshold` times.
+struct Jit_options
+{
+  bool        enabled   = false;
+  std::size_t threshold = 100;
+};
+
+
+Jit_options& jit_options();
+
+
+Bytecode const* lower(Function_decl const&);
+Bytecode const* lower(Coroutine_decl const&);
+void            discard_bytecode();
+
+
+// A suspended coroutine. The registers of the coroutine are retained
+// between resumptions, and `pc` is the position of the instruction at
+// which it resumes.
+struct Coroutine_state
+{
+  static constexpr std::size_t finished = std::size_t(-1);
+
+  Coroutine_state(Bytecode const& c)
+    : code(&c), regs(c.regs), pc(0)
+  { }
+
+  bool done() const { return pc == finished; }
+
+  Bytecode const*            code;
+  std::vector<Integer_value> regs;
+  std::size_t                pc;
+};
+
+
+// The register machine. Registers for all active frames are allocated
+// from a single stack that is reused across calls. Every instruction
+// is counted against the evaluation budget.
+struct Virtual_machine
+{
+  bool execute(Bytecode const&, Value_list const&, Value&);
+  bool resume(Coroutine_state&, Integer_value&);
+
+  Integer_value call(Bytecode const&, std::size_t);
+  Integer_value invoke(Bytecode const&, std::size_t);
+  Integer_value run(Bytecode const&, std::size_t);
+  Integer_value interpret(Bytecode const&, std::size_t, std::size_t&);
+  Integer_value run_native(Bytecode const&, std::size_t);
+
+  std::vector<Integer_value> regs;
+};
+
+
+} // namespace banjo
+
+
+#endif